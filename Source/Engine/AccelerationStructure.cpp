@@ -33,7 +33,7 @@ BottomLevelAccelerationStructure::BottomLevelAccelerationStructure(RTCDevice Dev
 {
 }
 
-void BottomLevelAccelerationStructure::AddGeometry(const std::filesystem::path& Path)
+void BottomLevelAccelerationStructure::AddGeometry(const std::filesystem::path& Path, MaterialTable& Materials)
 {
 	const aiScene* paiScene = Importer.ReadFile(
 		Path.string(),
@@ -138,6 +138,7 @@ void BottomLevelAccelerationStructure::AddGeometry(const std::filesystem::path&
 			GeometryDesc.Name					  = paiMesh->mName.C_Str();
 			GeometryDesc.pVertices				  = pVertices;
 			GeometryDesc.pIndices				  = pIndices;
+			GeometryDesc.NumTriangles			  = paiMesh->mNumFaces;
 			GeometryDesc.HasNormals				  = paiMesh->HasNormals();
 			GeometryDesc.HasTextureCoordinates	  = paiMesh->HasTextureCoords(0);
 
@@ -150,7 +151,12 @@ void BottomLevelAccelerationStructure::AddGeometry(const std::filesystem::path&
 				color.r = color.g = color.b = 1.0f;
 			}
 
-			GeometryDesc.BSDF.SetBxDF(std::make_shared<LambertianReflection>(Spectrum(color.r, color.g, color.b)));
+			GeometryDesc.MaterialID = Materials.Create<LambertianReflection>(Spectrum(color.r, color.g, color.b));
+
+			// Emissive meshes, e.g. Ke in .mtl files, are turned into area lights by Scene::Generate
+			aiColor3D emissive(0.0f, 0.0f, 0.0f);
+			paiMaterial->Get(AI_MATKEY_COLOR_EMISSIVE, emissive);
+			GeometryDesc.Emission = Spectrum(emissive.r, emissive.g, emissive.b);
 
 			GeometryDescs.push_back(GeometryDesc);
 			Geometries.push_back(Geometry);
@@ -195,19 +201,50 @@ void TopLevelAccelerationStructure::AddBottomLevelAccelerationStructure(const RA
 	NumInstances++;
 }
 
+unsigned int TopLevelAccelerationStructure::AddUserGeometry(
+	void*					pUserData,
+	RTCBoundsFunction		Bounds,
+	RTCIntersectFunctionN	Intersect,
+	RTCOccludedFunctionN	Occluded)
+{
+	auto Geometry = rtcNewGeometry(Device, RTC_GEOMETRY_TYPE_USER);
+
+	rtcSetGeometryUserPrimitiveCount(Geometry, 1);
+	rtcSetGeometryUserData(Geometry, pUserData);
+	rtcSetGeometryBoundsFunction(Geometry, Bounds, nullptr);
+	rtcSetGeometryIntersectFunction(Geometry, Intersect);
+	rtcSetGeometryOccludedFunction(Geometry, Occluded);
+	rtcCommitGeometry(Geometry);
+
+	unsigned int GeometryID = rtcAttachGeometry(Scene, Geometry);
+	rtcReleaseGeometry(Geometry);
+	return GeometryID;
+}
+
 void TopLevelAccelerationStructure::Generate()
 {
+	Instances.resize(NumInstances);
+
 	for (size_t i = 0; i < NumInstances; ++i)
 	{
-		auto& Instance		   = InstanceDescs[i];
+		auto& InstanceDesc	   = InstanceDescs[i];
 		auto& InstanceGeometry = InstanceGeometries[i];
 
-		XMMATRIX   mMatrix = Instance.Transform.Matrix();
+		XMMATRIX   mMatrix = InstanceDesc.Transform.Matrix();
 		XMFLOAT3X4 Matrix;
 		XMStoreFloat3x4(&Matrix, mMatrix);
 
 		rtcSetGeometryTransform(InstanceGeometry, 0, RTC_FORMAT_FLOAT3X4_ROW_MAJOR, reinterpret_cast<float*>(&Matrix));
 		rtcCommitGeometry(InstanceGeometry);
+
+		// Bake the matrices needed on the hit path
+		XMMATRIX mInverse = XMMatrixInverse(nullptr, mMatrix);
+
+		auto& Instance = Instances[i];
+		XMStoreFloat4x4(&Instance.ObjectToWorld, mMatrix);
+		XMStoreFloat4x4(&Instance.WorldToObject, mInverse);
+		XMStoreFloat4x4(&Instance.NormalMatrix, XMMatrixTranspose(mInverse));
+		Instance.BLAS = InstanceDesc.BLAS;
 	}
 
 	/*
@@ -5,6 +5,7 @@
 #include "Math/Math.h"
 #include "Vertex.h"
 #include "BSDF.h"
+#include "Material/MaterialTable.h"
 
 class AccelerationStructure
 {
@@ -24,10 +25,15 @@ struct RAYTRACING_GEOMETRY_DESC
 	std::string		Name;
 	Vertex*			pVertices;
 	unsigned int*	pIndices;
+	unsigned int	NumTriangles;
 	bool			HasNormals;
 	bool			HasTextureCoordinates;
-	BSDF			BSDF;
+	unsigned int	MaterialID = MaterialTable::InvalidID; // Index into the scene's MaterialTable
 	MediumInterface MediumInterface;
+	Spectrum		Emission = Spectrum(0.0f); // Radiance emitted by every triangle, each becomes an area light
+
+	bool HasMaterial() const { return MaterialID != MaterialTable::InvalidID; }
+	bool IsEmissive() const { return !Emission.IsBlack(); }
 };
 
 class BottomLevelAccelerationStructure : public AccelerationStructure
@@ -35,9 +41,13 @@ class BottomLevelAccelerationStructure : public AccelerationStructure
 public:
 	BottomLevelAccelerationStructure(RTCDevice Device);
 
-	RAYTRACING_GEOMETRY_DESC& operator[](size_t i) { return GeometryDescs[i]; }
+	RAYTRACING_GEOMETRY_DESC&		operator[](size_t i) { return GeometryDescs[i]; }
+	const RAYTRACING_GEOMETRY_DESC& operator[](size_t i) const { return GeometryDescs[i]; }
+
+	size_t GetNumGeometries() const { return NumGeometries; }
 
-	void AddGeometry(const std::filesystem::path& Path);
+	// Materials imported with the geometry are added to Materials
+	void AddGeometry(const std::filesystem::path& Path, MaterialTable& Materials);
 
 	void Generate();
 
@@ -53,19 +63,51 @@ struct RAYTRACING_INSTANCE_DESC
 	BottomLevelAccelerationStructure* BLAS;
 };
 
+/*
+ * Immutable per-instance data baked by TopLevelAccelerationStructure::Generate, the hit path
+ * indexes this table by instance ID instead of rebuilding matrices from the instance's Transform.
+ * Each entry is padded to a multiple of a cache line so entries never share one.
+ */
+struct alignas(64) RAYTRACING_INSTANCE
+{
+	DirectX::XMFLOAT4X4				  ObjectToWorld;
+	DirectX::XMFLOAT4X4				  WorldToObject;
+	DirectX::XMFLOAT4X4				  NormalMatrix; // Inverse transpose of ObjectToWorld
+	BottomLevelAccelerationStructure* BLAS;
+
+	DirectX::XMMATRIX ObjectToWorldMatrix() const { return DirectX::XMLoadFloat4x4(&ObjectToWorld); }
+	DirectX::XMMATRIX WorldToObjectMatrix() const { return DirectX::XMLoadFloat4x4(&WorldToObject); }
+	DirectX::XMMATRIX NormalToWorldMatrix() const { return DirectX::XMLoadFloat4x4(&NormalMatrix); }
+};
+
 class TopLevelAccelerationStructure : public AccelerationStructure
 {
 public:
 	TopLevelAccelerationStructure(RTCDevice Device);
 
-	RAYTRACING_INSTANCE_DESC operator[](size_t i) const { return InstanceDescs[i]; }
+	// Only valid after Generate
+	const RAYTRACING_INSTANCE& operator[](size_t i) const { return Instances[i]; }
+
+	size_t GetNumInstances() const { return NumInstances; }
 
 	void AddBottomLevelAccelerationStructure(const RAYTRACING_INSTANCE_DESC& Desc);
 
+	/*
+	 * Attaches a user geometry with a single primitive next to the instances and returns its geometry ID, hits on
+	 * it have no instance ID. Must be called after the last instance was added since instance hits index the
+	 * instance table by geometry ID
+	 */
+	unsigned int AddUserGeometry(
+		void*					pUserData,
+		RTCBoundsFunction		Bounds,
+		RTCIntersectFunctionN	Intersect,
+		RTCOccludedFunctionN	Occluded);
+
 	void Generate();
 
 private:
 	size_t								  NumInstances = 0;
 	std::vector<RAYTRACING_INSTANCE_DESC> InstanceDescs;
 	std::vector<RTCGeometry>			  InstanceGeometries;
+	std::vector<RAYTRACING_INSTANCE>	  Instances;
 };
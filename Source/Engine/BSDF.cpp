@@ -1,7 +1,7 @@
 #include "BSDF.h"
 #include "Scene.h"
 
-void BSDF::SetBxDF(std::shared_ptr<BxDF> pBxDF)
+void BSDF::SetBxDF(const BxDF* pBxDF)
 {
 	this->pBxDF = pBxDF;
 }
@@ -5,11 +5,10 @@
 class BSDF
 {
 public:
-	operator bool() const noexcept { return static_cast<bool>(pBxDF); }
+	operator bool() const noexcept { return pBxDF != nullptr; }
 
-	BSDF Clone() const { return *this; }
-
-	void SetBxDF(std::shared_ptr<BxDF> pBxDF);
+	// The BxDF is owned by the scene's MaterialTable
+	void SetBxDF(const BxDF* pBxDF);
 
 	void SetInteraction(const SurfaceInteraction& Interaction);
 
@@ -24,6 +23,8 @@ public:
 	bool HasReflection() const { return (pBxDF->Flags() & BxDFFlags::Reflection); }
 	bool HasTransmission() const { return (pBxDF->Flags() & BxDFFlags::Transmission); }
 
+	Spectrum Albedo() const { return pBxDF->Albedo(); }
+
 	// Evaluate the BSDF for a pair of directions
 	Spectrum f(const Vector3f& woW, const Vector3f& wiW) const;
 
@@ -34,7 +35,7 @@ public:
 	std::optional<BSDFSample> Samplef(const Vector3f& woW, const Vector2f& Xi, BxDFTypes Types = BxDFTypes::All) const;
 
 private:
-	Vector3f			  Ng;
-	Frame				  ShadingFrame;
-	std::shared_ptr<BxDF> pBxDF;
+	Vector3f	Ng;
+	Frame		ShadingFrame;
+	const BxDF* pBxDF = nullptr;
 };
@@ -293,6 +293,9 @@ struct BxDF
 		const = 0;
 
 	virtual BxDFFlags Flags() const = 0;
+
+	// Reflectance color of the material, what the albedo AOV shows
+	virtual Spectrum Albedo() const { return Spectrum(1.0f); }
 };
 
 struct LambertianReflection : BxDF
@@ -342,6 +345,8 @@ struct LambertianReflection : BxDF
 
 	BxDFFlags Flags() const override { return BxDFFlags::DiffuseReflection; }
 
+	Spectrum Albedo() const override { return R; }
+
 	Spectrum R;
 };
 
@@ -367,6 +372,8 @@ struct Mirror : BxDF
 
 	BxDFFlags Flags() const override { return BxDFFlags::SpecularReflection; }
 
+	Spectrum Albedo() const override { return R; }
+
 	Spectrum R;
 };
 
@@ -432,6 +439,8 @@ struct MicrofacetReflection : BxDF
 
 	BxDFFlags Flags() const override { return BxDFFlags::GlossyReflection; }
 
+	Spectrum Albedo() const override { return R; }
+
 	Spectrum				R;
 	MicrofacetDistribution* distribution;
 	Fresnel*				fresnel;
@@ -518,6 +527,8 @@ struct MicrofacetTransmission : BxDF
 
 	BxDFFlags Flags() const override { return BxDFFlags::GlossyTransmission; }
 
+	Spectrum Albedo() const override { return T; }
+
 	Spectrum				T;
 	float					etaA, etaB;
 	MicrofacetDistribution* distribution;
@@ -31,6 +31,36 @@ RayDesc Camera::GetRay(float U, float V) const
 		INFINITY);
 }
 
+bool Camera::GetImagePosition(const Vector3f& w, float* pU, float* pV) const
+{
+	const float viewportHeight = 2.0f;
+	const float viewportWidth  = AspectRatio * viewportHeight;
+
+	Vector3f vU, vV, vW;
+	vU = Transform.Right();
+	vV = Transform.Up();
+	vW = Transform.Forward();
+
+	// Scale w to end on the image plane at FocalLength in front of the camera
+	float CosTheta = dot(w, vW);
+	if (CosTheta <= 0.0f)
+	{
+		return false;
+	}
+	Vector3f p = w * (FocalLength / CosTheta);
+
+	*pU = dot(p, vU) / viewportWidth + 0.5f;
+	*pV = dot(p, vV) / viewportHeight + 0.5f;
+	return true;
+}
+
+float Camera::GetImagePlaneArea() const
+{
+	const float viewportHeight = 2.0f;
+	const float viewportWidth  = AspectRatio * viewportHeight;
+	return viewportWidth * viewportHeight / (FocalLength * FocalLength);
+}
+
 void Camera::SetLookAt(DirectX::FXMVECTOR EyePosition, DirectX::FXMVECTOR FocusPosition, DirectX::FXMVECTOR UpDirection)
 {
 	XMMATRIX view = XMMatrixLookAtLH(EyePosition, FocusPosition, UpDirection);
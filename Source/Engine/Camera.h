@@ -7,6 +7,15 @@ struct Camera
 {
 	RayDesc GetRay(float U, float V) const;
 
+	/*
+	 *	Image position (U, V) of the camera ray along the world space direction w, the inverse of GetRay.
+	 *	Fails for directions that don't point towards the image plane, the position may be outside [0, 1]
+	 */
+	bool GetImagePosition(const Vector3f& w, float* pU, float* pV) const;
+
+	// Area of the image, where U and V span [0, 1], on the plane at unit distance in front of the camera
+	float GetImagePlaneArea() const;
+
 	void SetLookAt(DirectX::FXMVECTOR EyePosition, DirectX::FXMVECTOR FocusPosition, DirectX::FXMVECTOR UpDirection);
 
 	void SetPosition(float x, float y, float z);
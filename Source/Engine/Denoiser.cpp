@@ -0,0 +1,202 @@
+#include "Denoiser.h"
+#include "Film.h"
+#include "Texture2D.h"
+#include "TaskScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace DirectX;
+
+// Lanes of a DirectXMath vector, the filter window is walked this many pixels at a time
+static constexpr int VectorWidth = 4;
+
+enum DenoiserPlane
+{
+	IrradianceR, // Radiance divided by albedo, the quantity that is filtered
+	IrradianceG,
+	IrradianceB,
+	ColorR,
+	ColorG,
+	ColorB,
+	AlbedoR,
+	AlbedoG,
+	AlbedoB,
+	NormalX,
+	NormalY,
+	NormalZ,
+	Variance, // Variance of the pixel's luminance estimate
+	Valid,	  // 0 in the padding so pixels outside the image get no weight
+	NumPlanes
+};
+
+static XMVECTOR LoadLanes(const float* pData)
+{
+	return XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(pData));
+}
+
+static float SumLanes(FXMVECTOR v)
+{
+	return XMVectorGetX(XMVector4Dot(v, XMVectorSplatOne()));
+}
+
+// Albedo radiance is divided by, black albedo (e.g. rays that hit nothing) leaves the radiance as is
+static float DemodulationAlbedo(float Albedo)
+{
+	return Albedo > 1e-3f ? Albedo : 1.0f;
+}
+
+Denoiser::Denoiser(const DenoiserDesc& Desc /*= {}*/)
+	: Desc(Desc)
+{
+	this->Desc.Radius = std::max(this->Desc.Radius, 1);
+}
+
+bool Denoiser::Denoise(const Film& Film, Texture2D<RGBSpectrum>& Image, TaskScheduler* pScheduler) const
+{
+	if (!Film.GetAOVs().Albedo || !Film.GetAOVs().Normal)
+	{
+		printf("Denoising needs the albedo and normal AOVs\n");
+		return false;
+	}
+
+	const RECT& Bounds = Film.GetPixelBounds();
+	const int	Width  = Film.GetWidth();
+	const int	Height = Film.GetHeight();
+	const int	Radius = Desc.Radius;
+
+	// Window rows are padded to whole vectors, the padding of the planes covers the last vector of a row
+	const int	 NumVectors	 = (2 * Radius + 1 + VectorWidth - 1) / VectorWidth;
+	const int	 WindowWidth = NumVectors * VectorWidth;
+	const size_t Stride		 = size_t(Width) + 2 * Radius + VectorWidth - 1;
+	const size_t PlaneSize	 = Stride * (size_t(Height) + 2 * Radius);
+
+	std::vector<float> Planes(PlaneSize * NumPlanes, 0.0f);
+	auto			   GetPlane = [&](DenoiserPlane Plane) { return Planes.data() + PlaneSize * Plane; };
+
+	for (int y = 0; y < Height; ++y)
+	{
+		for (int x = 0; x < Width; ++x)
+		{
+			const int	 FilmX = Bounds.left + x;
+			const int	 FilmY = Bounds.top + y;
+			const size_t Index = (size_t(y) + Radius) * Stride + size_t(x) + Radius;
+
+			const RGBSpectrum Color	 = Image.GetPixel(x, y);
+			const Spectrum	  Albedo = Film.GetAlbedo(FilmX, FilmY);
+			const Vector3f	  Normal = Film.GetNormal(FilmX, FilmY);
+			for (int c = 0; c < 3; ++c)
+			{
+				GetPlane(DenoiserPlane(IrradianceR + c))[Index] = Color[c] / DemodulationAlbedo(Albedo[c]);
+				GetPlane(DenoiserPlane(ColorR + c))[Index]		= Color[c];
+				GetPlane(DenoiserPlane(AlbedoR + c))[Index]		= Albedo[c];
+			}
+			GetPlane(NormalX)[Index] = Normal.x;
+			GetPlane(NormalY)[Index] = Normal.y;
+			GetPlane(NormalZ)[Index] = Normal.z;
+
+			const int NumSamples	  = std::max(Film.GetNumSamples(FilmX, FilmY), 1);
+			GetPlane(Variance)[Index] = Film.GetVariance(FilmX, FilmY) / float(NumSamples);
+			GetPlane(Valid)[Index]	  = 1.0f;
+		}
+	}
+
+	// Spatial weights of the window, zero in the lanes past its right edge
+	std::vector<float> SpatialWeights(size_t(2 * Radius + 1) * WindowWidth, 0.0f);
+	for (int dy = -Radius; dy <= Radius; ++dy)
+	{
+		for (int dx = -Radius; dx <= Radius; ++dx)
+		{
+			SpatialWeights[size_t(dy + Radius) * WindowWidth + (dx + Radius)] =
+				std::exp(-float(dx * dx + dy * dy) / (2.0f * Desc.SigmaSpatial * Desc.SigmaSpatial));
+		}
+	}
+
+	// Expected squared color difference of two noisy pixels is about 3 (channels) times their summed variance
+	const XMVECTOR ColorFactor	= XMVectorReplicate(6.0f * Desc.SigmaColor * Desc.SigmaColor);
+	const XMVECTOR ColorEpsilon = XMVectorReplicate(1e-4f);
+	const XMVECTOR AlbedoFactor = XMVectorReplicate(1.0f / (2.0f * Desc.SigmaAlbedo * Desc.SigmaAlbedo));
+	const XMVECTOR NormalFactor = XMVectorReplicate(1.0f / (2.0f * Desc.SigmaNormal * Desc.SigmaNormal));
+
+	auto FilterRow = [&](int y)
+	{
+		for (int x = 0; x < Width; ++x)
+		{
+			const size_t Center = (size_t(y) + Radius) * Stride + size_t(x) + Radius;
+
+			XMVECTOR CenterGuides[NumPlanes];
+			for (int Plane = 0; Plane < NumPlanes; ++Plane)
+			{
+				CenterGuides[Plane] = XMVectorReplicate(GetPlane(DenoiserPlane(Plane))[Center]);
+			}
+
+			XMVECTOR Sum[3]	   = { XMVectorZero(), XMVectorZero(), XMVectorZero() };
+			XMVECTOR WeightSum = XMVectorZero();
+			for (int dy = 0; dy <= 2 * Radius; ++dy)
+			{
+				// The window of pixel x starts at padded column x
+				const size_t Row	  = (size_t(y) + dy) * Stride + size_t(x);
+				const float* pSpatial = &SpatialWeights[size_t(dy) * WindowWidth];
+				for (int i = 0; i < WindowWidth; i += VectorWidth)
+				{
+					const size_t Index = Row + i;
+
+					XMVECTOR ColorDistance = XMVectorZero(), AlbedoDistance = XMVectorZero(),
+							 NormalDistance = XMVectorZero();
+					for (int c = 0; c < 3; ++c)
+					{
+						XMVECTOR d	  = LoadLanes(GetPlane(DenoiserPlane(ColorR + c)) + Index) - CenterGuides[ColorR + c];
+						ColorDistance = XMVectorMultiplyAdd(d, d, ColorDistance);
+
+						d			   = LoadLanes(GetPlane(DenoiserPlane(AlbedoR + c)) + Index) - CenterGuides[AlbedoR + c];
+						AlbedoDistance = XMVectorMultiplyAdd(d, d, AlbedoDistance);
+
+						d			   = LoadLanes(GetPlane(DenoiserPlane(NormalX + c)) + Index) - CenterGuides[NormalX + c];
+						NormalDistance = XMVectorMultiplyAdd(d, d, NormalDistance);
+					}
+
+					XMVECTOR ColorScale = XMVectorMultiplyAdd(
+						CenterGuides[Variance] + LoadLanes(GetPlane(Variance) + Index), ColorFactor, ColorEpsilon);
+					XMVECTOR Exponent = XMVectorDivide(ColorDistance, ColorScale);
+					Exponent		  = XMVectorMultiplyAdd(AlbedoDistance, AlbedoFactor, Exponent);
+					Exponent		  = XMVectorMultiplyAdd(NormalDistance, NormalFactor, Exponent);
+
+					XMVECTOR Weight = XMVectorMultiply(LoadLanes(pSpatial + i), LoadLanes(GetPlane(Valid) + Index));
+					Weight			= XMVectorMultiply(Weight, XMVectorExpE(XMVectorNegate(Exponent)));
+
+					for (int c = 0; c < 3; ++c)
+					{
+						XMVECTOR Irradiance = LoadLanes(GetPlane(DenoiserPlane(IrradianceR + c)) + Index);
+						Sum[c]				= XMVectorMultiplyAdd(Weight, Irradiance, Sum[c]);
+					}
+					WeightSum += Weight;
+				}
+			}
+
+			// The center pixel always has weight 1
+			const float InvWeightSum = 1.0f / SumLanes(WeightSum);
+			RGBSpectrum Filtered;
+			for (int c = 0; c < 3; ++c)
+			{
+				const float Albedo = GetPlane(DenoiserPlane(AlbedoR + c))[Center];
+				Filtered[c]		   = SumLanes(Sum[c]) * InvWeightSum * DemodulationAlbedo(Albedo);
+			}
+			Image.SetPixel(x, y, Filtered);
+		}
+	};
+
+	if (pScheduler)
+	{
+		pScheduler->ParallelFor(Height, [&](size_t y, unsigned int) { FilterRow(int(y)); });
+	}
+	else
+	{
+		for (int y = 0; y < Height; ++y)
+		{
+			FilterRow(y);
+		}
+	}
+	return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "Spectrum.h"
+
+template<typename T>
+struct Texture2D;
+
+class Film;
+class TaskScheduler;
+
+struct DenoiserDesc
+{
+	// Half width of the filter window in pixels
+	int Radius = 5;
+
+	// Falloff of the weights with distance, difference in albedo and difference in normal
+	float SigmaSpatial = 3.0f;
+	float SigmaAlbedo  = 0.1f;
+	float SigmaNormal  = 0.2f;
+	// Color differences are measured relative to the standard error of the pixels' estimates
+	float SigmaColor = 1.0f;
+};
+
+/*
+ *	Cross-bilateral filter guided by the albedo and normal AOVs of the film. Radiance is divided by the
+ *	albedo before filtering so texture detail isn't blurred, neighbours only contribute if they have a
+ *	similar albedo and normal and a color that is within the noise level of both pixels' estimates.
+ *	The guides are stored in padded planes and the window is evaluated four neighbours at a time with
+ *	DirectXMath, rows are distributed over the task scheduler
+ */
+class Denoiser
+{
+public:
+	Denoiser(const DenoiserDesc& Desc = {});
+
+	/*
+	 *	Filters Image, the film's resolved radiance, in place. Film must have the albedo and normal AOVs,
+	 *	without a scheduler the rows are filtered on the calling thread
+	 */
+	bool Denoise(const Film& Film, Texture2D<RGBSpectrum>& Image, TaskScheduler* pScheduler) const;
+
+private:
+	DenoiserDesc Desc;
+};
@@ -0,0 +1,470 @@
+#include "Film.h"
+#include "Texture2D.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+struct FilmCheckpointHeader
+{
+	static constexpr char	  Magic[4] = { 'K', 'H', 'R', 'F' };
+	static constexpr uint32_t Version  = 6;
+
+	char	 Signature[4];
+	uint32_t FileVersion;
+	int32_t	 Left, Top, Right, Bottom;
+	int32_t	 NumSamplesRendered;
+	uint32_t PixelSize;
+	uint32_t StatisticsSize;
+	uint32_t AOVPixelSize; // 0 without sampled AOVs
+	uint32_t SplatSize; // 0 without light tracing
+	uint32_t Padding;
+	uint64_t NumLightPaths;
+
+	FilmCheckpointSettings Settings;
+};
+
+FilmTileBuffer::FilmTileBuffer(const Film& Film, const RECT& Tile)
+	: pFilter(&Film.GetFilter())
+	, PaddedRect(Film.GetPaddedRect(Tile))
+	, Width(PaddedRect.right - PaddedRect.left)
+	, Pixels(size_t(Width) * size_t(PaddedRect.bottom - PaddedRect.top))
+{
+}
+
+void FilmTileBuffer::AddSample(Vector2f FilmPosition, const Spectrum& L)
+{
+	// Pixels whose center is within the filter radius of the sample
+	const float Radius = pFilter->GetRadius();
+	const int	x0	   = std::max(int(std::ceil(FilmPosition.x - 0.5f - Radius)), int(PaddedRect.left));
+	const int	x1	   = std::min(int(std::floor(FilmPosition.x - 0.5f + Radius)), int(PaddedRect.right) - 1);
+	const int	y0	   = std::max(int(std::ceil(FilmPosition.y - 0.5f - Radius)), int(PaddedRect.top));
+	const int	y1	   = std::min(int(std::floor(FilmPosition.y - 0.5f + Radius)), int(PaddedRect.bottom) - 1);
+
+	for (int y = y0; y <= y1; ++y)
+	{
+		for (int x = x0; x <= x1; ++x)
+		{
+			float Weight = pFilter->Weight(float(x) + 0.5f - FilmPosition.x, float(y) + 0.5f - FilmPosition.y);
+			if (Weight == 0.0f)
+			{
+				continue;
+			}
+
+			FilmPixel& Pixel = Pixels[size_t(y - PaddedRect.top) * Width + size_t(x - PaddedRect.left)];
+			Pixel.WeightedSum += L * Weight;
+			Pixel.WeightSum += Weight;
+		}
+	}
+}
+
+Film::Film(
+	const RECT&		  PixelBounds,
+	const FilterDesc& FilterDesc /*= {}*/,
+	const AOVDesc&	  AOVs /*= {}*/,
+	bool			  LightTracing /*= false*/)
+	: PixelBounds(PixelBounds)
+	, Width(PixelBounds.right - PixelBounds.left)
+	, Height(PixelBounds.bottom - PixelBounds.top)
+	, ReconstructionFilter(FilterDesc)
+	, AOVs(AOVs)
+	, Pixels(size_t(Width) * Height)
+	, Statistics(size_t(Width) * Height)
+	, AOVPixels(AOVs.NeedsSamples() ? size_t(Width) * Height : 0)
+	, Splats(LightTracing ? size_t(Width) * Height * Spectrum::NumCoefficients : 0)
+{
+}
+
+RECT Film::GetPaddedRect(const RECT& Tile) const
+{
+	// A sample inside pixel x reaches the pixels whose center is closer than the radius
+	const LONG Padding = LONG(std::ceil(ReconstructionFilter.GetRadius() - 0.5f));
+	return { std::max(Tile.left - Padding, PixelBounds.left),
+			 std::max(Tile.top - Padding, PixelBounds.top),
+			 std::min(Tile.right + Padding, PixelBounds.right),
+			 std::min(Tile.bottom + Padding, PixelBounds.bottom) };
+}
+
+void Film::AddSampleStatistics(int x, int y, const Spectrum& L)
+{
+	PixelStatistics& Pixel = Statistics[GetPixelIndex(x, y)];
+	Pixel.NumSamples++;
+
+	// Welford's online update of the luminance mean and sum of squared differences
+	const float Luminance = L.y();
+	const float Delta	  = Luminance - Pixel.LuminanceMean;
+	Pixel.LuminanceMean += Delta / float(Pixel.NumSamples);
+	Pixel.LuminanceM2 += Delta * (Luminance - Pixel.LuminanceMean);
+}
+
+void Film::AddAOVSample(int x, int y, const AOVSample& Sample, const Spectrum& L)
+{
+	if (AOVPixels.empty())
+	{
+		return;
+	}
+
+	AOVPixel& Pixel = AOVPixels[GetPixelIndex(x, y)];
+	Pixel.Albedo += Sample.Albedo;
+	Pixel.Normal += Sample.Normal;
+	Pixel.Direct += Sample.Direct;
+	Pixel.Indirect += L - Sample.Direct;
+	if (Sample.Hit)
+	{
+		Pixel.Depth += Sample.Depth;
+		if (Pixel.NumHits++ == 0)
+		{
+			Pixel.InstanceID = Sample.InstanceID;
+			Pixel.GeometryID = Sample.GeometryID;
+		}
+	}
+}
+
+void Film::AddSplat(Vector2f FilmPosition, const Spectrum& L)
+{
+	if (Splats.empty())
+	{
+		return;
+	}
+
+	// Same pixels as FilmTileBuffer::AddSample, clipped to the pixel bounds
+	const float Radius = ReconstructionFilter.GetRadius();
+	const int	x0	   = std::max(int(std::ceil(FilmPosition.x - 0.5f - Radius)), int(PixelBounds.left));
+	const int	x1	   = std::min(int(std::floor(FilmPosition.x - 0.5f + Radius)), int(PixelBounds.right) - 1);
+	const int	y0	   = std::max(int(std::ceil(FilmPosition.y - 0.5f - Radius)), int(PixelBounds.top));
+	const int	y1	   = std::min(int(std::floor(FilmPosition.y - 0.5f + Radius)), int(PixelBounds.bottom) - 1);
+
+	const float InvIntegral = 1.0f / ReconstructionFilter.GetIntegral();
+	for (int y = y0; y <= y1; ++y)
+	{
+		for (int x = x0; x <= x1; ++x)
+		{
+			float Weight =
+				ReconstructionFilter.Weight(float(x) + 0.5f - FilmPosition.x, float(y) + 0.5f - FilmPosition.y);
+			if (Weight == 0.0f)
+			{
+				continue;
+			}
+
+			std::atomic<float>* pSplat = &Splats[GetPixelIndex(x, y) * Spectrum::NumCoefficients];
+			for (int i = 0; i < Spectrum::NumCoefficients; ++i)
+			{
+				if (L[i] != 0.0f)
+				{
+					pSplat[i].fetch_add(L[i] * Weight * InvIntegral, std::memory_order_relaxed);
+				}
+			}
+		}
+	}
+}
+
+void Film::AddLightPaths(unsigned long long NumPaths)
+{
+	NumLightPaths.fetch_add(NumPaths, std::memory_order_relaxed);
+}
+
+void Film::MergeTileBuffer(const FilmTileBuffer& TileBuffer)
+{
+	MergeTilePixels(TileBuffer.GetPaddedRect(), TileBuffer.GetPixels().data());
+}
+
+bool Film::MergeTileBuffer(const RECT& Tile, std::span<const std::byte> Data)
+{
+	const RECT	 PaddedRect = GetPaddedRect(Tile);
+	const size_t NumPixels	= size_t(PaddedRect.right - PaddedRect.left) * size_t(PaddedRect.bottom - PaddedRect.top);
+	if (PaddedRect.left >= PaddedRect.right || PaddedRect.top >= PaddedRect.bottom ||
+		Data.size() != NumPixels * sizeof(FilmPixel))
+	{
+		return false;
+	}
+
+	std::vector<FilmPixel> TilePixels(NumPixels);
+	memcpy(TilePixels.data(), Data.data(), Data.size());
+	MergeTilePixels(PaddedRect, TilePixels.data());
+	return true;
+}
+
+void Film::MergeTilePixels(const RECT& PaddedRect, const FilmPixel* pSrc)
+{
+	// Padded areas of neighbouring tiles overlap, merges are serialized
+	std::scoped_lock _(MergeMutex);
+	for (int y = PaddedRect.top; y < PaddedRect.bottom; ++y)
+	{
+		FilmPixel* pDst = &Pixels[GetPixelIndex(PaddedRect.left, y)];
+		for (int x = PaddedRect.left; x < PaddedRect.right; ++x)
+		{
+			pDst->WeightedSum += pSrc->WeightedSum;
+			pDst->WeightSum += pSrc->WeightSum;
+			++pDst;
+			++pSrc;
+		}
+	}
+}
+
+Spectrum Film::GetPixel(int x, int y) const
+{
+	// Filters with negative lobes can ring below zero around sharp edges
+	const FilmPixel& Pixel = Pixels[GetPixelIndex(x, y)];
+	Spectrum		 L	   = Pixel.WeightSum > 0.0f ? (Pixel.WeightedSum / Pixel.WeightSum).Clamp() : Spectrum(0.0f);
+
+	const unsigned long long NumPaths = NumLightPaths.load(std::memory_order_relaxed);
+	if (NumPaths > 0 && !Splats.empty())
+	{
+		const std::atomic<float>* pSplat = &Splats[GetPixelIndex(x, y) * Spectrum::NumCoefficients];
+		for (int i = 0; i < Spectrum::NumCoefficients; ++i)
+		{
+			L[i] += pSplat[i].load(std::memory_order_relaxed) / float(NumPaths);
+		}
+	}
+	return L;
+}
+
+int Film::GetNumSamples(int x, int y) const
+{
+	return Statistics[GetPixelIndex(x, y)].NumSamples;
+}
+
+float Film::GetVariance(int x, int y) const
+{
+	const PixelStatistics& Pixel = Statistics[GetPixelIndex(x, y)];
+	return Pixel.NumSamples > 1 ? Pixel.LuminanceM2 / float(Pixel.NumSamples - 1) : 0.0f;
+}
+
+float Film::GetRelativeError(int x, int y) const
+{
+	const PixelStatistics& Pixel = Statistics[GetPixelIndex(x, y)];
+	if (Pixel.NumSamples < 2)
+	{
+		return std::numeric_limits<float>::infinity();
+	}
+
+	float StandardError = std::sqrt(GetVariance(x, y) / float(Pixel.NumSamples));
+	return StandardError / std::sqrt(std::max(Pixel.LuminanceMean, 1e-4f));
+}
+
+unsigned long long Film::GetTotalNumSamples() const
+{
+	unsigned long long NumSamples = 0;
+	for (const auto& Pixel : Statistics)
+	{
+		NumSamples += Pixel.NumSamples;
+	}
+	return NumSamples;
+}
+
+Spectrum Film::GetAlbedo(int x, int y) const
+{
+	const int NumSamples = GetNumSamples(x, y);
+	return NumSamples > 0 ? AOVPixels[GetPixelIndex(x, y)].Albedo / float(NumSamples) : Spectrum(0.0f);
+}
+
+Vector3f Film::GetNormal(int x, int y) const
+{
+	// The average of the normals of a pixel is renormalized, normals of opposing sides can cancel out
+	const Vector3f Normal = AOVPixels[GetPixelIndex(x, y)].Normal;
+	const float	   Length = Normal.Length();
+	return Length > 0.0f ? Normal / Length : Vector3f(0.0f);
+}
+
+float Film::GetDepth(int x, int y) const
+{
+	const AOVPixel& Pixel = AOVPixels[GetPixelIndex(x, y)];
+	return Pixel.NumHits > 0 ? Pixel.Depth / float(Pixel.NumHits) : std::numeric_limits<float>::infinity();
+}
+
+unsigned int Film::GetInstanceID(int x, int y) const
+{
+	return AOVPixels[GetPixelIndex(x, y)].InstanceID;
+}
+
+unsigned int Film::GetGeometryID(int x, int y) const
+{
+	return AOVPixels[GetPixelIndex(x, y)].GeometryID;
+}
+
+Spectrum Film::GetDirect(int x, int y) const
+{
+	const int NumSamples = GetNumSamples(x, y);
+	return NumSamples > 0 ? AOVPixels[GetPixelIndex(x, y)].Direct / float(NumSamples) : Spectrum(0.0f);
+}
+
+Spectrum Film::GetIndirect(int x, int y) const
+{
+	const int NumSamples = GetNumSamples(x, y);
+	return NumSamples > 0 ? AOVPixels[GetPixelIndex(x, y)].Indirect / float(NumSamples) : Spectrum(0.0f);
+}
+
+void Film::Resolve(Texture2D<RGBSpectrum>& Output) const
+{
+	for (int y = PixelBounds.top; y < PixelBounds.bottom; ++y)
+	{
+		for (int x = PixelBounds.left; x < PixelBounds.right; ++x)
+		{
+			Output.SetPixel(x - PixelBounds.left, y - PixelBounds.top, GetPixel(x, y));
+		}
+	}
+}
+
+std::vector<std::byte> Film::ReadTileStatistics(const RECT& Rect) const
+{
+	// Statistics of the whole rect followed by its AOVs
+	const size_t		   RowSize	  = size_t(Rect.right - Rect.left) * sizeof(PixelStatistics);
+	const size_t		   AOVRowSize = AOVPixels.empty() ? 0 : size_t(Rect.right - Rect.left) * sizeof(AOVPixel);
+	std::vector<std::byte> Data((RowSize + AOVRowSize) * size_t(Rect.bottom - Rect.top));
+
+	std::byte* pDst = Data.data();
+	for (int y = Rect.top; y < Rect.bottom; ++y)
+	{
+		memcpy(pDst, &Statistics[GetPixelIndex(Rect.left, y)], RowSize);
+		pDst += RowSize;
+	}
+	for (int y = Rect.top; y < Rect.bottom && AOVRowSize > 0; ++y)
+	{
+		memcpy(pDst, &AOVPixels[GetPixelIndex(Rect.left, y)], AOVRowSize);
+		pDst += AOVRowSize;
+	}
+	return Data;
+}
+
+bool Film::WriteTileStatistics(const RECT& Rect, std::span<const std::byte> Data)
+{
+	if (Rect.left < PixelBounds.left || Rect.top < PixelBounds.top || Rect.right > PixelBounds.right ||
+		Rect.bottom > PixelBounds.bottom || Rect.left >= Rect.right || Rect.top >= Rect.bottom)
+	{
+		return false;
+	}
+
+	const size_t RowSize	= size_t(Rect.right - Rect.left) * sizeof(PixelStatistics);
+	const size_t AOVRowSize = AOVPixels.empty() ? 0 : size_t(Rect.right - Rect.left) * sizeof(AOVPixel);
+	if (Data.size() != (RowSize + AOVRowSize) * size_t(Rect.bottom - Rect.top))
+	{
+		return false;
+	}
+
+	const std::byte* pSrc = Data.data();
+	for (int y = Rect.top; y < Rect.bottom; ++y)
+	{
+		memcpy(&Statistics[GetPixelIndex(Rect.left, y)], pSrc, RowSize);
+		pSrc += RowSize;
+	}
+	for (int y = Rect.top; y < Rect.bottom && AOVRowSize > 0; ++y)
+	{
+		memcpy(&AOVPixels[GetPixelIndex(Rect.left, y)], pSrc, AOVRowSize);
+		pSrc += AOVRowSize;
+	}
+	return true;
+}
+
+bool Film::SaveCheckpoint(
+	const std::filesystem::path&  Path,
+	int							  NumSamplesRendered,
+	const FilmCheckpointSettings& Settings) const
+{
+	FilmCheckpointHeader Header = {};
+	memcpy(Header.Signature, FilmCheckpointHeader::Magic, sizeof(Header.Signature));
+	Header.FileVersion		  = FilmCheckpointHeader::Version;
+	Header.Left				  = PixelBounds.left;
+	Header.Top				  = PixelBounds.top;
+	Header.Right			  = PixelBounds.right;
+	Header.Bottom			  = PixelBounds.bottom;
+	Header.NumSamplesRendered = NumSamplesRendered;
+	Header.PixelSize		  = sizeof(FilmPixel);
+	Header.StatisticsSize	  = sizeof(PixelStatistics);
+	Header.AOVPixelSize		  = AOVPixels.empty() ? 0 : sizeof(AOVPixel);
+	Header.SplatSize		  = Splats.empty() ? 0 : sizeof(float) * Spectrum::NumCoefficients;
+	Header.NumLightPaths	  = NumLightPaths.load();
+	Header.Settings			  = Settings;
+
+	// Splats are written as plain floats, nothing adds to them while a checkpoint is taken
+	std::vector<float> SplatValues(Splats.size());
+	for (size_t i = 0; i < Splats.size(); ++i)
+	{
+		SplatValues[i] = Splats[i].load(std::memory_order_relaxed);
+	}
+
+	std::filesystem::path TempPath = Path;
+	TempPath += ".tmp";
+	{
+		std::ofstream Stream(TempPath, std::ios::binary | std::ios::trunc);
+		if (!Stream)
+		{
+			return false;
+		}
+
+		Stream.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+		Stream.write(reinterpret_cast<const char*>(Pixels.data()), std::streamsize(Pixels.size() * sizeof(FilmPixel)));
+		Stream.write(
+			reinterpret_cast<const char*>(Statistics.data()),
+			std::streamsize(Statistics.size() * sizeof(PixelStatistics)));
+		Stream.write(
+			reinterpret_cast<const char*>(AOVPixels.data()), std::streamsize(AOVPixels.size() * sizeof(AOVPixel)));
+		Stream.write(
+			reinterpret_cast<const char*>(SplatValues.data()), std::streamsize(SplatValues.size() * sizeof(float)));
+		if (!Stream)
+		{
+			return false;
+		}
+	}
+
+	std::error_code ErrorCode;
+	std::filesystem::rename(TempPath, Path, ErrorCode);
+	return !ErrorCode;
+}
+
+bool Film::LoadCheckpoint(
+	const std::filesystem::path&  Path,
+	const FilmCheckpointSettings& Settings,
+	int*						  pNumSamplesRendered)
+{
+	std::ifstream Stream(Path, std::ios::binary);
+	if (!Stream)
+	{
+		return false;
+	}
+
+	FilmCheckpointHeader Header = {};
+	Stream.read(reinterpret_cast<char*>(&Header), sizeof(Header));
+	if (!Stream || memcmp(Header.Signature, FilmCheckpointHeader::Magic, sizeof(Header.Signature)) != 0 ||
+		Header.FileVersion != FilmCheckpointHeader::Version || Header.Left != PixelBounds.left ||
+		Header.Top != PixelBounds.top || Header.Right != PixelBounds.right || Header.Bottom != PixelBounds.bottom ||
+		Header.PixelSize != sizeof(FilmPixel) || Header.StatisticsSize != sizeof(PixelStatistics) ||
+		Header.AOVPixelSize != (AOVPixels.empty() ? 0 : sizeof(AOVPixel)) ||
+		Header.SplatSize != (Splats.empty() ? 0 : sizeof(float) * Spectrum::NumCoefficients) ||
+		Header.NumSamplesRendered < 0 || Header.Settings != Settings)
+	{
+		return false;
+	}
+
+	std::vector<FilmPixel>		 CheckpointPixels(Pixels.size());
+	std::vector<PixelStatistics> CheckpointStatistics(Statistics.size());
+	std::vector<AOVPixel>		 CheckpointAOVPixels(AOVPixels.size());
+	std::vector<float>			 CheckpointSplats(Splats.size());
+	Stream.read(
+		reinterpret_cast<char*>(CheckpointPixels.data()),
+		std::streamsize(CheckpointPixels.size() * sizeof(FilmPixel)));
+	Stream.read(
+		reinterpret_cast<char*>(CheckpointStatistics.data()),
+		std::streamsize(CheckpointStatistics.size() * sizeof(PixelStatistics)));
+	Stream.read(
+		reinterpret_cast<char*>(CheckpointAOVPixels.data()),
+		std::streamsize(CheckpointAOVPixels.size() * sizeof(AOVPixel)));
+	Stream.read(
+		reinterpret_cast<char*>(CheckpointSplats.data()), std::streamsize(CheckpointSplats.size() * sizeof(float)));
+	if (!Stream)
+	{
+		return false;
+	}
+
+	Pixels				 = std::move(CheckpointPixels);
+	Statistics			 = std::move(CheckpointStatistics);
+	AOVPixels			 = std::move(CheckpointAOVPixels);
+	for (size_t i = 0; i < Splats.size(); ++i)
+	{
+		Splats[i].store(CheckpointSplats[i], std::memory_order_relaxed);
+	}
+	NumLightPaths		 = Header.NumLightPaths;
+	*pNumSamplesRendered = Header.NumSamplesRendered;
+	return true;
+}
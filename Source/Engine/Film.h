@@ -0,0 +1,246 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <vector>
+#include "Math/Math.h"
+#include "Spectrum.h"
+#include "Filter.h"
+
+template<typename T>
+struct Texture2D;
+
+class Film;
+
+/*
+ *	Arbitrary output variables rendered along with the radiance. Albedo, Normal (shading normal in world
+ *	space), Depth (distance to the camera) and the IDs describe the first surface a camera sample hits,
+ *	Direct and Indirect split the radiance into light reaching the camera after at most one bounce and the
+ *	rest. SampleCount and Variance come from the pixel statistics.
+ *	AOVs are averaged over the samples of a pixel without the reconstruction filter, Depth over the samples
+ *	that hit something, the IDs are those of the first sample that hit something
+ */
+struct AOVDesc
+{
+	bool Albedo		 = false;
+	bool Normal		 = false;
+	bool Depth		 = false;
+	bool InstanceID	 = false;
+	bool GeometryID	 = false;
+	bool Direct		 = false;
+	bool Indirect	 = false;
+	bool SampleCount = false;
+	bool Variance	 = false;
+
+	// Whether an AOV needs data from the camera samples, the others are derived from the pixel statistics
+	bool NeedsSamples() const noexcept
+	{
+		return Albedo || Normal || Depth || InstanceID || GeometryID || Direct || Indirect;
+	}
+	bool Any() const noexcept { return NeedsSamples() || SampleCount || Variance; }
+};
+
+// First hit quantities of a camera sample, Direct is the part of the sample's radiance that is direct lighting
+struct AOVSample
+{
+	bool		 Hit		= false;
+	Spectrum	 Albedo		= Spectrum(0.0f);
+	Vector3f	 Normal		= Vector3f(0.0f);
+	float		 Depth		= 0.0f;
+	unsigned int InstanceID = ~0u;
+	unsigned int GeometryID = ~0u;
+	Spectrum	 Direct		= Spectrum(0.0f);
+};
+
+/*
+ *	Sampling settings a checkpoint was rendered with, it only resumes a render with the same ones since the
+ *	samples that follow would not continue the ones already in the film. The adaptive sampling fields are 0
+ *	without adaptive sampling
+ */
+struct FilmCheckpointSettings
+{
+	uint32_t SamplerType;
+	int32_t	 NumSamplesPerPixel;
+	uint32_t Seed;
+	uint32_t AdaptiveSampling;
+	int32_t	 MinSamplesPerPixel;
+	int32_t	 MaxSamplesPerPixel;
+	float	 AdaptiveThreshold;
+
+	bool operator==(const FilmCheckpointSettings&) const = default;
+};
+
+// Reconstructed radiance of a pixel is WeightedSum / WeightSum
+struct FilmPixel
+{
+	Spectrum WeightedSum = Spectrum(0.0f);
+	float	 WeightSum	 = 0.0f;
+};
+
+/*
+ *	Private accumulation buffer of a single tile. Samples are splatted with the film's filter into the
+ *	tile's pixels plus a border of the filter radius, the buffer is merged into the film once the tile is
+ *	done so threads never contend on the pixels that neighbouring tiles share
+ */
+class FilmTileBuffer
+{
+public:
+	FilmTileBuffer(const Film& Film, const RECT& Tile);
+
+	const RECT& GetPaddedRect() const noexcept { return PaddedRect; }
+
+	// FilmPosition is the continuous image position of the sample, pixel (x, y) covers [x, x + 1) x [y, y + 1)
+	void AddSample(Vector2f FilmPosition, const Spectrum& L);
+
+	std::span<const FilmPixel> GetPixels() const noexcept { return Pixels; }
+
+private:
+	const Filter*		   pFilter;
+	RECT				   PaddedRect;
+	int					   Width;
+	std::vector<FilmPixel> Pixels;
+};
+
+/*
+ *	Holds the reconstruction filtered radiance of the pixels inside PixelBounds along with per-pixel sample
+ *	statistics and, for integrators that trace light paths, their splats. Pixel coordinates passed to the film are
+ *	image coordinates, so a cropped film is addressed just like a full one.
+ *	The statistics track the running variance of the luminance of the samples taken for a pixel with Welford's
+ *	algorithm, which is what adaptive sampling uses to decide when a pixel has converged. They are only updated
+ *	by the owner of the pixel's tile and need no synchronization, filtered samples reach the film through
+ *	FilmTileBuffer merges.
+ */
+class Film
+{
+public:
+	// The splats are only allocated and checkpointed with LightTracing
+	Film(
+		const RECT&		  PixelBounds,
+		const FilterDesc& FilterDesc   = {},
+		const AOVDesc&	  AOVs		   = {},
+		bool			  LightTracing = false);
+
+	const RECT&	   GetPixelBounds() const noexcept { return PixelBounds; }
+	int			   GetWidth() const noexcept { return Width; }
+	int			   GetHeight() const noexcept { return Height; }
+	const Filter&  GetFilter() const noexcept { return ReconstructionFilter; }
+	const AOVDesc& GetAOVs() const noexcept { return AOVs; }
+
+	// Area of Tile plus the border its samples can splat into, clipped to the pixel bounds
+	RECT GetPaddedRect(const RECT& Tile) const;
+
+	// Records a sample of pixel (x, y) in the pixel's statistics, the sample itself goes to a FilmTileBuffer
+	void AddSampleStatistics(int x, int y, const Spectrum& L);
+	// Records the AOVs of a sample of pixel (x, y) with radiance L, does nothing unless the film has sampled AOVs
+	void AddAOVSample(int x, int y, const AOVSample& Sample, const Spectrum& L);
+
+	/*
+	 *	Light paths connected to the camera land anywhere on the film, their contributions are splatted with
+	 *	atomic adds instead of going through tile buffers. A splat reaches the pixels within the filter radius
+	 *	weighted by the filter over its integral, so it estimates the same filtered pixel value as the camera
+	 *	samples. The splats of a pixel are divided by the number of light paths traced for the whole film, see
+	 *	AddLightPaths. Splats don't enter the pixel statistics. Does nothing without LightTracing
+	 */
+	void AddSplat(Vector2f FilmPosition, const Spectrum& L);
+	void AddLightPaths(unsigned long long NumPaths);
+
+	void MergeTileBuffer(const FilmTileBuffer& TileBuffer);
+	// Merges the pixels of a tile buffer of Tile received from another process, fails if Data has the wrong size
+	bool MergeTileBuffer(const RECT& Tile, std::span<const std::byte> Data);
+
+	// Filtered radiance of the samples plus the pixel's share of the splats
+	Spectrum GetPixel(int x, int y) const;
+	int		 GetNumSamples(int x, int y) const;
+	// Unbiased estimate of the variance of the sample luminance
+	float GetVariance(int x, int y) const;
+	/*
+	 *	Standard error of the luminance mean relative to the square root of the mean, dividing by the square root
+	 *	keeps dark pixels (where noise is most visible after gamma correction) from converging too early
+	 */
+	float GetRelativeError(int x, int y) const;
+
+	unsigned long long GetTotalNumSamples() const;
+
+	// AOVs of pixel (x, y), only valid if the film was created with the AOV enabled
+	Spectrum	 GetAlbedo(int x, int y) const;
+	Vector3f	 GetNormal(int x, int y) const;
+	float		 GetDepth(int x, int y) const; // Infinity if no sample hit anything
+	unsigned int GetInstanceID(int x, int y) const;
+	unsigned int GetGeometryID(int x, int y) const;
+	Spectrum	 GetDirect(int x, int y) const;
+	Spectrum	 GetIndirect(int x, int y) const;
+
+	// Output is the size of the pixel bounds, its origin is the top left pixel of the bounds
+	void Resolve(Texture2D<RGBSpectrum>& Output) const;
+
+	/*
+	 *	Sample statistics and sampled AOVs of Rect in row-major order, used to ship tiles between render
+	 *	processes of the same build. WriteTileStatistics fails if Rect is outside the film or Data has the
+	 *	wrong size
+	 */
+	std::vector<std::byte> ReadTileStatistics(const RECT& Rect) const;
+	bool				   WriteTileStatistics(const RECT& Rect, std::span<const std::byte> Data);
+
+	/*
+	 *	Checkpoints store the filtered pixels, statistics, splats if any and sampled AOVs along with the number of
+	 *	sample indices rendered so far. That is all the sampler state there is since samples are generated from
+	 *	(x, y, SampleIndex).
+	 *	The file is written next to Path first and then renamed so a crash never leaves a truncated checkpoint
+	 */
+	bool SaveCheckpoint(
+		const std::filesystem::path&  Path,
+		int							  NumSamplesRendered,
+		const FilmCheckpointSettings& Settings) const;
+	/*
+	 *	Leaves the film untouched and returns false if the checkpoint is missing, corrupt or has other pixel
+	 *	bounds or settings
+	 */
+	bool LoadCheckpoint(
+		const std::filesystem::path&  Path,
+		const FilmCheckpointSettings& Settings,
+		int*						  pNumSamplesRendered);
+
+private:
+	struct PixelStatistics
+	{
+		float LuminanceMean = 0.0f;
+		float LuminanceM2	= 0.0f;
+		int	  NumSamples	= 0;
+	};
+
+	// Sums over the samples of a pixel, divided by the sample count on lookup
+	struct AOVPixel
+	{
+		Spectrum	 Albedo		= Spectrum(0.0f);
+		Vector3f	 Normal		= Vector3f(0.0f);
+		float		 Depth		= 0.0f;
+		int			 NumHits	= 0;
+		unsigned int InstanceID = ~0u;
+		unsigned int GeometryID = ~0u;
+		Spectrum	 Direct		= Spectrum(0.0f);
+		Spectrum	 Indirect	= Spectrum(0.0f);
+	};
+
+	size_t GetPixelIndex(int x, int y) const
+	{
+		return size_t(y - PixelBounds.top) * Width + size_t(x - PixelBounds.left);
+	}
+
+	void MergeTilePixels(const RECT& PaddedRect, const FilmPixel* pSrc);
+
+	RECT	PixelBounds;
+	int		Width, Height;
+	Filter	ReconstructionFilter;
+	AOVDesc AOVs;
+
+	std::mutex					 MergeMutex;
+	std::vector<FilmPixel>		 Pixels;
+	std::vector<PixelStatistics> Statistics;
+	std::vector<AOVPixel>		 AOVPixels; // Empty unless sampled AOVs are enabled
+
+	// Spectrum::NumCoefficients sums per pixel, empty without light tracing
+	std::vector<std::atomic<float>> Splats;
+	std::atomic<unsigned long long> NumLightPaths = 0;
+};
@@ -0,0 +1,75 @@
+#include "Filter.h"
+#include "Math/Math.h"
+
+#include <algorithm>
+#include <cmath>
+
+Filter::Filter(const FilterDesc& Desc /*= {}*/)
+	: Desc(Desc)
+	, Radius(std::max(Desc.Radius, 0.5f))
+	, InvRadius(1.0f / Radius)
+{
+	for (int y = 0; y < TableSize; ++y)
+	{
+		for (int x = 0; x < TableSize; ++x)
+		{
+			float dx = (float(x) + 0.5f) * Radius / float(TableSize);
+			float dy = (float(y) + 0.5f) * Radius / float(TableSize);
+
+			Table[y * TableSize + x] = Evaluate(dx, dy);
+			Integral += Table[y * TableSize + x];
+		}
+	}
+
+	// The table covers one of the four quadrants
+	const float CellSize = Radius / float(TableSize);
+	Integral *= 4.0f * CellSize * CellSize;
+}
+
+float Filter::Evaluate(float dx, float dy) const
+{
+	return Evaluate1D(dx) * Evaluate1D(dy);
+}
+
+float Filter::Evaluate1D(float x) const
+{
+	x = std::abs(x);
+	if (x > Radius)
+	{
+		return 0.0f;
+	}
+
+	switch (Desc.Type)
+	{
+	case FilterType::Box:
+		return 1.0f;
+
+	case FilterType::Tent:
+		return Radius - x;
+
+	case FilterType::Gaussian:
+		return std::max(0.0f, std::exp(-Desc.Alpha * x * x) - std::exp(-Desc.Alpha * Radius * Radius));
+
+	case FilterType::Mitchell:
+	{
+		// The Mitchell-Netravali polynomial is defined over [0, 2]
+		const float B = Desc.B, C = Desc.C;
+		x			  = 2.0f * x * InvRadius;
+		if (x > 1.0f)
+		{
+			return ((-B - 6 * C) * x * x * x + (6 * B + 30 * C) * x * x + (-12 * B - 48 * C) * x + (8 * B + 24 * C)) *
+				   (1.0f / 6.0f);
+		}
+		return ((12 - 9 * B - 6 * C) * x * x * x + (-18 + 12 * B + 6 * C) * x * x + (6 - 2 * B)) * (1.0f / 6.0f);
+	}
+
+	case FilterType::BlackmanHarris:
+	{
+		// Window over [-Radius, Radius]
+		float t = 0.5f + 0.5f * x * InvRadius;
+		return 0.35875f - 0.48829f * std::cos(g_2PI * t) + 0.14128f * std::cos(2.0f * g_2PI * t) -
+			   0.01168f * std::cos(3.0f * g_2PI * t);
+	}
+	}
+	return 0.0f;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cmath>
+
+enum class FilterType
+{
+	Box,
+	Tent,
+	Gaussian,
+	Mitchell,
+	BlackmanHarris
+};
+
+struct FilterDesc
+{
+	FilterType Type = FilterType::Box;
+	// Half width of the filter's support in pixels
+	float Radius = 0.5f;
+
+	// Gaussian falloff
+	float Alpha = 2.0f;
+	// Mitchell-Netravali parameters
+	float B = 1.0f / 3.0f;
+	float C = 1.0f / 3.0f;
+};
+
+/*
+ *	Pixel reconstruction filter. Filters are separable and symmetric, so the filter is precomputed into
+ *	a table over one quadrant of its support and sample weights are looked up instead of evaluated
+ */
+class Filter
+{
+public:
+	static constexpr int TableSize = 16;
+
+	Filter(const FilterDesc& Desc = {});
+
+	float GetRadius() const noexcept { return Radius; }
+	// Integral of the tabulated filter over its support, normalizes splats that have no weight sum to divide by
+	float GetIntegral() const noexcept { return Integral; }
+
+	// Weight of a sample at offset (dx, dy) from the pixel center
+	float Weight(float dx, float dy) const
+	{
+		int x = int(std::abs(dx) * InvRadius * TableSize);
+		int y = int(std::abs(dy) * InvRadius * TableSize);
+		if (x >= TableSize || y >= TableSize)
+		{
+			return 0.0f;
+		}
+		return Table[y * TableSize + x];
+	}
+
+	float Evaluate(float dx, float dy) const;
+
+private:
+	float Evaluate1D(float x) const;
+
+	FilterDesc Desc;
+	float	   Radius;
+	float	   InvRadius;
+	float	   Integral = 0.0f;
+	float	   Table[TableSize * TableSize];
+};
@@ -0,0 +1,592 @@
+#include "ImageIO.h"
+#include "Texture2D.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#define STBI_MSC_SECURE_CRT
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image_write.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+static_assert(sizeof(RGBSpectrum) == 3 * sizeof(float), "RGBSpectrum is read as 3 packed floats");
+
+static uint32_t Crc32(const uint8_t* pData, size_t Size, uint32_t Crc = 0)
+{
+	static const auto Table = []()
+	{
+		std::array<uint32_t, 256> Table;
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			uint32_t Value = i;
+			for (int Bit = 0; Bit < 8; ++Bit)
+			{
+				Value = (Value & 1) ? 0xedb88320u ^ (Value >> 1) : Value >> 1;
+			}
+			Table[i] = Value;
+		}
+		return Table;
+	}();
+
+	Crc = ~Crc;
+	for (size_t i = 0; i < Size; ++i)
+	{
+		Crc = Table[(Crc ^ pData[i]) & 0xff] ^ (Crc >> 8);
+	}
+	return ~Crc;
+}
+
+static void AppendBigEndian(std::vector<uint8_t>& Buffer, uint32_t Value)
+{
+	Buffer.insert(Buffer.end(), { uint8_t(Value >> 24), uint8_t(Value >> 16), uint8_t(Value >> 8), uint8_t(Value) });
+}
+
+static void AppendPNGChunk(std::vector<uint8_t>& File, const char (&Type)[5], const std::vector<uint8_t>& Data)
+{
+	AppendBigEndian(File, uint32_t(Data.size()));
+	const size_t TypeOffset = File.size();
+	File.insert(File.end(), Type, Type + 4);
+	File.insert(File.end(), Data.begin(), Data.end());
+	AppendBigEndian(File, Crc32(&File[TypeOffset], File.size() - TypeOffset));
+}
+
+// stb only writes 8-bit PNGs, 16-bit RGB images are encoded here with stb's deflate
+static bool WritePNG16(const std::filesystem::path& Path, int Width, int Height, const uint16_t* pPixels)
+{
+	// Every scanline starts with its filter type, the Sub filter stores the difference to the pixel on the left
+	constexpr size_t	 BytesPerPixel = 6;
+	const size_t		 RowSize	   = size_t(Width) * BytesPerPixel;
+	std::vector<uint8_t> Scanlines((RowSize + 1) * Height);
+	std::vector<uint8_t> Row(RowSize);
+	for (int y = 0; y < Height; ++y)
+	{
+		const uint16_t* pSrc = pPixels + size_t(y) * Width * 3;
+		for (size_t i = 0; i < size_t(Width) * 3; ++i)
+		{
+			Row[2 * i]	   = uint8_t(pSrc[i] >> 8);
+			Row[2 * i + 1] = uint8_t(pSrc[i]);
+		}
+
+		uint8_t* pDst = &Scanlines[(RowSize + 1) * y];
+		pDst[0]		  = 1;
+		for (size_t i = 0; i < RowSize; ++i)
+		{
+			pDst[1 + i] = uint8_t(Row[i] - (i >= BytesPerPixel ? Row[i - BytesPerPixel] : 0));
+		}
+	}
+
+	int		 CompressedSize = 0;
+	uint8_t* pCompressed	= stbi_zlib_compress(Scanlines.data(), int(Scanlines.size()), &CompressedSize, 8);
+	if (!pCompressed)
+	{
+		return false;
+	}
+	std::vector<uint8_t> ImageData(pCompressed, pCompressed + CompressedSize);
+	free(pCompressed);
+
+	// 16 bits per channel, truecolor, deflate, adaptive filtering, no interlacing
+	std::vector<uint8_t> Header;
+	AppendBigEndian(Header, uint32_t(Width));
+	AppendBigEndian(Header, uint32_t(Height));
+	Header.insert(Header.end(), { 16, 2, 0, 0, 0 });
+
+	std::vector<uint8_t> File = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	AppendPNGChunk(File, "IHDR", Header);
+	AppendPNGChunk(File, "IDAT", ImageData);
+	AppendPNGChunk(File, "IEND", {});
+
+	std::ofstream Stream(Path, std::ios::binary | std::ios::trunc);
+	Stream.write(reinterpret_cast<const char*>(File.data()), std::streamsize(File.size()));
+	return bool(Stream);
+}
+
+bool WritePNG(
+	const std::filesystem::path&  Path,
+	const Texture2D<RGBSpectrum>& Image,
+	const TonemapDesc&			  Tonemap /*= {}*/,
+	int							  BitDepth /*= 8*/,
+	TaskScheduler*				  pScheduler /*= nullptr*/)
+{
+	constexpr int NumChannels = 3;
+	const size_t  NumValues	  = size_t(Image.Width) * Image.Height * NumChannels;
+
+	if (BitDepth == 16)
+	{
+		std::vector<uint16_t> Pixels(NumValues);
+		::Tonemap(Image, Tonemap, Pixels, pScheduler);
+		return WritePNG16(Path, int(Image.Width), int(Image.Height), Pixels.data());
+	}
+
+	std::vector<uint8_t> Pixels(NumValues);
+	::Tonemap(Image, Tonemap, Pixels, pScheduler);
+	return stbi_write_png(
+			   Path.string().c_str(), Image.Width, Image.Height, NumChannels, Pixels.data(), Image.Width * NumChannels) !=
+		   0;
+}
+
+bool WritePFM(const std::filesystem::path& Path, const Texture2D<RGBSpectrum>& Image)
+{
+	std::ofstream Stream(Path, std::ios::binary | std::ios::trunc);
+	if (!Stream)
+	{
+		return false;
+	}
+
+	// A negative scale marks little endian data, rows are stored bottom to top like the texture
+	char Header[64];
+	int	 HeaderSize = snprintf(Header, sizeof(Header), "PF\n%u %u\n-1.0\n", Image.Width, Image.Height);
+	Stream.write(Header, HeaderSize);
+	Stream.write(
+		reinterpret_cast<const char*>(Image.Pixels.get()), std::streamsize(Image.NumPixels * sizeof(RGBSpectrum)));
+	return bool(Stream);
+}
+
+static uint16_t FloatToHalf(float Value)
+{
+	uint32_t Bits;
+	memcpy(&Bits, &Value, sizeof(Bits));
+
+	const uint32_t Sign = (Bits >> 16) & 0x8000;
+	const uint32_t Abs	= Bits & 0x7fffffff;
+
+	// Infinity stays infinity, NaN stays a quiet NaN
+	if (Abs >= 0x7f800000)
+	{
+		return uint16_t(Sign | 0x7c00 | (Abs > 0x7f800000 ? 0x200 : 0));
+	}
+	// Too large for a half even before rounding
+	if (Abs >= 0x47800000)
+	{
+		return uint16_t(Sign | 0x7c00);
+	}
+	// Rounds to a half denormal or zero
+	if (Abs < 0x38800000)
+	{
+		if (Abs < 0x33000000)
+		{
+			return uint16_t(Sign);
+		}
+
+		const uint32_t Shift	 = 126 - (Abs >> 23);
+		const uint32_t Mantissa	 = (Abs & 0x7fffff) | 0x800000;
+		uint32_t	   Half		 = Mantissa >> Shift;
+		const uint32_t Remainder = Mantissa & ((1u << Shift) - 1);
+		const uint32_t Midpoint	 = 1u << (Shift - 1);
+		if (Remainder > Midpoint || (Remainder == Midpoint && (Half & 1)))
+		{
+			++Half;
+		}
+		return uint16_t(Sign | Half);
+	}
+
+	// Rebias the exponent and round the mantissa to nearest even, a carry correctly bumps the exponent
+	uint32_t	   Half		 = (Abs - 0x38000000) >> 13;
+	const uint32_t Remainder = Abs & 0x1fff;
+	if (Remainder > 0x1000 || (Remainder == 0x1000 && (Half & 1)))
+	{
+		++Half;
+	}
+	return uint16_t(Sign | Half);
+}
+
+class ExrWriter
+{
+public:
+	ExrWriter(int Width, int Height, std::span<const ExrChannel> ChannelList, const ExrWriteDesc& Desc)
+		: Width(Width)
+		, Height(Height)
+		, Channels(ChannelList.begin(), ChannelList.end())
+		, Desc(Desc)
+	{
+		// Readers expect the channel list sorted by name, the pixel data follows the same order
+		std::ranges::sort(Channels, {}, &ExrChannel::Name);
+	}
+
+	bool Write(const std::filesystem::path& Path)
+	{
+		std::vector<std::vector<uint8_t>> Chunks;
+		if (Desc.TileSize > 0)
+		{
+			const int NumTilesX = (Width + Desc.TileSize - 1) / Desc.TileSize;
+			const int NumTilesY = (Height + Desc.TileSize - 1) / Desc.TileSize;
+			for (int TileY = 0; TileY < NumTilesY; ++TileY)
+			{
+				for (int TileX = 0; TileX < NumTilesX; ++TileX)
+				{
+					std::vector<uint8_t> Chunk;
+					AppendValue(Chunk, int32_t(TileX));
+					AppendValue(Chunk, int32_t(TileY));
+					AppendValue(Chunk, int32_t(0)); // Level x
+					AppendValue(Chunk, int32_t(0)); // Level y
+					const int x0 = TileX * Desc.TileSize;
+					const int y0 = TileY * Desc.TileSize;
+					AppendBlock(
+						Chunk, x0, y0, std::min(x0 + Desc.TileSize, Width), std::min(y0 + Desc.TileSize, Height));
+					Chunks.push_back(std::move(Chunk));
+				}
+			}
+		}
+		else
+		{
+			const int LinesPerChunk = GetLinesPerChunk();
+			for (int y0 = 0; y0 < Height; y0 += LinesPerChunk)
+			{
+				std::vector<uint8_t> Chunk;
+				AppendValue(Chunk, int32_t(y0));
+				AppendBlock(Chunk, 0, y0, Width, std::min(y0 + LinesPerChunk, Height));
+				Chunks.push_back(std::move(Chunk));
+			}
+		}
+
+		std::vector<uint8_t> Header = WriteHeader();
+
+		// Offset table of the chunks, which follow it in the same order
+		uint64_t Offset = Header.size() + Chunks.size() * sizeof(uint64_t);
+		for (const auto& Chunk : Chunks)
+		{
+			AppendValue(Header, Offset);
+			Offset += Chunk.size();
+		}
+
+		std::ofstream Stream(Path, std::ios::binary | std::ios::trunc);
+		if (!Stream)
+		{
+			return false;
+		}
+
+		Stream.write(reinterpret_cast<const char*>(Header.data()), std::streamsize(Header.size()));
+		for (const auto& Chunk : Chunks)
+		{
+			Stream.write(reinterpret_cast<const char*>(Chunk.data()), std::streamsize(Chunk.size()));
+		}
+		return bool(Stream);
+	}
+
+private:
+	template<typename T>
+	static void AppendValue(std::vector<uint8_t>& Buffer, const T& Value)
+	{
+		const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(&Value);
+		Buffer.insert(Buffer.end(), pBytes, pBytes + sizeof(T));
+	}
+
+	static void AppendString(std::vector<uint8_t>& Buffer, const std::string& String)
+	{
+		Buffer.insert(Buffer.end(), String.begin(), String.end());
+		Buffer.push_back(0);
+	}
+
+	static void AppendAttribute(
+		std::vector<uint8_t>&	  Buffer,
+		const std::string&		  Name,
+		const std::string&		  Type,
+		const std::vector<uint8_t>& Value)
+	{
+		AppendString(Buffer, Name);
+		AppendString(Buffer, Type);
+		AppendValue(Buffer, int32_t(Value.size()));
+		Buffer.insert(Buffer.end(), Value.begin(), Value.end());
+	}
+
+	int GetLinesPerChunk() const { return Desc.Compression == ExrCompression::ZIP ? 16 : 1; }
+
+	bool IsHalf(const ExrChannel& Channel) const
+	{
+		return Desc.PixelType == ExrPixelType::Half && !Channel.FullPrecision;
+	}
+
+	std::vector<uint8_t> WriteHeader() const
+	{
+		std::vector<uint8_t> Header;
+		AppendValue(Header, int32_t(20000630));
+
+		// Version 2, bit 9 marks a single part tiled file and bit 10 names longer than 31 characters
+		bool LongNames = std::ranges::any_of(Channels, [](const ExrChannel& Channel) { return Channel.Name.size() > 31; });
+		AppendValue(Header, int32_t(2 | (Desc.TileSize > 0 ? 0x200 : 0) | (LongNames ? 0x400 : 0)));
+
+		std::vector<uint8_t> ChannelList;
+		for (const auto& Channel : Channels)
+		{
+			AppendString(ChannelList, Channel.Name);
+			AppendValue(ChannelList, int32_t(IsHalf(Channel) ? 1 : 2));
+			AppendValue(ChannelList, uint32_t(0)); // pLinear and reserved bytes
+			AppendValue(ChannelList, int32_t(1));  // x sampling
+			AppendValue(ChannelList, int32_t(1));  // y sampling
+		}
+		ChannelList.push_back(0);
+		AppendAttribute(Header, "channels", "chlist", ChannelList);
+
+		// The file format numbers ZIP compression of 16 scanlines as 3
+		uint8_t Compression = 0;
+		switch (Desc.Compression)
+		{
+		case ExrCompression::None:
+			Compression = 0;
+			break;
+		case ExrCompression::RLE:
+			Compression = 1;
+			break;
+		case ExrCompression::ZIP:
+			Compression = 3;
+			break;
+		}
+		AppendAttribute(Header, "compression", "compression", { Compression });
+
+		std::vector<uint8_t> Window;
+		AppendValue(Window, int32_t(0));
+		AppendValue(Window, int32_t(0));
+		AppendValue(Window, int32_t(Width - 1));
+		AppendValue(Window, int32_t(Height - 1));
+		AppendAttribute(Header, "dataWindow", "box2i", Window);
+		AppendAttribute(Header, "displayWindow", "box2i", Window);
+
+		AppendAttribute(Header, "lineOrder", "lineOrder", { 0 }); // Increasing y
+
+		std::vector<uint8_t> One;
+		AppendValue(One, 1.0f);
+		AppendAttribute(Header, "pixelAspectRatio", "float", One);
+		AppendAttribute(Header, "screenWindowCenter", "v2f", std::vector<uint8_t>(2 * sizeof(float), 0));
+		AppendAttribute(Header, "screenWindowWidth", "float", One);
+
+		if (Desc.TileSize > 0)
+		{
+			std::vector<uint8_t> TileDescription;
+			AppendValue(TileDescription, uint32_t(Desc.TileSize));
+			AppendValue(TileDescription, uint32_t(Desc.TileSize));
+			TileDescription.push_back(0); // One level, round down
+			AppendAttribute(Header, "tiles", "tiledesc", TileDescription);
+		}
+
+		Header.push_back(0);
+		return Header;
+	}
+
+	// Appends the data size and the (compressed) pixels of [x0, x1) x [y0, y1), y counts from the top
+	void AppendBlock(std::vector<uint8_t>& Chunk, int x0, int y0, int x1, int y1) const
+	{
+		// Scanlines one after the other, each holding all values of one channel before the next channel
+		std::vector<uint8_t> Data;
+		Data.reserve(size_t(x1 - x0) * size_t(y1 - y0) * Channels.size() * sizeof(float));
+		for (int y = y0; y < y1; ++y)
+		{
+			const size_t Row = size_t(Height - 1 - y) * Width;
+			for (const auto& Channel : Channels)
+			{
+				const bool Half = IsHalf(Channel);
+				for (int x = x0; x < x1; ++x)
+				{
+					float Value = Channel.pData[(Row + x) * Channel.Stride];
+					if (Half)
+					{
+						AppendValue(Data, FloatToHalf(Value));
+					}
+					else
+					{
+						AppendValue(Data, Value);
+					}
+				}
+			}
+		}
+
+		std::vector<uint8_t> Compressed = Compress(Data);
+		// A chunk that doesn't shrink is stored as is, readers tell the two apart by the size
+		const std::vector<uint8_t>& Payload =
+			!Compressed.empty() && Compressed.size() < Data.size() ? Compressed : Data;
+		AppendValue(Chunk, int32_t(Payload.size()));
+		Chunk.insert(Chunk.end(), Payload.begin(), Payload.end());
+	}
+
+	std::vector<uint8_t> Compress(const std::vector<uint8_t>& Data) const
+	{
+		if (Desc.Compression == ExrCompression::None || Data.empty())
+		{
+			return {};
+		}
+
+		/*
+		 *	Both RLE and ZIP split the bytes into even and odd halves and delta encode them, which makes the high
+		 *	bytes of neighbouring values line up as runs of small numbers
+		 */
+		const size_t		 Size = Data.size();
+		std::vector<uint8_t> Predicted(Size);
+		for (size_t i = 0, Even = 0, Odd = (Size + 1) / 2; i < Size; i += 2)
+		{
+			Predicted[Even++] = Data[i];
+			if (i + 1 < Size)
+			{
+				Predicted[Odd++] = Data[i + 1];
+			}
+		}
+
+		uint8_t Previous = Predicted[0];
+		for (size_t i = 1; i < Size; ++i)
+		{
+			uint8_t Value = Predicted[i];
+			Predicted[i]  = uint8_t(int(Value) - int(Previous) + (128 + 256));
+			Previous	  = Value;
+		}
+
+		if (Desc.Compression == ExrCompression::RLE)
+		{
+			return RunLengthEncode(Predicted);
+		}
+
+		int		 CompressedSize = 0;
+		uint8_t* pCompressed	= stbi_zlib_compress(Predicted.data(), int(Size), &CompressedSize, 8);
+		if (!pCompressed)
+		{
+			return {};
+		}
+
+		std::vector<uint8_t> Compressed(pCompressed, pCompressed + CompressedSize);
+		free(pCompressed);
+		return Compressed;
+	}
+
+	// Runs of 3 to 128 equal bytes are a count - 1 and the byte, other bytes are copied after a negative count
+	static std::vector<uint8_t> RunLengthEncode(const std::vector<uint8_t>& Data)
+	{
+		constexpr ptrdiff_t MinRunLength = 3;
+		constexpr ptrdiff_t MaxRunLength = 127;
+
+		std::vector<uint8_t> Encoded;
+		Encoded.reserve(Data.size());
+
+		const uint8_t* pRun	   = Data.data();
+		const uint8_t* pRunEnd = pRun + 1;
+		const uint8_t* pEnd	   = Data.data() + Data.size();
+		while (pRun < pEnd)
+		{
+			while (pRunEnd < pEnd && *pRun == *pRunEnd && pRunEnd - pRun - 1 < MaxRunLength)
+			{
+				++pRunEnd;
+			}
+
+			if (pRunEnd - pRun >= MinRunLength)
+			{
+				Encoded.push_back(uint8_t(pRunEnd - pRun - 1));
+				Encoded.push_back(*pRun);
+				pRun = pRunEnd;
+			}
+			else
+			{
+				while (pRunEnd < pEnd &&
+					   ((pRunEnd + 1 >= pEnd || *pRunEnd != *(pRunEnd + 1)) ||
+						(pRunEnd + 2 >= pEnd || *(pRunEnd + 1) != *(pRunEnd + 2))) &&
+					   pRunEnd - pRun < MaxRunLength)
+				{
+					++pRunEnd;
+				}
+
+				Encoded.push_back(uint8_t(pRun - pRunEnd));
+				Encoded.insert(Encoded.end(), pRun, pRunEnd);
+				pRun = pRunEnd;
+			}
+
+			++pRunEnd;
+		}
+		return Encoded;
+	}
+
+	int						Width, Height;
+	std::vector<ExrChannel> Channels;
+	ExrWriteDesc			Desc;
+};
+
+bool WriteEXR(
+	const std::filesystem::path& Path,
+	int							 Width,
+	int							 Height,
+	std::span<const ExrChannel>	 Channels,
+	const ExrWriteDesc&			 Desc /*= {}*/)
+{
+	if (Width <= 0 || Height <= 0 || Channels.empty())
+	{
+		return false;
+	}
+
+	ExrWriter Writer(Width, Height, Channels, Desc);
+	return Writer.Write(Path);
+}
+
+bool WriteEXR(const std::filesystem::path& Path, const Texture2D<RGBSpectrum>& Image, const ExrWriteDesc& Desc /*= {}*/)
+{
+	const float*	 pData		= &Image.Pixels[0][0];
+	const ExrChannel Channels[] = { { "B", pData + 2, 3 }, { "G", pData + 1, 3 }, { "R", pData, 3 } };
+	return WriteEXR(Path, int(Image.Width), int(Image.Height), Channels, Desc);
+}
+
+std::unique_ptr<Texture2D<RGBSpectrum>> ReadImage(const std::filesystem::path& Path)
+{
+	constexpr int NumChannels = 3;
+
+	int	   Width, Height, FileChannels;
+	float* pData = stbi_loadf(Path.string().c_str(), &Width, &Height, &FileChannels, NumChannels);
+	if (!pData)
+	{
+		printf("Failed to read %s: %s\n", Path.string().c_str(), stbi_failure_reason());
+		return nullptr;
+	}
+
+	// stb returns the top row first
+	auto pImage = std::make_unique<Texture2D<RGBSpectrum>>(UINT(Width), UINT(Height));
+	for (int y = 0; y < Height; ++y)
+	{
+		memcpy(
+			&pImage->Pixels[size_t(Height - 1 - y) * Width],
+			pData + size_t(y) * Width * NumChannels,
+			sizeof(RGBSpectrum) * Width);
+	}
+	stbi_image_free(pData);
+	return pImage;
+}
+
+ImageFormat GetImageFormat(const std::filesystem::path& Path)
+{
+	std::string Extension = Path.extension().string();
+	std::ranges::transform(Extension, Extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+
+	if (Extension == ".png")
+	{
+		return ImageFormat::PNG;
+	}
+	if (Extension == ".pfm")
+	{
+		return ImageFormat::PFM;
+	}
+	if (Extension == ".exr")
+	{
+		return ImageFormat::EXR;
+	}
+	return ImageFormat::Unknown;
+}
+
+bool WriteImage(
+	const std::filesystem::path&  Path,
+	const Texture2D<RGBSpectrum>& Image,
+	const ImageWriteDesc&		  Desc /*= {}*/,
+	TaskScheduler*				  pScheduler /*= nullptr*/)
+{
+	switch (GetImageFormat(Path))
+	{
+	case ImageFormat::PNG:
+		return WritePNG(Path, Image, Desc.Tonemap, Desc.BitDepth, pScheduler);
+	case ImageFormat::PFM:
+		return WritePFM(Path, Image);
+	case ImageFormat::EXR:
+		return WriteEXR(Path, Image, Desc.Exr);
+	default:
+		printf("Unknown image format %s, expected .png, .pfm or .exr\n", Path.string().c_str());
+		return false;
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include "Spectrum.h"
+#include "Tonemap.h"
+
+template<typename T>
+struct Texture2D;
+
+class TaskScheduler;
+
+enum class ImageFormat
+{
+	Unknown,
+	PNG,
+	PFM,
+	EXR
+};
+
+enum class ExrPixelType
+{
+	Half,
+	Float
+};
+
+enum class ExrCompression
+{
+	None,
+	RLE,
+	ZIP
+};
+
+struct ExrWriteDesc
+{
+	ExrPixelType   PixelType   = ExrPixelType::Half;
+	ExrCompression Compression = ExrCompression::ZIP;
+	// Size of the tiles of a tiled file, 0 writes scanlines
+	int TileSize = 0;
+};
+
+struct ImageWriteDesc
+{
+	// Tone mapping of PNG outputs, PFM and EXR outputs keep the linear radiance
+	TonemapDesc Tonemap;
+	// Bits per channel of PNG outputs, 8 or 16
+	int			 BitDepth = 8;
+	ExrWriteDesc Exr;
+};
+
+/*
+ *	A channel of an EXR file. Value (x, y) is read from pData[(y * Width + x) * Stride] where row 0 is the
+ *	bottom row of the image, the same layout the film resolves into. Layers are expressed through the name,
+ *	"Albedo.R" is the R channel of the Albedo layer. FullPrecision channels are stored as float in half
+ *	files too, for data like depth and IDs that half can't represent
+ */
+struct ExrChannel
+{
+	std::string	 Name;
+	const float* pData;
+	size_t		 Stride;
+	bool		 FullPrecision = false;
+};
+
+/*
+ *	Writers return false if the file couldn't be written. PNG output is tone mapped and sRGB encoded,
+ *	PFM and EXR keep the linear radiance
+ */
+bool WritePNG(
+	const std::filesystem::path&  Path,
+	const Texture2D<RGBSpectrum>& Image,
+	const TonemapDesc&			  Tonemap	 = {},
+	int							  BitDepth	 = 8,
+	TaskScheduler*				  pScheduler = nullptr);
+bool WritePFM(const std::filesystem::path& Path, const Texture2D<RGBSpectrum>& Image);
+bool WriteEXR(
+	const std::filesystem::path& Path,
+	int							 Width,
+	int							 Height,
+	std::span<const ExrChannel>	 Channels,
+	const ExrWriteDesc&			 Desc = {});
+bool WriteEXR(const std::filesystem::path& Path, const Texture2D<RGBSpectrum>& Image, const ExrWriteDesc& Desc = {});
+
+/*
+ *	Reads a Radiance .hdr file, or any 8-bit format stb_image supports converted to linear values, into a
+ *	texture with the bottom row first. Returns null if the file couldn't be read
+ */
+std::unique_ptr<Texture2D<RGBSpectrum>> ReadImage(const std::filesystem::path& Path);
+
+// Format from the extension of Path (.png, .pfm or .exr)
+ImageFormat GetImageFormat(const std::filesystem::path& Path);
+
+// Picks the writer from the extension of Path, the scheduler parallelizes tone mapping
+bool WriteImage(
+	const std::filesystem::path&  Path,
+	const Texture2D<RGBSpectrum>& Image,
+	const ImageWriteDesc&		  Desc		 = {},
+	TaskScheduler*				  pScheduler = nullptr);
@@ -1,17 +1,31 @@
 #include "AOIntegrator.h"
 #include "../Scene.h"
 #include "../Sampler/Sampler.h"
+#include "ShadowRayQueue.h"
 
-Spectrum AOIntegrator::Li(RayDesc ray, const Scene& scene, Sampler& sampler)
+Spectrum AOIntegrator::Li(
+	RayDesc			ray,
+	const Scene&	scene,
+	Sampler&		sampler,
+	MemoryArena&	Arena,
+	ShadowRayQueue& ShadowRays,
+	AOVSample*		pAOV)
 {
 	Spectrum L(0);
 
-	std::optional<SurfaceInteraction> si = scene.Intersect(ray);
-	if (si)
+	// Only the hit point and geometric normal are needed, skip building the full SurfaceInteraction
+	std::optional<RayHit> hit = scene.TraceRay(ray);
+	if (hit)
 	{
+		Interaction isect = scene.GetInteraction(ray, *hit);
+		if (pAOV)
+		{
+			RecordFirstHit(ray, scene.GetSurfaceInteraction(ray, *hit), pAOV);
+		}
+
 		// Compute coordinate frame based on true geometry, not shading
 		// geometry.
-		Vector3f n = faceforward(si->GeometryFrame.n, -ray.Direction);
+		Vector3f n = faceforward(isect.n, -ray.Direction);
 		Vector3f s, t;
 		coordinatesystem(n, &s, &t);
 
@@ -40,19 +54,17 @@ Spectrum AOIntegrator::Li(RayDesc ray, const Scene& scene, Sampler& sampler)
 				s.z * wi.x + t.z * wi.y + n.z * wi.z);
 
 			RayDesc occlusionRay	   = {};
-			occlusionRay.Origin	   = si->p;
+			occlusionRay.Origin	   = isect.p;
 			occlusionRay.TMin	   = 0.0001f;
 			occlusionRay.Direction = wi;
 			occlusionRay.TMax	   = INFINITY;
 
-			if (!scene.Occluded(occlusionRay))
-			{
-				L += dot(wi, n) / pdf;
-			}
+			// Occlusion is resolved in batches, unoccluded samples are accumulated when the queue is flushed
+			ShadowRays.Push(occlusionRay, Spectrum(dot(wi, n) / pdf / float(NumSamples)));
 		}
 	}
 
-	return L /= float(NumSamples);
+	return L;
 }
 
 std::unique_ptr<AOIntegrator> CreateAOIntegrator(
@@ -0,0 +1,907 @@
+#include "BDPTIntegrator.h"
+#include "../Scene.h"
+#include "../Sampler/Sampler.h"
+#include "../MemoryArena.h"
+
+#include <new>
+#include <numeric>
+
+enum class TransportMode
+{
+	Radiance,  // Camera subpaths, carrying radiance towards the camera
+	Importance // Light subpaths, carrying importance towards the lights
+};
+
+/*
+ *	Importance of the pinhole camera and the density of the camera rays GenerateCameraRay produces for the
+ *	rendered pixels. A film position (x, y) maps to the image position ((x / (Width - 1), y / (Height - 1)),
+ *	so every pixel covers PixelArea on the image plane at unit distance. We is normalized per pixel since
+ *	the splats of a pixel are divided by the number of light paths of the whole film
+ */
+struct CameraImportance
+{
+	CameraImportance(const Camera& Camera, int Width, int Height, const RECT& PixelBounds)
+		: pCamera(&Camera)
+		, Position(Camera.Transform.Position.x, Camera.Transform.Position.y, Camera.Transform.Position.z)
+		, Width(float(Width))
+		, Height(float(Height))
+		, PixelBounds(PixelBounds)
+	{
+		Forward	  = Camera.Transform.Forward();
+		PixelArea = Camera.GetImagePlaneArea() / ((this->Width - 1.0f) * (this->Height - 1.0f));
+		FilmArea  = PixelArea * float(PixelBounds.right - PixelBounds.left) *
+				   float(PixelBounds.bottom - PixelBounds.top);
+	}
+
+	// Film position of the camera ray along the direction w, fails outside the rendered pixels
+	bool GetFilmPosition(const Vector3f& w, Vector2f* pFilmPosition) const
+	{
+		float U, V;
+		if (!pCamera->GetImagePosition(w, &U, &V))
+		{
+			return false;
+		}
+
+		*pFilmPosition = Vector2f(U * (Width - 1.0f), V * (Height - 1.0f));
+		return pFilmPosition->x >= float(PixelBounds.left) && pFilmPosition->x < float(PixelBounds.right) &&
+			   pFilmPosition->y >= float(PixelBounds.top) && pFilmPosition->y < float(PixelBounds.bottom);
+	}
+
+	// Solid angle density of a camera ray along the normalized direction w
+	float PdfDir(const Vector3f& w) const
+	{
+		Vector2f FilmPosition;
+		if (!GetFilmPosition(w, &FilmPosition))
+		{
+			return 0.0f;
+		}
+
+		float CosTheta = dot(w, Forward);
+		return 1.0f / (FilmArea * CosTheta * CosTheta * CosTheta);
+	}
+
+	// Importance emitted along the normalized direction w, which has to be inside the film
+	float We(const Vector3f& w) const
+	{
+		float CosTheta	= dot(w, Forward);
+		float CosTheta2 = CosTheta * CosTheta;
+		return 1.0f / (PixelArea * CosTheta2 * CosTheta2);
+	}
+
+	const Camera* pCamera;
+	Vector3f	  Position;
+	Vector3f	  Forward;
+	float		  Width;
+	float		  Height;
+	RECT		  PixelBounds;
+	float		  PixelArea;
+	float		  FilmArea;
+};
+
+// State shared by all vertices of the subpaths of a sample
+struct BDPTContext
+{
+	const Scene*			pScene;
+	const CameraImportance* pCamera;
+	bool					LightTracing; // Whether the strategies connecting light subpaths to the camera are used
+};
+
+enum class VertexType
+{
+	Camera,
+	Light,
+	Surface
+};
+
+/*
+ *	Vertex of a camera or light subpath. pdfFwd is the area density of sampling the vertex from its predecessor
+ *	on the subpath and pdfRev that of sampling it from its successor as if the subpath were traced the other way,
+ *	solid angle densities are kept for vertices at infinity. Camera and light vertices only have si.p and si.n,
+ *	n is 0 for points
+ */
+struct PathVertex
+{
+	static PathVertex CreateCamera(const Vector3f& p, const Spectrum& beta)
+	{
+		PathVertex Vertex;
+		Vertex.Type = VertexType::Camera;
+		Vertex.beta = beta;
+		Vertex.si.p = p;
+		return Vertex;
+	}
+
+	static PathVertex
+	CreateLight(const Light* pLight, const Vector3f& p, const Vector3f& n, const Spectrum& beta, float pdf)
+	{
+		PathVertex Vertex;
+		Vertex.Type	  = VertexType::Light;
+		Vertex.beta	  = beta;
+		Vertex.si.p	  = p;
+		Vertex.si.n	  = n;
+		Vertex.pLight = pLight;
+		Vertex.pdfFwd = pdf;
+		return Vertex;
+	}
+
+	// The lights at infinity seen along a camera ray that left the scene
+	static PathVertex CreateEscaped(const RayDesc& Ray, const Spectrum& beta, float pdf)
+	{
+		return CreateLight(nullptr, Ray.Origin + Ray.Direction, -Ray.Direction, beta, pdf);
+	}
+
+	static PathVertex
+	CreateSurface(const SurfaceInteraction& si, const Spectrum& beta, float pdf, const PathVertex& Prev)
+	{
+		PathVertex Vertex;
+		Vertex.Type	  = VertexType::Surface;
+		Vertex.beta	  = beta;
+		Vertex.si	  = si;
+		Vertex.pdfFwd = Prev.ConvertDensity(pdf, Vertex);
+		return Vertex;
+	}
+
+	const Vector3f& p() const { return si.p; }
+	const Vector3f& ng() const { return si.n; }
+	const Vector3f& ns() const { return Type == VertexType::Surface ? si.ShadingFrame.n : si.n; }
+
+	bool IsOnSurface() const { return ng().LengthSquared() > 0.0f; }
+
+	bool IsLight() const { return Type == VertexType::Light || (Type == VertexType::Surface && si.AreaLight); }
+
+	bool IsDeltaLight() const { return Type == VertexType::Light && pLight && pLight->IsDeltaLight(); }
+
+	bool IsInfiniteLight() const
+	{
+		return Type == VertexType::Light &&
+			   (!pLight || pLight->_Flags & Light::Infinite || pLight->_Flags & Light::DeltaDirection);
+	}
+
+	// Whether a vertex of the other subpath can be connected to this one, specular surfaces can't be
+	bool IsConnectible() const
+	{
+		switch (Type)
+		{
+		case VertexType::Light:
+			return pLight && !(pLight->_Flags & Light::DeltaDirection);
+		case VertexType::Surface:
+			return si.BSDF && si.BSDF.IsNonSpecular();
+		default:
+			return true;
+		}
+	}
+
+	const Light* GetLight() const { return Type == VertexType::Light ? pLight : si.AreaLight; }
+
+	// BSDF of a surface vertex for scattering towards Next
+	Spectrum f(const PathVertex& Next, TransportMode Mode) const;
+
+	// Converts the solid angle density pdf of sampling Next from this vertex to an area density at Next
+	float ConvertDensity(float pdf, const PathVertex& Next) const
+	{
+		if (Next.IsInfiniteLight())
+		{
+			return pdf;
+		}
+
+		Vector3f w		  = Next.p() - p();
+		float	 Distance2 = w.LengthSquared();
+		if (Distance2 == 0.0f)
+		{
+			return 0.0f;
+		}
+		if (Next.IsOnSurface())
+		{
+			pdf *= absdot(Next.ng(), w / std::sqrt(Distance2));
+		}
+		return pdf / Distance2;
+	}
+
+	// Area density of sampling Next from this vertex, which was reached from pPrev (null for camera vertices)
+	float Pdf(const BDPTContext& Context, const PathVertex* pPrev, const PathVertex& Next) const;
+
+	// Area density of a light subpath starting at this light vertex reaching Next
+	float PdfLight(const BDPTContext& Context, const PathVertex& Next) const;
+
+	// Area density of a light subpath starting at this light vertex, towards Next
+	float PdfLightOrigin(const BDPTContext& Context, const PathVertex& Next) const;
+
+	// Radiance emitted from this light vertex towards Next
+	Spectrum Le(const BDPTContext& Context, const PathVertex& Next) const;
+
+	VertexType		   Type = VertexType::Surface;
+	Spectrum		   beta;
+	SurfaceInteraction si;
+	const Light*	   pLight = nullptr; // Light of a light vertex, null for the lights at infinity a camera ray sees
+	bool			   Delta  = false;	 // Set for vertices sampled from a specular lobe
+	float			   pdfFwd = 0.0f;
+	float			   pdfRev = 0.0f;
+};
+
+/*
+ *	BSDFs aren't symmetric once shading normals are involved, light subpaths scatter with the adjoint BSDF
+ *	which differs by the ratio of the cosines with the shading and geometric normals (Veach's thesis, 5.3)
+ */
+static float
+CorrectShadingNormal(const SurfaceInteraction& si, const Vector3f& wo, const Vector3f& wi, TransportMode Mode)
+{
+	if (Mode == TransportMode::Radiance)
+	{
+		return 1.0f;
+	}
+
+	float Numerator	  = absdot(wo, si.ShadingFrame.n) * absdot(wi, si.n);
+	float Denominator = absdot(wo, si.n) * absdot(wi, si.ShadingFrame.n);
+	return Denominator == 0.0f ? 0.0f : Numerator / Denominator;
+}
+
+// Solid angle density of a light subpath starting at one of the lights at infinity in direction w
+static float InfiniteLightDensity(const BDPTContext& Context, const Vector3f& w)
+{
+	const Scene& Scene = *Context.pScene;
+
+	float pdf = 0.0f;
+	for (const Light* pLight : Scene.Lights)
+	{
+		if (pLight->_Flags & Light::Infinite)
+		{
+			pdf += Scene.EmissionLightSampler->PMF(Interaction(), pLight) * pLight->PdfLi(Interaction(), -w);
+		}
+	}
+	return pdf;
+}
+
+Spectrum PathVertex::f(const PathVertex& Next, TransportMode Mode) const
+{
+	Vector3f wi = Next.p() - p();
+	if (wi.LengthSquared() == 0.0f)
+	{
+		return Spectrum(0.0f);
+	}
+
+	wi = normalize(wi);
+	return si.BSDF.f(si.wo, wi) * CorrectShadingNormal(si, si.wo, wi, Mode);
+}
+
+float PathVertex::Pdf(const BDPTContext& Context, const PathVertex* pPrev, const PathVertex& Next) const
+{
+	if (Type == VertexType::Light)
+	{
+		return PdfLight(Context, Next);
+	}
+
+	Vector3f wn = Next.p() - p();
+	if (wn.LengthSquared() == 0.0f)
+	{
+		return 0.0f;
+	}
+	wn = normalize(wn);
+
+	float pdf;
+	if (Type == VertexType::Camera)
+	{
+		pdf = Context.pCamera->PdfDir(wn);
+	}
+	else
+	{
+		Vector3f wp = pPrev->p() - p();
+		if (wp.LengthSquared() == 0.0f)
+		{
+			return 0.0f;
+		}
+		pdf = si.BSDF.Pdf(normalize(wp), wn);
+	}
+	return ConvertDensity(pdf, Next);
+}
+
+float PathVertex::PdfLight(const BDPTContext& Context, const PathVertex& Next) const
+{
+	Vector3f w		   = Next.p() - p();
+	float	 Distance2 = w.LengthSquared();
+	if (Distance2 == 0.0f)
+	{
+		return 0.0f;
+	}
+	w /= std::sqrt(Distance2);
+
+	float pdf;
+	if (IsInfiniteLight())
+	{
+		// Rays from lights at infinity start on the disk of the scene's bounding sphere
+		Vector3f SceneCenter;
+		float	 SceneRadius;
+		Context.pScene->Bounds.BoundingSphere(&SceneCenter, &SceneRadius);
+		pdf = 1.0f / (g_PI * SceneRadius * SceneRadius);
+	}
+	else
+	{
+		float pdfPos, pdfDir;
+		GetLight()->PdfLe(RayDesc(p(), 0.0f, w, INFINITY), ng(), &pdfPos, &pdfDir);
+		pdf = pdfDir / Distance2;
+	}
+
+	if (Next.IsOnSurface())
+	{
+		pdf *= absdot(Next.ng(), w);
+	}
+	return pdf;
+}
+
+float PathVertex::PdfLightOrigin(const BDPTContext& Context, const PathVertex& Next) const
+{
+	Vector3f w = Next.p() - p();
+	if (w.LengthSquared() == 0.0f)
+	{
+		return 0.0f;
+	}
+	w = normalize(w);
+
+	if (IsInfiniteLight())
+	{
+		return InfiniteLightDensity(Context, w);
+	}
+
+	const Light* pVertexLight = GetLight();
+	float		 pdfPos, pdfDir;
+	pVertexLight->PdfLe(RayDesc(p(), 0.0f, w, INFINITY), ng(), &pdfPos, &pdfDir);
+	return Context.pScene->EmissionLightSampler->PMF(Interaction(), pVertexLight) * pdfPos;
+}
+
+Spectrum PathVertex::Le(const BDPTContext& Context, const PathVertex& Next) const
+{
+	if (!IsLight())
+	{
+		return Spectrum(0.0f);
+	}
+
+	Vector3f w = Next.p() - p();
+	if (w.LengthSquared() == 0.0f)
+	{
+		return Spectrum(0.0f);
+	}
+	w = normalize(w);
+
+	if (IsInfiniteLight())
+	{
+		Spectrum L(0.0f);
+		for (const Light* pInfiniteLight : Context.pScene->Lights)
+		{
+			if (pInfiniteLight->_Flags & Light::Infinite)
+			{
+				L += pInfiniteLight->Le(RayDesc(p(), 0.0f, -w, INFINITY));
+			}
+		}
+		return L;
+	}
+	return GetLight()->L(si, w);
+}
+
+// Overwrites a value for the lifetime of the object, does nothing if pTarget is null
+template<typename T>
+class ScopedAssignment
+{
+public:
+	ScopedAssignment(T* pTarget, const T& Value)
+		: pTarget(pTarget)
+	{
+		if (pTarget)
+		{
+			Backup	 = *pTarget;
+			*pTarget = Value;
+		}
+	}
+
+	~ScopedAssignment()
+	{
+		if (pTarget)
+		{
+			*pTarget = Backup;
+		}
+	}
+
+	ScopedAssignment(const ScopedAssignment&)			 = delete;
+	ScopedAssignment& operator=(const ScopedAssignment&) = delete;
+
+private:
+	T* pTarget;
+	T  Backup;
+};
+
+// Vertices are only constructed once a subpath reaches them, long paths rarely use all of them
+static PathVertex* AllocateVertices(MemoryArena& Arena, int Count)
+{
+	return static_cast<PathVertex*>(Arena.Alloc(sizeof(PathVertex) * Count, alignof(PathVertex)));
+}
+
+/*
+ *	Extends a subpath from ray, which was sampled with the solid angle density pdf, by up to MaxDepth vertices
+ *	written to pPath. pPath[-1] is the vertex the ray starts from, its pdfRev is filled in as well.
+ *	Camera rays that leave the scene end on a vertex for the lights at infinity
+ */
+static int RandomWalk(
+	const BDPTContext& Context,
+	RayDesc			   ray,
+	Sampler&		   Sampler,
+	Spectrum		   beta,
+	float			   pdf,
+	int				   MaxDepth,
+	TransportMode	   Mode,
+	PathVertex*		   pPath)
+{
+	if (MaxDepth == 0)
+	{
+		return 0;
+	}
+
+	const Scene& Scene	 = *Context.pScene;
+	int			 bounces = 0;
+	float		 pdfFwd	 = pdf;
+	float		 pdfRev	 = 0.0f;
+	while (true)
+	{
+		std::optional<RayHit> hit = Scene.TraceRay(ray);
+		if (beta.IsBlack())
+		{
+			break;
+		}
+
+		PathVertex& Vertex = pPath[bounces];
+		PathVertex& Prev   = pPath[bounces - 1];
+		if (!hit)
+		{
+			if (Mode == TransportMode::Radiance)
+			{
+				new (&Vertex) PathVertex(PathVertex::CreateEscaped(ray, beta, pdfFwd));
+				++bounces;
+			}
+			break;
+		}
+
+		// Surfaces without a BSDF only delimit media, which aren't handled, unless they are shape lights
+		SurfaceInteraction si = Scene.GetSurfaceInteraction(ray, *hit);
+		if (!si.BSDF && !si.AreaLight)
+		{
+			ray = si.SpawnRay(ray.Direction);
+			continue;
+		}
+
+		// Shape lights absorb what hits them, camera subpaths end on them to pick up their emission
+		if (!si.BSDF)
+		{
+			if (Mode == TransportMode::Radiance)
+			{
+				new (&Vertex) PathVertex(PathVertex::CreateSurface(si, beta, pdfFwd, Prev));
+				++bounces;
+			}
+			break;
+		}
+
+		new (&Vertex) PathVertex(PathVertex::CreateSurface(si, beta, pdfFwd, Prev));
+		if (++bounces >= MaxDepth)
+		{
+			break;
+		}
+
+		Vector3f				  wo		 = si.wo;
+		std::optional<BSDFSample> bsdfSample = si.BSDF.Samplef(wo, Sampler.Get2D());
+		if (!bsdfSample || bsdfSample->f.IsBlack() || bsdfSample->pdf == 0.0f)
+		{
+			break;
+		}
+
+		pdfFwd = bsdfSample->pdf;
+		beta *= bsdfSample->f * absdot(bsdfSample->wi, si.ShadingFrame.n) / pdfFwd;
+		beta *= CorrectShadingNormal(si, wo, bsdfSample->wi, Mode);
+		pdfRev = si.BSDF.Pdf(bsdfSample->wi, wo);
+		if (IsSpecular(bsdfSample->flags))
+		{
+			Vertex.Delta = true;
+			pdfFwd = pdfRev = 0.0f;
+		}
+
+		ray = si.SpawnRay(bsdfSample->wi);
+
+		Prev.pdfRev = Vertex.ConvertDensity(pdfRev, Prev);
+	}
+	return bounces;
+}
+
+static int GenerateCameraSubpath(
+	const BDPTContext& Context,
+	const RayDesc&	   ray,
+	Sampler&		   Sampler,
+	int				   MaxDepth,
+	PathVertex*		   pPath)
+{
+	if (MaxDepth == 0)
+	{
+		return 0;
+	}
+
+	Spectrum beta(1.0f);
+	new (pPath) PathVertex(PathVertex::CreateCamera(ray.Origin, beta));
+	float pdfDir = Context.pCamera->PdfDir(ray.Direction);
+	return RandomWalk(Context, ray, Sampler, beta, pdfDir, MaxDepth - 1, TransportMode::Radiance, pPath + 1) + 1;
+}
+
+static int GenerateLightSubpath(const BDPTContext& Context, Sampler& Sampler, int MaxDepth, PathVertex* pPath)
+{
+	if (MaxDepth == 0)
+	{
+		return 0;
+	}
+
+	float		 LightPmf;
+	const Light* pLight = Context.pScene->EmissionLightSampler->Sample(Interaction(), Sampler.Get1D(), &LightPmf);
+	if (!pLight)
+	{
+		return 0;
+	}
+
+	Vector2f Xi0 = Sampler.Get2D();
+	Vector2f Xi1 = Sampler.Get2D();
+	RayDesc	 ray;
+	Vector3f nLight;
+	float	 pdfPos, pdfDir;
+	Spectrum Le = pLight->SampleLe(Xi0, Xi1, &ray, &nLight, &pdfPos, &pdfDir);
+	if (pdfPos == 0.0f || pdfDir == 0.0f || Le.IsBlack())
+	{
+		return 0;
+	}
+
+	new (pPath) PathVertex(PathVertex::CreateLight(pLight, ray.Origin, nLight, Le, pdfPos * LightPmf));
+	Spectrum beta = Le * absdot(nLight, ray.Direction) / (LightPmf * pdfPos * pdfDir);
+	int NumVertices =
+		RandomWalk(Context, ray, Sampler, beta, pdfDir, MaxDepth - 1, TransportMode::Importance, pPath + 1);
+
+	// Rays of lights at infinity are sampled by direction first, the origin follows with an area density that
+	// already accounts for the first vertex. The light vertex itself gets the density of the direction
+	if (pPath[0].IsInfiniteLight())
+	{
+		if (NumVertices > 0)
+		{
+			pPath[1].pdfFwd = pdfPos;
+			if (pPath[1].IsOnSurface())
+			{
+				pPath[1].pdfFwd *= absdot(ray.Direction, pPath[1].ng());
+			}
+		}
+		pPath[0].pdfFwd = InfiniteLightDensity(Context, ray.Direction);
+	}
+	return NumVertices + 1;
+}
+
+// Geometry term between two vertices, 0 if they can't see each other
+static float G(const BDPTContext& Context, const PathVertex& v0, const PathVertex& v1)
+{
+	Vector3f d = v0.p() - v1.p();
+	float	 g = 1.0f / d.LengthSquared();
+	d *= std::sqrt(g);
+	if (v0.IsOnSurface())
+	{
+		g *= absdot(v0.ns(), d);
+	}
+	if (v1.IsOnSurface())
+	{
+		g *= absdot(v1.ns(), d);
+	}
+
+	VisibilityTester VisibilityTester = { v0.si, v1.si };
+	return VisibilityTester.Unoccluded(*Context.pScene) ? g : 0.0f;
+}
+
+/*
+ *	Balance heuristic weight of the path made of the first s light and t camera vertices, Sampled replaces the
+ *	endpoint that was sampled during the connection (s or t is 1). The densities of every other strategy that
+ *	can produce the path are found by walking from the connection towards both ends with the pdfRev values,
+ *	which are temporarily updated around the connection. Vertices on specular lobes can't be connected to
+ *	so the strategies connecting there are skipped
+ */
+static float MISWeight(
+	const BDPTContext& Context,
+	PathVertex*		   LightVertices,
+	PathVertex*		   CameraVertices,
+	const PathVertex&  Sampled,
+	int				   s,
+	int				   t)
+{
+	if (s + t == 2)
+	{
+		return 1.0f;
+	}
+
+	// Delta densities are stored as 0 and cancel out of the ratios
+	auto Remap0 = [](float f) { return f != 0.0f ? f : 1.0f; };
+
+	PathVertex* qs		= s > 0 ? &LightVertices[s - 1] : nullptr;
+	PathVertex* pt		= t > 0 ? &CameraVertices[t - 1] : nullptr;
+	PathVertex* qsMinus = s > 1 ? &LightVertices[s - 2] : nullptr;
+	PathVertex* ptMinus = t > 1 ? &CameraVertices[t - 2] : nullptr;
+
+	ScopedAssignment<PathVertex> SampledEndpoint(s == 1 ? qs : (t == 1 ? pt : nullptr), Sampled);
+	ScopedAssignment<bool>		 ptDelta(&pt->Delta, false);
+	ScopedAssignment<bool>		 qsDelta(qs ? &qs->Delta : nullptr, false);
+
+	ScopedAssignment<float> ptPdfRev(
+		&pt->pdfRev, s > 0 ? qs->Pdf(Context, qsMinus, *pt) : pt->PdfLightOrigin(Context, *ptMinus));
+	ScopedAssignment<float> ptMinusPdfRev(
+		ptMinus ? &ptMinus->pdfRev : nullptr,
+		!ptMinus ? 0.0f : (s > 0 ? pt->Pdf(Context, qs, *ptMinus) : pt->PdfLight(Context, *ptMinus)));
+	ScopedAssignment<float> qsPdfRev(qs ? &qs->pdfRev : nullptr, qs ? pt->Pdf(Context, ptMinus, *qs) : 0.0f);
+	ScopedAssignment<float> qsMinusPdfRev(
+		qsMinus ? &qsMinus->pdfRev : nullptr, qsMinus ? qs->Pdf(Context, pt, *qsMinus) : 0.0f);
+
+	// Camera subpaths with one vertex less are light tracing, which is only a strategy if it is splatted
+	float SumRi = 0.0f;
+	float ri	= 1.0f;
+	for (int i = t - 1; i > 0; --i)
+	{
+		ri *= Remap0(CameraVertices[i].pdfRev) / Remap0(CameraVertices[i].pdfFwd);
+		if (!CameraVertices[i].Delta && !CameraVertices[i - 1].Delta && (i > 1 || Context.LightTracing))
+		{
+			SumRi += ri;
+		}
+	}
+
+	ri = 1.0f;
+	for (int i = s - 1; i >= 0; --i)
+	{
+		ri *= Remap0(LightVertices[i].pdfRev) / Remap0(LightVertices[i].pdfFwd);
+		bool DeltaLightVertex = i > 0 ? LightVertices[i - 1].Delta : LightVertices[0].IsDeltaLight();
+		if (!LightVertices[i].Delta && !DeltaLightVertex)
+		{
+			SumRi += ri;
+		}
+	}
+	return 1.0f / (1.0f + SumRi);
+}
+
+/*
+ *	Contribution of the path made of the first s light and t camera vertices, weighted with MISWeight.
+ *	Connections to the camera (t == 1) set pFilmPosition to where the path lands on the film
+ */
+static Spectrum ConnectBDPT(
+	const BDPTContext& Context,
+	PathVertex*		   LightVertices,
+	PathVertex*		   CameraVertices,
+	int				   s,
+	int				   t,
+	Sampler&		   Sampler,
+	Vector2f*		   pFilmPosition)
+{
+	const Scene&			Scene  = *Context.pScene;
+	const CameraImportance& Camera = *Context.pCamera;
+
+	// Camera subpaths that escaped to the lights at infinity can't be connected
+	if (t > 1 && s != 0 && CameraVertices[t - 1].Type == VertexType::Light)
+	{
+		return Spectrum(0.0f);
+	}
+
+	Spectrum   L(0.0f);
+	PathVertex Sampled;
+	if (s == 0)
+	{
+		// The camera subpath is the whole path if it ended on a light
+		const PathVertex& pt = CameraVertices[t - 1];
+		if (pt.IsLight())
+		{
+			L = pt.Le(Context, CameraVertices[t - 2]) * pt.beta;
+		}
+	}
+	else if (t == 1)
+	{
+		// Light tracing, connect the light subpath to the camera
+		const PathVertex& qs = LightVertices[s - 1];
+		if (qs.IsConnectible())
+		{
+			// w is the direction of the camera ray that sees qs
+			Vector3f w		   = qs.p() - Camera.Position;
+			float	 Distance2 = w.LengthSquared();
+			w /= std::sqrt(Distance2);
+			if (Distance2 > 0.0f && Camera.GetFilmPosition(w, pFilmPosition))
+			{
+				// Importance arriving at qs from the pinhole, the density of the pinhole is a delta
+				float CosTheta = dot(w, Camera.Forward);
+				Sampled = PathVertex::CreateCamera(Camera.Position, Spectrum(Camera.We(w) * CosTheta / Distance2));
+				L		= qs.beta * qs.f(Sampled, TransportMode::Importance) * Sampled.beta;
+				if (qs.IsOnSurface())
+				{
+					L *= absdot(w, qs.ns());
+				}
+
+				VisibilityTester VisibilityTester = { qs.si, Sampled.si };
+				if (!L.IsBlack() && !VisibilityTester.Unoccluded(Scene))
+				{
+					L = Spectrum(0.0f);
+				}
+			}
+		}
+	}
+	else if (s == 1)
+	{
+		// Sample a point on a light for the camera subpath like direct lighting does
+		const PathVertex& pt = CameraVertices[t - 1];
+		if (pt.IsConnectible())
+		{
+			float		 LightPmf;
+			const Light* pLight = Scene.EmissionLightSampler->Sample(pt.si, Sampler.Get1D(), &LightPmf);
+			if (pLight)
+			{
+				VisibilityTester VisibilityTester;
+				Vector3f		 wi;
+				float			 pdf;
+				Spectrum		 Li = pLight->SampleLi(pt.si, Sampler.Get2D(), &wi, &pdf, &VisibilityTester);
+				if (pdf > 0.0f && !Li.IsBlack())
+				{
+					Sampled = PathVertex::CreateLight(
+						pLight, VisibilityTester.I1.p, VisibilityTester.I1.n, Li / (pdf * LightPmf), 0.0f);
+					Sampled.pdfFwd = Sampled.PdfLightOrigin(Context, pt);
+
+					L = pt.beta * pt.f(Sampled, TransportMode::Radiance) * Sampled.beta;
+					if (pt.IsOnSurface())
+					{
+						L *= absdot(wi, pt.ns());
+					}
+					if (!L.IsBlack() && !VisibilityTester.Unoccluded(Scene))
+					{
+						L = Spectrum(0.0f);
+					}
+				}
+			}
+		}
+	}
+	else
+	{
+		// Connect the interior vertices of both subpaths
+		const PathVertex& qs = LightVertices[s - 1];
+		const PathVertex& pt = CameraVertices[t - 1];
+		if (qs.IsConnectible() && pt.IsConnectible())
+		{
+			L = qs.beta * qs.f(pt, TransportMode::Importance) * pt.f(qs, TransportMode::Radiance) * pt.beta;
+			if (!L.IsBlack())
+			{
+				L *= G(Context, qs, pt);
+			}
+		}
+	}
+
+	if (L.IsBlack())
+	{
+		return L;
+	}
+	return L * MISWeight(Context, LightVertices, CameraVertices, Sampled, s, t);
+}
+
+Spectrum BDPTIntegrator::Li(
+	RayDesc			ray,
+	const Scene&	scene,
+	Sampler&		sampler,
+	MemoryArena&	Arena,
+	ShadowRayQueue& ShadowRays,
+	AOVSample*		pAOV)
+{
+	return Sample(ray, scene, sampler, Arena, nullptr, pAOV);
+}
+
+void BDPTIntegrator::RenderTile(
+	const Scene&	Scene,
+	const Sampler&	Sampler,
+	const FilmTile& Tile,
+	int				SampleBegin,
+	int				SampleEnd,
+	Film&			Film,
+	FilmTileBuffer& TileBuffer)
+{
+	auto	  Rect		= Tile.Rect;
+	const int TileWidth = Rect.right - Rect.left;
+	const int NumPixels = TileWidth * (Rect.bottom - Rect.top);
+
+	auto pSampler = Sampler.Clone();
+
+	// Per-thread arena, the subpaths of a sample are allocated from it
+	thread_local MemoryArena Arena;
+
+	// Splats only reach the film of this process
+	::Film* pSplatFilm = TracesLightPaths() ? &Film : nullptr;
+
+	const bool RecordAOVs = Film.GetAOVs().NeedsSamples();
+
+	// Pixels (indices local to the tile) that still take samples
+	std::vector<int> ActivePixels(NumPixels);
+	std::iota(ActivePixels.begin(), ActivePixels.end(), 0);
+	RetireConvergedPixels(Film, Tile, SampleBegin, ActivePixels);
+
+	for (int SampleIndex = SampleBegin; SampleIndex < SampleEnd && !ActivePixels.empty() && !DeadlinePassed();
+		 ++SampleIndex)
+	{
+		for (int Pixel : ActivePixels)
+		{
+			const int x = Rect.left + Pixel % TileWidth;
+			const int y = Rect.top + Pixel / TileWidth;
+
+			AOVSample AOV;
+			pSampler->StartPixelSample(x, y, SampleIndex);
+
+			Vector2f sampleJitter = pSampler->Get2D();
+			Vector2f FilmPosition = Vector2f(float(x) + sampleJitter.x, float(y) + sampleJitter.y);
+
+			RayDesc	 ray = GenerateCameraRay(Scene, x, y, sampleJitter);
+			Spectrum L	 = Sample(ray, Scene, *pSampler, Arena, pSplatFilm, RecordAOVs ? &AOV : nullptr);
+			Arena.Reset();
+
+			Film.AddSampleStatistics(x, y, L);
+			if (RecordAOVs)
+			{
+				Film.AddAOVSample(x, y, AOV, L);
+			}
+			TileBuffer.AddSample(FilmPosition, L);
+		}
+
+		// Every camera sample traced one light path
+		if (pSplatFilm)
+		{
+			Film.AddLightPaths(ActivePixels.size());
+		}
+
+		RetireConvergedPixels(Film, Tile, SampleIndex + 1, ActivePixels);
+	}
+}
+
+Spectrum BDPTIntegrator::Sample(
+	const RayDesc& ray,
+	const Scene&   Scene,
+	Sampler&	   Sampler,
+	MemoryArena&   Arena,
+	Film*		   pSplatFilm,
+	AOVSample*	   pAOV) const
+{
+	const CameraImportance Camera(Scene.Camera, Width, Height, PixelBounds);
+	const BDPTContext	   Context = { &Scene, &Camera, pSplatFilm != nullptr };
+
+	// The camera subpath takes two extra vertices, the camera and an emitter it hits
+	PathVertex* CameraVertices	  = AllocateVertices(Arena, MaxDepth + 2);
+	PathVertex* LightVertices	  = AllocateVertices(Arena, MaxDepth + 1);
+	int			NumCameraVertices = GenerateCameraSubpath(Context, ray, Sampler, MaxDepth + 2, CameraVertices);
+	int			NumLightVertices  = GenerateLightSubpath(Context, Sampler, MaxDepth + 1, LightVertices);
+
+	if (NumCameraVertices > 1 && CameraVertices[1].Type == VertexType::Surface)
+	{
+		RecordFirstHit(ray, CameraVertices[1].si, pAOV);
+	}
+
+	Spectrum L(0.0f);
+	for (int t = 1; t <= NumCameraVertices; ++t)
+	{
+		for (int s = 0; s <= NumLightVertices; ++s)
+		{
+			int Depth = t + s - 2;
+			if ((s == 1 && t == 1) || Depth < 0 || Depth > MaxDepth || (t == 1 && !pSplatFilm))
+			{
+				continue;
+			}
+
+			Vector2f FilmPosition;
+			Spectrum Lpath = ConnectBDPT(Context, LightVertices, CameraVertices, s, t, Sampler, &FilmPosition);
+			if (t == 1)
+			{
+				if (!Lpath.IsBlack())
+				{
+					pSplatFilm->AddSplat(FilmPosition, Lpath);
+				}
+				continue;
+			}
+
+			L += Lpath;
+			if (Depth <= 1 && pAOV)
+			{
+				pAOV->Direct += Lpath;
+			}
+		}
+	}
+	return L;
+}
+
+std::unique_ptr<BDPTIntegrator> CreateBDPTIntegrator(int MaxDepth)
+{
+	return std::make_unique<BDPTIntegrator>(MaxDepth);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "Integrator.h"
+
+/*
+ *	Bidirectional path tracer (Veach's thesis, structured like pbrt-v3). Every camera sample traces a camera
+ *	subpath and a light subpath from a light picked by power, then connects every prefix of one to every prefix
+ *	of the other. The strategies are combined with the balance heuristic over all the ways the same path could
+ *	have been sampled, so caustics seen through glass or light escaping a lamp housing are found from the light
+ *	side instead of waiting for camera paths to hit the light by chance.
+ *	Connecting light subpaths straight to the camera (light tracing) reaches any pixel, these contributions are
+ *	splatted into the film. Splats stay in the process that traced them, so light tracing is left out of the
+ *	strategies when rendering tiles for a coordinator, just like in Li which has no film to splat into. Splats
+ *	don't enter the pixel statistics, so adaptive sampling is turned off while light tracing.
+ *	Subpaths are not terminated with Russian roulette and every pair of prefixes is connected, so the cost of a
+ *	sample grows quadratically with MaxDepth. Participating media are not handled, medium boundaries are passed
+ *	through
+ */
+class BDPTIntegrator : public Integrator
+{
+public:
+	BDPTIntegrator(int MaxDepth)
+		: MaxDepth(MaxDepth)
+	{
+	}
+
+	// Every strategy but light tracing, ShadowRays is not used since connections are tested right away
+	Spectrum Li(
+		RayDesc			ray,
+		const Scene&	scene,
+		Sampler&		sampler,
+		MemoryArena&	Arena,
+		ShadowRayQueue& ShadowRays,
+		AOVSample*		pAOV) override;
+
+protected:
+	void RenderTile(
+		const Scene&	Scene,
+		const Sampler&	Sampler,
+		const FilmTile& Tile,
+		int				SampleBegin,
+		int				SampleEnd,
+		Film&			Film,
+		FilmTileBuffer& TileBuffer) override;
+
+	// Light tracing splats only when rendering locally
+	bool TracesLightPaths() const override { return Options.Mode == RenderMode::Local; }
+
+private:
+	/*
+	 *	Radiance of the camera ray estimated with all connection strategies, the light tracing ones are
+	 *	splatted into pSplatFilm and skipped if it is null. The caller counts the light path towards the film
+	 */
+	Spectrum Sample(
+		const RayDesc& ray,
+		const Scene&   Scene,
+		Sampler&	   Sampler,
+		MemoryArena&   Arena,
+		Film*		   pSplatFilm,
+		AOVSample*	   pAOV) const;
+
+	int MaxDepth;
+};
+
+std::unique_ptr<BDPTIntegrator> CreateBDPTIntegrator(int MaxDepth);
@@ -1,19 +1,32 @@
 #include "Integrator.h"
 #include "../Texture2D.h"
+#include "../Film.h"
 #include "../Scene.h"
 #include "../Sampler/Sampler.h"
+#include "../MemoryArena.h"
+#include "ShadowRayQueue.h"
+#include "../TaskScheduler.h"
+#include "../Socket.h"
+#include "RenderCoordinator.h"
+#include "RenderProtocol.h"
 
+#include <algorithm>
 #include <iostream>
+#include <numeric>
+#include <limits>
 #include <mutex>
 #include <thread>
 #include <future>
+#include <chrono>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <cstring>
 
-#include <ppl.h>
-using namespace concurrency;
-
-#define STBI_MSC_SECURE_CRT
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <stb/stb_image_write.h>
+#ifndef _WIN32
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
 
 #define MULTI_THREADED 1
 
@@ -21,60 +34,162 @@ using namespace concurrency;
 #define DEBUG_Y		   100
 static bool DEBUG_PIXEL = false;
 
-template<typename T, typename U, typename V>
-inline T Clamp(T val, U low, V high)
+// Interleaved values of an AOV for every pixel of the film, laid out like the resolved image
+struct AOVLayer
 {
-	if (val < low)
-		return low;
-	if (val > high)
-		return high;
-	return val;
-}
+	std::string				 Name;
+	std::vector<std::string> ChannelNames;
+	bool					 FullPrecision;
+	std::vector<float>		 Values;
+};
 
-inline float GammaCorrect(float value)
+static std::vector<AOVLayer> ResolveAOVLayers(const Film& Film)
 {
-	if (value <= 0.0031308f)
+	const AOVDesc& AOVs		 = Film.GetAOVs();
+	const RECT&	   Bounds	 = Film.GetPixelBounds();
+	const size_t   NumPixels = size_t(Film.GetWidth()) * size_t(Film.GetHeight());
+
+	std::vector<AOVLayer> Layers;
+	auto				  AddLayer = [&](bool Enabled,
+							 const char* Name,
+							 std::vector<std::string> ChannelNames,
+							 bool FullPrecision,
+							 auto GetValues)
 	{
-		return 12.92f * value;
-	}
-	return 1.055f * std::pow(value, (1.f / 2.4f)) - 0.055f;
+		if (!Enabled)
+		{
+			return;
+		}
+
+		AOVLayer Layer = { Name, std::move(ChannelNames), FullPrecision };
+		Layer.Values.reserve(NumPixels * Layer.ChannelNames.size());
+		for (int y = Bounds.top; y < Bounds.bottom; ++y)
+		{
+			for (int x = Bounds.left; x < Bounds.right; ++x)
+			{
+				GetValues(x, y, Layer.Values);
+			}
+		}
+		Layers.push_back(std::move(Layer));
+	};
+
+	auto PushSpectrum = [](std::vector<float>& Values, const Spectrum& Value)
+	{
+		Values.insert(Values.end(), { Value[0], Value[1], Value[2] });
+	};
+	// Rays that hit nothing have no ID
+	auto PushID = [](std::vector<float>& Values, unsigned int ID)
+	{
+		Values.push_back(ID == ~0u ? -1.0f : float(ID));
+	};
+
+	AddLayer(AOVs.Albedo, "Albedo", { "R", "G", "B" }, false,
+			 [&](int x, int y, std::vector<float>& Values) { PushSpectrum(Values, Film.GetAlbedo(x, y)); });
+	AddLayer(AOVs.Normal, "Normal", { "X", "Y", "Z" }, false,
+			 [&](int x, int y, std::vector<float>& Values)
+			 {
+				 Vector3f n = Film.GetNormal(x, y);
+				 Values.insert(Values.end(), { n.x, n.y, n.z });
+			 });
+	AddLayer(AOVs.Depth, "Depth", { "Z" }, true,
+			 [&](int x, int y, std::vector<float>& Values) { Values.push_back(Film.GetDepth(x, y)); });
+	AddLayer(AOVs.InstanceID, "InstanceID", { "ID" }, true,
+			 [&](int x, int y, std::vector<float>& Values) { PushID(Values, Film.GetInstanceID(x, y)); });
+	AddLayer(AOVs.GeometryID, "GeometryID", { "ID" }, true,
+			 [&](int x, int y, std::vector<float>& Values) { PushID(Values, Film.GetGeometryID(x, y)); });
+	AddLayer(AOVs.Direct, "Direct", { "R", "G", "B" }, false,
+			 [&](int x, int y, std::vector<float>& Values) { PushSpectrum(Values, Film.GetDirect(x, y)); });
+	AddLayer(AOVs.Indirect, "Indirect", { "R", "G", "B" }, false,
+			 [&](int x, int y, std::vector<float>& Values) { PushSpectrum(Values, Film.GetIndirect(x, y)); });
+	AddLayer(AOVs.SampleCount, "SampleCount", { "Y" }, true,
+			 [&](int x, int y, std::vector<float>& Values) { Values.push_back(float(Film.GetNumSamples(x, y))); });
+	AddLayer(AOVs.Variance, "Variance", { "Y" }, true,
+			 [&](int x, int y, std::vector<float>& Values) { Values.push_back(Film.GetVariance(x, y)); });
+	return Layers;
 }
 
-int Save(const Texture2D<RGBSpectrum>& Image)
+int Save(const Film& Film, const RenderOptions& Options, TaskScheduler* pScheduler)
 {
-	constexpr int NumChannels = 3;
+#ifdef _DEBUG
+	const char* DefaultName = "Debug.png";
+#else
+	const char* DefaultName = "Release.png";
+#endif
+	const std::filesystem::path Path = Options.OutputPath.empty() ? DefaultName : Options.OutputPath;
 
-	// Saves a input image as a png using stb
-	std::unique_ptr<BYTE[]> Pixels = std::make_unique<BYTE[]>(Image.Width * Image.Height * NumChannels);
+	Texture2D<RGBSpectrum> Image(Film.GetWidth(), Film.GetHeight());
+	Film.Resolve(Image);
 
-	BYTE* pDst = Pixels.get();
+	// The raw beauty is always kept, the denoised image goes next to it
+	std::optional<Texture2D<RGBSpectrum>> Denoised;
+	if (Options.Denoise)
+	{
+		Denoised.emplace(Film.GetWidth(), Film.GetHeight());
+		*Denoised = Image;
 
-	int index = 0;
-	for (int y = int(Image.Height) - 1; y >= 0; --y)
+		Denoiser Denoiser(Options.DenoiserOptions);
+		if (!Denoiser.Denoise(Film, *Denoised, pScheduler))
+		{
+			printf("Failed to denoise the image, only the raw image is written\n");
+			Denoised.reset();
+		}
+	}
+
+	bool Written = false;
+	if ((Film.GetAOVs().Any() || Denoised) && GetImageFormat(Path) == ImageFormat::EXR)
 	{
-		for (int x = 0; x < int(Image.Width); ++x)
+		// Beauty as the default layer, the denoised beauty and every AOV as a layer of its own
+		const float*			ImageData = &Image.Pixels[0][0];
+		std::vector<ExrChannel> Channels  = { { "R", ImageData, 3 }, { "G", ImageData + 1, 3 }, { "B", ImageData + 2, 3 } };
+		if (Denoised)
 		{
-			auto color = Image.GetPixel(x, y);
+			const float* DenoisedData = &Denoised->Pixels[0][0];
+			Channels.insert(
+				Channels.end(),
+				{ { "Denoised.R", DenoisedData, 3 },
+				  { "Denoised.G", DenoisedData + 1, 3 },
+				  { "Denoised.B", DenoisedData + 2, 3 } });
+		}
 
-#define TO_BYTE(v) (uint8_t) Clamp(255.f * GammaCorrect(v) + 0.5f, 0.f, 255.f)
-			pDst[0] = TO_BYTE(color[0]);
-			pDst[1] = TO_BYTE(color[1]);
-			pDst[2] = TO_BYTE(color[2]);
-#undef TO_BYTE
-			pDst += 3;
+		std::vector<AOVLayer> Layers = ResolveAOVLayers(Film);
+		for (const auto& Layer : Layers)
+		{
+			const size_t NumChannels = Layer.ChannelNames.size();
+			for (size_t i = 0; i < NumChannels; ++i)
+			{
+				Channels.push_back(
+					{ Layer.Name + "." + Layer.ChannelNames[i], Layer.Values.data() + i, NumChannels, Layer.FullPrecision });
+			}
 		}
+		Written = WriteEXR(Path, Film.GetWidth(), Film.GetHeight(), Channels, Options.Output.Exr);
 	}
+	else
+	{
+		if (Film.GetAOVs().Any())
+		{
+			printf("AOVs are only written to .exr outputs\n");
+		}
+		Written = WriteImage(Path, Image, Options.Output, pScheduler);
 
-#ifdef _DEBUG
-	const char* Name = "Debug.png";
-#else
-	const char* Name = "Release.png";
-#endif
-	if (stbi_write_png(Name, Image.Width, Image.Height, 3, Pixels.get(), Image.Width * NumChannels))
+		// Formats without layers get the denoised image as a file of its own, Render.png next to Render_denoised.png
+		if (Denoised)
+		{
+			std::filesystem::path DenoisedPath = Path;
+			DenoisedPath.replace_filename(Path.stem().string() + "_denoised" + Path.extension().string());
+			if (!WriteImage(DenoisedPath, *Denoised, Options.Output, pScheduler))
+			{
+				printf("Failed to write %s\n", DenoisedPath.string().c_str());
+				Written = false;
+			}
+		}
+	}
+
+	if (Written)
 	{
 		return EXIT_SUCCESS;
 	}
 
+	printf("Failed to write %s\n", Path.string().c_str());
 	return EXIT_FAILURE;
 }
 
@@ -101,6 +216,7 @@ public:
 
 	static int TerminalWidth()
 	{
+#ifdef _WIN32
 		HANDLE h = GetStdHandle(STD_OUTPUT_HANDLE);
 		if (h == INVALID_HANDLE_VALUE || !h)
 		{
@@ -110,6 +226,15 @@ public:
 		CONSOLE_SCREEN_BUFFER_INFO bufferInfo = { 0 };
 		GetConsoleScreenBufferInfo(h, &bufferInfo);
 		return bufferInfo.dwSize.X;
+#else
+		// Output redirected to a file has no window size
+		winsize Size = {};
+		if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &Size) != 0 || Size.ws_col == 0)
+		{
+			return 80;
+		}
+		return Size.ws_col;
+#endif
 	}
 
 	void Update(int NewProgress = 1) { CurrentProgress += NewProgress; }
@@ -177,142 +302,881 @@ private:
 	std::thread		  Thread;
 };
 
-void Integrator::Initialize(Scene& Scene)
+static unsigned int MortonIndex(unsigned int x, unsigned int y)
 {
-	TileManager.Initialize(Width, Height);
+	auto SpreadBits = [](unsigned int v)
+	{
+		v &= 0x0000ffff;
+		v = (v | (v << 8)) & 0x00ff00ff;
+		v = (v | (v << 4)) & 0x0f0f0f0f;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+		return v;
+	};
+	return SpreadBits(x) | (SpreadBits(y) << 1);
+}
+
+// n is the power of two edge length of the curve's grid
+static unsigned int HilbertIndex(unsigned int n, unsigned int x, unsigned int y)
+{
+	unsigned int d = 0;
+	for (unsigned int s = n / 2; s > 0; s /= 2)
+	{
+		unsigned int rx = (x & s) > 0;
+		unsigned int ry = (y & s) > 0;
+		d += s * s * ((3 * rx) ^ ry);
+
+		// Rotate the quadrant so the sub curve starts at its origin
+		if (ry == 0)
+		{
+			if (rx == 1)
+			{
+				x = n - 1 - x;
+				y = n - 1 - y;
+			}
+			std::swap(x, y);
+		}
+	}
+	return d;
+}
+
+void TileManager::Initialize(const RECT& Bounds, int TileSize, TileOrder Order)
+{
+	FilmTiles.clear();
+
+	const int Width		= Bounds.right - Bounds.left;
+	const int Height	= Bounds.bottom - Bounds.top;
+	const int NumTilesX = (Width + TileSize - 1) / TileSize;
+	const int NumTilesY = (Height + TileSize - 1) / TileSize;
+
+	struct SortEntry
+	{
+		float	 Key0, Key1;
+		FilmTile Tile;
+	};
+	std::vector<SortEntry> Entries;
+	Entries.reserve(size_t(NumTilesX) * NumTilesY);
+
+	unsigned int CurveSize = 1;
+	while (int(CurveSize) < std::max(NumTilesX, NumTilesY))
+	{
+		CurveSize *= 2;
+	}
+
+	const float CenterX = 0.5f * float(NumTilesX - 1);
+	const float CenterY = 0.5f * float(NumTilesY - 1);
+
+	for (int ty = 0; ty < NumTilesY; ++ty)
+	{
+		for (int tx = 0; tx < NumTilesX; ++tx)
+		{
+			int minX = Bounds.left + tx * TileSize, minY = Bounds.top + ty * TileSize;
+			int maxX = std::min(minX + TileSize, int(Bounds.right)), maxY = std::min(minY + TileSize, int(Bounds.bottom));
+
+			SortEntry Entry = {};
+			Entry.Tile.Rect = { minX, minY, maxX, maxY };
+
+			switch (Order)
+			{
+			case TileOrder::Scanline:
+				Entry.Key0 = float(ty * NumTilesX + tx);
+				break;
+			case TileOrder::Morton:
+				Entry.Key0 = float(MortonIndex(tx, ty));
+				break;
+			case TileOrder::Hilbert:
+				Entry.Key0 = float(HilbertIndex(CurveSize, tx, ty));
+				break;
+			case TileOrder::Spiral:
+			{
+				// Square rings around the center, sorted by angle within a ring
+				float dx   = float(tx) - CenterX;
+				float dy   = float(ty) - CenterY;
+				Entry.Key0 = std::round(std::max(std::abs(dx), std::abs(dy)));
+				Entry.Key1 = std::atan2(dy, dx);
+			}
+			break;
+			}
+
+			Entries.emplace_back(std::move(Entry));
+		}
+	}
+
+	std::stable_sort(
+		Entries.begin(),
+		Entries.end(),
+		[](const SortEntry& a, const SortEntry& b)
+		{
+			return a.Key0 != b.Key0 ? a.Key0 < b.Key0 : a.Key1 < b.Key1;
+		});
+
+	FilmTiles.reserve(Entries.size());
+	for (const auto& Entry : Entries)
+	{
+		FilmTiles.push_back(Entry.Tile);
+	}
+}
+
+int TileManager::ComputeTileSize(int Width, int Height, unsigned int NumThreads)
+{
+	// Enough tiles per thread that a few expensive tiles at the end do not leave the other threads idle
+	constexpr int TilesPerThread = 16;
+
+	int TileSize = FilmTile::MaxTileSize;
+	while (TileSize > FilmTile::MinTileSize)
+	{
+		int NumTiles = ((Width + TileSize - 1) / TileSize) * ((Height + TileSize - 1) / TileSize);
+		if (NumTiles >= int(NumThreads) * TilesPerThread)
+		{
+			break;
+		}
+		TileSize /= 2;
+	}
+	return TileSize;
+}
+
+void Integrator::Initialize(Scene& Scene, const RenderOptions& Options /*= {}*/)
+{
+	this->Options = Options;
+	if (Options.Denoise)
+	{
+		this->Options.AOVs.Albedo = true;
+		this->Options.AOVs.Normal = true;
+	}
+	if (Options.AdaptiveSampling && TracesLightPaths())
+	{
+		printf("Adaptive sampling doesn't see light tracing splats, every pixel takes the sampler's sample count\n");
+		this->Options.AdaptiveSampling = false;
+	}
+
+	Width  = std::max(1, Options.Width);
+	Height = std::max(1, Options.Height);
+
+	// Same rounding as pbrt so that adjacent crop windows cover every pixel exactly once
+	PixelBounds = { LONG(std::ceil(float(Width) * std::clamp(Options.CropWindow[0], 0.0f, 1.0f))),
+					LONG(std::ceil(float(Height) * std::clamp(Options.CropWindow[1], 0.0f, 1.0f))),
+					LONG(std::ceil(float(Width) * std::clamp(Options.CropWindow[2], 0.0f, 1.0f))),
+					LONG(std::ceil(float(Height) * std::clamp(Options.CropWindow[3], 0.0f, 1.0f))) };
+	if (Options.PixelRegion.right > Options.PixelRegion.left && Options.PixelRegion.bottom > Options.PixelRegion.top)
+	{
+		PixelBounds = { std::max(Options.PixelRegion.left, LONG(0)),
+						std::max(Options.PixelRegion.top, LONG(0)),
+						std::min(Options.PixelRegion.right, LONG(Width)),
+						std::min(Options.PixelRegion.bottom, LONG(Height)) };
+	}
+	if (PixelBounds.right <= PixelBounds.left || PixelBounds.bottom <= PixelBounds.top)
+	{
+		printf("Crop window is empty, rendering the whole image\n");
+		PixelBounds = { 0, 0, Width, Height };
+	}
+
+	unsigned int NumThreads = Options.NumThreads != 0 ? Options.NumThreads : std::thread::hardware_concurrency();
+#if !MULTI_THREADED
+	NumThreads = 1;
+#endif
+	int TileSize = Options.TileSize > 0 ? Options.TileSize
+										: TileManager::ComputeTileSize(
+											  PixelBounds.right - PixelBounds.left,
+											  PixelBounds.bottom - PixelBounds.top,
+											  std::max(1u, NumThreads));
+	TileManager.Initialize(PixelBounds, TileSize, Options.TileOrdering);
 
 	Scene.Camera.AspectRatio = float(Width) / float(Height);
-	Scene.Generate();
+	Scene.Generate(Options.LightSampler);
+}
+
+// Hello describing this process's film and sampling, a worker's has to equal the coordinator's
+static RenderProtocol::Hello CreateHello(
+	int							  Width,
+	int							  Height,
+	const RECT&					  PixelBounds,
+	const RenderOptions&		  Options,
+	const FilmCheckpointSettings& Sampling)
+{
+	RenderProtocol::Hello Hello = {};
+	Hello.Magic					= RenderProtocol::Magic;
+	Hello.Version				= RenderProtocol::Version;
+	Hello.Width					= Width;
+	Hello.Height				= Height;
+	Hello.Left					= PixelBounds.left;
+	Hello.Top					= PixelBounds.top;
+	Hello.Right					= PixelBounds.right;
+	Hello.Bottom				= PixelBounds.bottom;
+
+	Hello.FilterType   = uint32_t(Options.Filter.Type);
+	Hello.FilterRadius = Options.Filter.Radius;
+	Hello.FilterAlpha  = Options.Filter.Alpha;
+	Hello.FilterB	   = Options.Filter.B;
+	Hello.FilterC	   = Options.Filter.C;
+
+	const AOVDesc& AOVs	   = Options.AOVs;
+	const bool	   Flags[] = { AOVs.Albedo, AOVs.Normal,   AOVs.Depth,		AOVs.InstanceID, AOVs.GeometryID,
+							   AOVs.Direct, AOVs.Indirect, AOVs.SampleCount, AOVs.Variance };
+	for (uint32_t i = 0; i < std::size(Flags); ++i)
+	{
+		Hello.AOVFlags |= uint32_t(Flags[i]) << i;
+	}
+
+	Hello.SamplerType		 = Sampling.SamplerType;
+	Hello.NumSamplesPerPixel = Sampling.NumSamplesPerPixel;
+	Hello.Seed				 = Sampling.Seed;
+	Hello.AdaptiveSampling	 = Sampling.AdaptiveSampling;
+	Hello.MinSamplesPerPixel = Sampling.MinSamplesPerPixel;
+	Hello.MaxSamplesPerPixel = Sampling.MaxSamplesPerPixel;
+	Hello.AdaptiveThreshold	 = Sampling.AdaptiveThreshold;
+	return Hello;
 }
 
 int Integrator::Render(const Scene& Scene, const Sampler& Sampler)
 {
-	Texture2D<RGBSpectrum> Output(Width, Height);
+	if (Options.Mode == RenderMode::Worker)
+	{
+		return RenderWorker(Scene, Sampler);
+	}
 
-	ProgressReport ProgressReport("Render", (int)TileManager.size());
+	Film Film(PixelBounds, Options.Filter, Options.AOVs, TracesLightPaths());
 
-	auto Process = [&](FilmTile& Tile)
+	const bool Checkpointing = !Options.CheckpointPath.empty();
+
+	int FirstSample = 0;
+	if (Checkpointing && Options.Resume && std::filesystem::exists(Options.CheckpointPath))
+	{
+		if (Film.LoadCheckpoint(Options.CheckpointPath, GetCheckpointSettings(Sampler), &FirstSample))
+		{
+			printf("Resuming from %s after %d samples\n", Options.CheckpointPath.string().c_str(), FirstSample);
+		}
+		else
+		{
+			printf(
+				"Failed to load checkpoint %s, it is corrupt or was rendered with another crop window or sampler "
+				"settings. Rendering from scratch\n",
+				Options.CheckpointPath.string().c_str());
+		}
+	}
+
+	std::unique_ptr<RenderCoordinator> Coordinator;
+	if (Options.Mode == RenderMode::Coordinator)
+	{
+		Coordinator = std::make_unique<RenderCoordinator>(
+			Options.Port,
+			CreateHello(Width, Height, PixelBounds, Options, GetCheckpointSettings(Sampler)),
+			Options.WorkerTimeout);
+		if (!*Coordinator)
+		{
+			printf("Failed to listen on port %u\n", unsigned(Options.Port));
+			return EXIT_FAILURE;
+		}
+		printf("Waiting for workers on port %u\n", unsigned(Options.Port));
+	}
+
+#if MULTI_THREADED
+	// Tiles are handed out to the workers in contiguous ranges of the tile order, idle workers steal.
+	// A coordinator renders no tiles, it keeps no worker threads around and post-processes on this thread
+	std::optional<TaskScheduler> Scheduler;
+	if (!Coordinator)
 	{
-		auto Rect = Tile.Rect;
+		Scheduler.emplace(Options.NumThreads, Options.PinThreads);
+	}
+	TaskScheduler* pScheduler = Scheduler ? &*Scheduler : nullptr;
+#else
+	TaskScheduler* pScheduler = nullptr;
+#endif
 
-		auto pSampler = Sampler.Clone();
+	const int MaxSamplesPerPixel = GetMaxSamplesPerPixel(Sampler);
+	const int SamplesPerPass	 = Options.Progressive || Checkpointing ? std::max(1, Options.SamplesPerPass)
+																		: MaxSamplesPerPixel;
+	const int NumPasses = std::max(0, MaxSamplesPerPixel - FirstSample + SamplesPerPass - 1) / SamplesPerPass;
+
+	auto SaveImage = [&]() { return Save(Film, Options, pScheduler); };
+
+	using Clock					  = std::chrono::steady_clock;
+	const auto StartTime		  = Clock::now();
+	auto	   LastCheckpointTime = StartTime;
+
+	Deadline = Clock::time_point::max();
+	if (Options.TimeBudget > 0.0f)
+	{
+		Deadline = StartTime + std::chrono::duration_cast<Clock::duration>(
+								   std::chrono::duration<float>(Options.TimeBudget));
+	}
+
+	for (int Pass = 0; Pass < NumPasses; ++Pass)
+	{
+		const int SampleBegin = FirstSample + Pass * SamplesPerPass;
+		const int SampleEnd	  = std::min(SampleBegin + SamplesPerPass, MaxSamplesPerPixel);
 
-		// Render
-		// For each pixel and pixel sample
-		for (int y = Rect.top; y < Rect.bottom; ++y)
 		{
-			for (int x = Rect.left; x < Rect.right; ++x)
+			ProgressReport ProgressReport(
+				NumPasses > 1 ? "Render pass " + std::to_string(Pass + 1) + "/" + std::to_string(NumPasses) : "Render",
+				(int)TileManager.size());
+
+			auto Process = [&](FilmTile& Tile)
 			{
-				if (x == DEBUG_X && y == DEBUG_Y)
+				// Tiles that would start after the deadline are skipped, the film keeps what it has
+				if (DeadlinePassed())
 				{
-					DEBUG_PIXEL = true;
+					ProgressReport.Update();
+					return;
 				}
 
-				pSampler->StartPixel(x, y);
+				FilmTileBuffer TileBuffer(Film, Tile.Rect);
+				RenderTile(Scene, Sampler, Tile, SampleBegin, SampleEnd, Film, TileBuffer);
+				Film.MergeTileBuffer(TileBuffer);
+
+				ProgressReport.Update();
+			};
 
-				Spectrum L(0);
-				do
+			if (Coordinator)
+			{
+				Coordinator->RenderPass(
+					TileManager,
+					SampleBegin,
+					SampleEnd,
+					Film,
+					Deadline,
+					[&]()
+					{
+						ProgressReport.Update();
+					});
+			}
+			else
+			{
+#if MULTI_THREADED
+				Scheduler->ParallelFor(
+					TileManager.size(),
+					[&](size_t TileIndex, unsigned int)
+					{
+						Process(TileManager[int(TileIndex)]);
+					});
+#else
+				for (auto& tile : TileManager)
 				{
-					auto sampleJitter = pSampler->Get2D();
+					Process(tile);
+				}
+#endif
+			}
+		}
+
+		bool LastPass = Pass + 1 == NumPasses;
+		if (DeadlinePassed())
+		{
+			printf("Time budget of %.1fs reached in pass %d/%d\n", Options.TimeBudget, Pass + 1, NumPasses);
+			LastPass = true;
+		}
+
+		// A pass cut short by the deadline is stored as complete, resuming moves on to new sample indices rather
+		// than repeating the ones most pixels already took
+		std::chrono::duration<float> SinceCheckpoint = Clock::now() - LastCheckpointTime;
+		if (Checkpointing && (LastPass || SinceCheckpoint.count() >= Options.CheckpointInterval))
+		{
+			if (!Film.SaveCheckpoint(Options.CheckpointPath, SampleEnd, GetCheckpointSettings(Sampler)))
+			{
+				printf("Failed to write checkpoint %s\n", Options.CheckpointPath.string().c_str());
+			}
+			LastCheckpointTime = Clock::now();
+		}
+
+		if (LastPass)
+		{
+			break;
+		}
 
-					auto u = (float(x) + sampleJitter.x) / (float(Width) - 1);
-					auto v = (float(y) + sampleJitter.y) / (float(Height) - 1);
+		// Intermediate images overwrite the output so it always holds the latest state of the film
+		if (Options.Progressive)
+		{
+			SaveImage();
+		}
+	}
+
+	return SaveImage();
+}
+
+int Integrator::Benchmark(
+	const Scene&   Scene,
+	const Sampler& Sampler,
+	unsigned int   MaxThreads /*= 0*/,
+	int			   NumPasses /*= 3*/)
+{
+#if MULTI_THREADED
+	MaxThreads = MaxThreads != 0 ? MaxThreads : std::max(1u, std::thread::hardware_concurrency());
+#else
+	MaxThreads = 1;
+#endif
+	NumPasses = std::max(1, NumPasses);
+
+	const int SamplesPerPass = std::min(std::max(1, Options.SamplesPerPass), GetMaxSamplesPerPixel(Sampler));
+
+	printf("Benchmark of %zu tiles, %d samples per pass\n", TileManager.size(), SamplesPerPass);
+	printf("Threads  Best pass (s)  Mean pass (s)  Speedup  Efficiency\n");
 
-					RayDesc ray = Scene.Camera.GetRay(u, v);
+	using Clock				  = std::chrono::steady_clock;
+	float SingleThreadSeconds = 0.0f;
+	for (unsigned int NumThreads = 1;; NumThreads = std::min(NumThreads * 2, MaxThreads))
+	{
+		TaskScheduler Scheduler(NumThreads, Options.PinThreads);
 
-					L += Li(ray, Scene, *pSampler);
-				} while (pSampler->StartNextSample());
+		// Every pass renders the same samples into a fresh film so adaptive sampling sees the same pixels.
+		// The first pass warms up the per-thread arenas and is not timed
+		float BestSeconds  = std::numeric_limits<float>::max();
+		float TotalSeconds = 0.0f;
+		for (int Pass = 0; Pass <= NumPasses; ++Pass)
+		{
+			Film Film(PixelBounds, Options.Filter, Options.AOVs, TracesLightPaths());
 
-				L /= float(pSampler->GetNumSamplesPerPixel());
+			const auto PassStartTime = Clock::now();
+			Scheduler.ParallelFor(
+				TileManager.size(),
+				[&](size_t TileIndex, unsigned int)
+				{
+					FilmTile&	   Tile = TileManager[int(TileIndex)];
+					FilmTileBuffer TileBuffer(Film, Tile.Rect);
+					RenderTile(Scene, Sampler, Tile, 0, SamplesPerPass, Film, TileBuffer);
+					Film.MergeTileBuffer(TileBuffer);
+				});
+			std::chrono::duration<float> PassDuration = Clock::now() - PassStartTime;
 
-				Output.SetPixel(x, y, L);
+			if (Pass > 0)
+			{
+				BestSeconds = std::min(BestSeconds, PassDuration.count());
+				TotalSeconds += PassDuration.count();
 			}
 		}
 
-		ProgressReport.Update();
-	};
-#if MULTI_THREADED
-	parallel_for_each(
-		TileManager.begin(),
-		TileManager.end(),
-		[&](auto& tile)
+		if (NumThreads == 1)
 		{
-			Process(tile);
+			SingleThreadSeconds = BestSeconds;
+		}
+		const float Speedup = SingleThreadSeconds / BestSeconds;
+		printf(
+			"%7u  %13.3f  %13.3f  %7.2f  %9.0f%%\n",
+			NumThreads,
+			BestSeconds,
+			TotalSeconds / float(NumPasses),
+			Speedup,
+			100.0f * Speedup / float(NumThreads));
+
+		if (NumThreads == MaxThreads)
+		{
+			break;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
+
+int Integrator::RenderWorker(const Scene& Scene, const Sampler& Sampler)
+{
+	using namespace RenderProtocol;
+
+	// Tiles arrive with the coordinator's pixel statistics, this film only holds them while they are rendered
+	Film Film(PixelBounds, Options.Filter, Options.AOVs);
+
+	std::atomic<int>  NumTilesRendered = 0;
+	std::atomic<bool> Connected		   = false;
+
+	// Every worker thread opens its own connection, to the coordinator each of them is a separate worker
+	TaskScheduler Scheduler(Options.NumThreads, Options.PinThreads);
+	Scheduler.ParallelFor(
+		Scheduler.GetNumWorkers(),
+		[&](size_t, unsigned int)
+		{
+			Socket Connection = Socket::Connect(Options.CoordinatorAddress, Options.Port);
+			if (!Connection)
+			{
+				return;
+			}
+			Connected = true;
+
+			Hello Hello = CreateHello(Width, Height, PixelBounds, Options, GetCheckpointSettings(Sampler));
+			if (!Connection.Send(Hello))
+			{
+				return;
+			}
+
+			TileMessage			   Request = {};
+			std::vector<std::byte> Payload;
+			while (Connection.Receive(Request) && Request.Type == MessageType::RenderTile)
+			{
+				FilmTile Tile = {};
+				Tile.Rect	  = { Request.Left, Request.Top, Request.Right, Request.Bottom };
+
+				Payload.resize(Request.PayloadSize);
+				if (!Connection.Receive(Payload.data(), Payload.size()) ||
+					!Film.WriteTileStatistics(Tile.Rect, Payload))
+				{
+					break;
+				}
+
+				FilmTileBuffer TileBuffer(Film, Tile.Rect);
+				RenderTile(Scene, Sampler, Tile, Request.SampleBegin, Request.SampleEnd, Film, TileBuffer);
+
+				// Updated statistics of the tile followed by the filtered samples of the padded tile
+				Payload							  = Film.ReadTileStatistics(Tile.Rect);
+				std::span<const FilmPixel> Pixels = TileBuffer.GetPixels();
+
+				TileMessage Result = Request;
+				Result.Type		   = MessageType::TileResult;
+				Result.PayloadSize = uint32_t(Payload.size());
+				Result.BufferSize  = uint32_t(Pixels.size_bytes());
+				if (!Connection.Send(Result) || !Connection.Send(Payload.data(), Payload.size()) ||
+					!Connection.Send(Pixels.data(), Pixels.size_bytes()))
+				{
+					break;
+				}
+				NumTilesRendered++;
+			}
 		});
-#else
-	for (auto& tile : TileManager)
+
+	if (!Connected)
 	{
-		Process(tile);
+		printf(
+			"Failed to connect to coordinator %s:%u\n",
+			Options.CoordinatorAddress.c_str(),
+			unsigned(Options.Port));
+		return EXIT_FAILURE;
 	}
-#endif
 
-	return Save(Output);
+	printf("Rendered %d tiles for coordinator %s\n", NumTilesRendered.load(), Options.CoordinatorAddress.c_str());
+	return EXIT_SUCCESS;
 }
 
-Spectrum EstimateDirect(
+void Integrator::RenderTile(
+	const Scene&	Scene,
+	const Sampler&	Sampler,
+	const FilmTile& Tile,
+	int				SampleBegin,
+	int				SampleEnd,
+	Film&			Film,
+	FilmTileBuffer& TileBuffer)
+{
+	auto	  Rect		= Tile.Rect;
+	const int TileWidth = Rect.right - Rect.left;
+	const int NumPixels = TileWidth * (Rect.bottom - Rect.top);
+
+	auto pSampler = Sampler.Clone();
+
+	// Per-thread arena, its blocks are kept across tiles so Li never allocates from the heap once warmed up
+	thread_local MemoryArena Arena;
+
+	// Radiance of the current sample of every pixel, deferred shadow rays of the whole tile are flushed together
+	std::vector<Spectrum> L(NumPixels, Spectrum(0.0f));
+	std::vector<Vector2f> FilmPositions(NumPixels);
+	ShadowRayQueue		  ShadowRays(Scene, L);
+
+	// First hits and deferred direct lighting of the current sample, only kept if the film has sampled AOVs
+	const bool			   RecordAOVs = Film.GetAOVs().NeedsSamples();
+	std::vector<AOVSample> AOVs(RecordAOVs ? NumPixels : 0);
+	std::vector<Spectrum>  DirectL(RecordAOVs ? NumPixels : 0, Spectrum(0.0f));
+	ShadowRays.SetDirectRadiance(DirectL);
+
+	// Pixels (indices local to the tile) that still take samples
+	std::vector<int> ActivePixels(NumPixels);
+	std::iota(ActivePixels.begin(), ActivePixels.end(), 0);
+	RetireConvergedPixels(Film, Tile, SampleBegin, ActivePixels);
+
+	// Render
+	// For each pixel sample and unconverged pixel
+	for (int SampleIndex = SampleBegin; SampleIndex < SampleEnd && !ActivePixels.empty() && !DeadlinePassed();
+		 ++SampleIndex)
+	{
+		for (int Pixel : ActivePixels)
+		{
+			int x = Rect.left + Pixel % TileWidth;
+			int y = Rect.top + Pixel / TileWidth;
+
+			if (x == DEBUG_X && y == DEBUG_Y)
+			{
+				DEBUG_PIXEL = true;
+			}
+
+			L[Pixel] = Spectrum(0.0f);
+			ShadowRays.SetPixel(Pixel);
+			ShadowRays.SetFirstHit(false);
+
+			AOVSample* pAOV = nullptr;
+			if (RecordAOVs)
+			{
+				AOVs[Pixel]	   = {};
+				DirectL[Pixel] = Spectrum(0.0f);
+				pAOV		   = &AOVs[Pixel];
+			}
+
+			pSampler->StartPixelSample(x, y, SampleIndex);
+
+			Vector2f sampleJitter = pSampler->Get2D();
+			FilmPositions[Pixel]  = Vector2f(float(x) + sampleJitter.x, float(y) + sampleJitter.y);
+
+			RayDesc ray = GenerateCameraRay(Scene, x, y, sampleJitter);
+
+			L[Pixel] += Li(ray, Scene, *pSampler, Arena, ShadowRays, pAOV);
+			Arena.Reset();
+		}
+
+		ShadowRays.Flush();
+
+		for (int Pixel : ActivePixels)
+		{
+			const int x = Rect.left + Pixel % TileWidth;
+			const int y = Rect.top + Pixel / TileWidth;
+			Film.AddSampleStatistics(x, y, L[Pixel]);
+			if (RecordAOVs)
+			{
+				AOVs[Pixel].Direct += DirectL[Pixel];
+				Film.AddAOVSample(x, y, AOVs[Pixel], L[Pixel]);
+			}
+			TileBuffer.AddSample(FilmPositions[Pixel], L[Pixel]);
+		}
+
+		RetireConvergedPixels(Film, Tile, SampleIndex + 1, ActivePixels);
+	}
+}
+
+void Integrator::RecordFirstHit(const RayDesc& ray, const SurfaceInteraction& si, AOVSample* pAOV)
+{
+	if (!pAOV)
+	{
+		return;
+	}
+
+	pAOV->Hit		 = true;
+	pAOV->Albedo	 = si.BSDF ? si.BSDF.Albedo() : Spectrum(0.0f);
+	pAOV->Normal	 = si.ShadingFrame.n;
+	pAOV->Depth		 = distance(si.p, ray.Origin);
+	pAOV->InstanceID = si.InstanceID;
+	pAOV->GeometryID = si.GeometryID;
+}
+
+int Integrator::GetMaxSamplesPerPixel(const Sampler& Sampler) const
+{
+	if (!Options.AdaptiveSampling)
+	{
+		return Sampler.GetNumSamplesPerPixel();
+	}
+	int MaxSamplesPerPixel =
+		Options.MaxSamplesPerPixel > 0 ? Options.MaxSamplesPerPixel : 4 * Sampler.GetNumSamplesPerPixel();
+	return std::max(MaxSamplesPerPixel, Options.MinSamplesPerPixel);
+}
+
+FilmCheckpointSettings Integrator::GetCheckpointSettings(const Sampler& Sampler) const
+{
+	FilmCheckpointSettings Settings = {};
+	Settings.SamplerType			= uint32_t(Sampler.GetType());
+	Settings.NumSamplesPerPixel		= Sampler.GetNumSamplesPerPixel();
+	Settings.Seed					= Sampler.GetSeed();
+	if (Options.AdaptiveSampling)
+	{
+		Settings.AdaptiveSampling	= 1;
+		Settings.MinSamplesPerPixel = Options.MinSamplesPerPixel;
+		Settings.MaxSamplesPerPixel = GetMaxSamplesPerPixel(Sampler);
+		Settings.AdaptiveThreshold	= Options.AdaptiveThreshold;
+	}
+	return Settings;
+}
+
+RayDesc Integrator::GenerateCameraRay(const Scene& Scene, int x, int y, Vector2f Jitter) const
+{
+	auto u = (float(x) + Jitter.x) / (float(Width) - 1);
+	auto v = (float(y) + Jitter.y) / (float(Height) - 1);
+
+	return Scene.Camera.GetRay(u, v);
+}
+
+void Integrator::RetireConvergedPixels(
+	const Film&		  Film,
+	const FilmTile&	  Tile,
+	int				  NumSamples,
+	std::vector<int>& ActivePixels) const
+{
+	if (!Options.AdaptiveSampling || NumSamples < Options.MinSamplesPerPixel)
+	{
+		return;
+	}
+
+	const int TileWidth = Tile.Rect.right - Tile.Rect.left;
+	std::erase_if(
+		ActivePixels,
+		[&](int Pixel)
+		{
+			int x = Tile.Rect.left + Pixel % TileWidth;
+			int y = Tile.Rect.top + Pixel / TileWidth;
+			return Film.GetRelativeError(x, y) < Options.AdaptiveThreshold;
+		});
+}
+
+/*
+ *	Samples the light and evaluates the BSDF or phase function for the sample, visibility is left to the caller.
+ *	The sample is weighted against sampling the BSDF or phase function with the power heuristic, the light's
+ *	density is scaled by LightSelectionPdf when the competing strategy is the path's next bounce, which can
+ *	find any of the lights, rather than a scattering sample taken for this light only
+ */
+static Spectrum EstimateDirectUnoccluded(
 	const Interaction& Interaction,
 	const Light&	   Light,
 	const Vector2f&	   XiLight,
+	float			   LightSelectionPdf,
+	VisibilityTester*  pVisibility)
+{
+	// Sample light source with multiple importance sampling
+	Vector3f wi;
+	float	 lightPdf = 0.0f, scatteringPdf = 0.0f;
+	Spectrum Li = Light.SampleLi(Interaction, XiLight, &wi, &lightPdf, pVisibility);
+	if (lightPdf == 0.0f || Li.IsBlack())
+	{
+		return Spectrum(0.0f);
+	}
+
+	// Compute BSDF or phase function's value for light sample
+	Spectrum f;
+	if (Interaction.IsSurfaceInteraction())
+	{
+		// Evaluate BSDF for light sampling strategy
+		const SurfaceInteraction& si = static_cast<const SurfaceInteraction&>(Interaction);
+		f							 = si.BSDF.f(si.wo, wi) * absdot(wi, si.ShadingFrame.n);
+		scatteringPdf				 = si.BSDF.Pdf(si.wo, wi);
+	}
+	else
+	{
+		// Evaluate phase function for light sampling strategy
+		const MediumInteraction& mi = static_cast<const MediumInteraction&>(Interaction);
+		float					 p	= mi.phase->p(mi.wo, wi);
+		f							= Spectrum(p);
+		scatteringPdf				= p;
+	}
+
+	if (f.IsBlack())
+	{
+		return Spectrum(0.0f);
+	}
+
+	// Delta lights can only be found by sampling them
+	if (Light.IsDeltaLight())
+	{
+		return f * Li / lightPdf;
+	}
+
+	float weight = PowerHeuristic(1, lightPdf * LightSelectionPdf, 1, scatteringPdf);
+	return f * Li * weight / lightPdf;
+}
+
+/*
+ *	Samples the BSDF or phase function and returns the light's emission found along the sampled direction,
+ *	weighted against sampling the light with the power heuristic
+ */
+static Spectrum EstimateDirectScattering(
+	const Interaction& Interaction,
+	const Light&	   Light,
+	const Vector2f&	   XiScattering,
 	const Scene&	   Scene,
 	Sampler&		   Sampler,
 	bool			   HandleMedia)
 {
-	Spectrum Ld(0.0f);
-	// Sample light source with multiple importance sampling
-	Vector3f		 wi;
-	float			 lightPdf = 0.0f, scatteringPdf = 0.0f;
-	VisibilityTester visibility;
-	Spectrum		 Li = Light.SampleLi(Interaction, XiLight, &wi, &lightPdf, &visibility);
-	if (lightPdf > 0.0f && !Li.IsBlack())
+	Vector3f wi;
+	Spectrum f;
+	float	 scatteringPdf	 = 0.0f;
+	bool	 sampledSpecular = false;
+	if (Interaction.IsSurfaceInteraction())
 	{
-		// Compute BSDF or phase function's value for light sample
-		Spectrum f;
-		if (Interaction.IsSurfaceInteraction())
+		// Sample scattered direction for surface interactions
+		const SurfaceInteraction& si		 = static_cast<const SurfaceInteraction&>(Interaction);
+		std::optional<BSDFSample> bsdfSample = si.BSDF.Samplef(si.wo, XiScattering);
+		if (!bsdfSample)
 		{
-			// Evaluate BSDF for light sampling strategy
-			const SurfaceInteraction& si = static_cast<const SurfaceInteraction&>(Interaction);
-			f							 = si.BSDF.f(si.wo, wi) * absdot(wi, si.ShadingFrame.n);
-			scatteringPdf				 = si.BSDF.Pdf(si.wo, wi);
+			return Spectrum(0.0f);
 		}
-		else
+
+		wi				= bsdfSample->wi;
+		f				= bsdfSample->f * absdot(wi, si.ShadingFrame.n);
+		scatteringPdf	= bsdfSample->pdf;
+		sampledSpecular = IsSpecular(bsdfSample->flags);
+	}
+	else
+	{
+		// Sample scattered direction for medium interactions
+		const MediumInteraction& mi = static_cast<const MediumInteraction&>(Interaction);
+		float					 p	= mi.phase->Sample_p(mi.wo, &wi, XiScattering);
+		f							= Spectrum(p);
+		scatteringPdf				= p;
+	}
+
+	// Emission found through specular lobes is picked up at full weight by the path's next bounce
+	if (f.IsBlack() || scatteringPdf == 0.0f || sampledSpecular)
+	{
+		return Spectrum(0.0f);
+	}
+
+	float lightPdf = Light.PdfLi(Interaction, wi);
+	if (lightPdf == 0.0f)
+	{
+		return Spectrum(0.0f);
+	}
+	float weight = PowerHeuristic(1, scatteringPdf, 1, lightPdf);
+
+	// Find the closest surface along the sampled direction, the light is seen if it is that surface or at infinity
+	RayDesc							  ray = Interaction.SpawnRay(wi);
+	Spectrum						  Tr(1.0f);
+	std::optional<SurfaceInteraction> hit = HandleMedia ? Scene.IntersectTr(ray, Sampler, &Tr) : Scene.Intersect(ray);
+
+	Spectrum Li(0.0f);
+	if (hit)
+	{
+		if (hit->AreaLight == &Light)
 		{
-			// Evaluate phase function for light sampling strategy
-			const MediumInteraction& mi = static_cast<const MediumInteraction&>(Interaction);
-			float					 p	= mi.phase->p(mi.wo, wi);
-			f							= Spectrum(p);
-			scatteringPdf				= p;
+			Li = hit->Le(-wi);
 		}
+	}
+	else
+	{
+		Li = Light.Le(ray);
+	}
+	if (Li.IsBlack())
+	{
+		return Spectrum(0.0f);
+	}
+	return f * Li * Tr * weight / scatteringPdf;
+}
 
-		// Evaluate BSDF for light sampling strategy
+/*
+ *	Direct lighting from a single light with multiple importance sampling, a light sample and a BSDF or
+ *	phase function sample are combined with the power heuristic
+ */
+Spectrum EstimateDirect(
+	const Interaction& Interaction,
+	const Light&	   Light,
+	const Vector2f&	   XiLight,
+	const Vector2f&	   XiScattering,
+	const Scene&	   Scene,
+	Sampler&		   Sampler,
+	bool			   HandleMedia)
+{
+	VisibilityTester visibility;
+	Spectrum		 Ld = EstimateDirectUnoccluded(Interaction, Light, XiLight, 1.0f, &visibility);
 
-		if (!f.IsBlack())
+	// Compute effect of visibility for light source sample
+	if (!Ld.IsBlack())
+	{
+		if (HandleMedia)
 		{
-			// Compute effect of visibility for light source sample
-			if (HandleMedia)
-			{
-				Li *= visibility.Tr(Scene, Sampler);
-			}
-			else
-			{
-				if (!visibility.Unoccluded(Scene))
-				{
-					Li = Spectrum(0.0f);
-				}
-			}
-
-			// Add light's contribution to reflected radiance
-			if (!Li.IsBlack())
+			Ld *= visibility.Tr(Scene, Sampler);
+		}
+		else
+		{
+			if (!visibility.Unoccluded(Scene))
 			{
-				// Only handling point light for now
-				Ld += f * Li / lightPdf;
+				Ld = Spectrum(0.0f);
 			}
 		}
 	}
 
+	// Sample BSDF with multiple importance sampling, directions sampled that way never hit a delta light
+	if (!Light.IsDeltaLight())
+	{
+		Ld += EstimateDirectScattering(Interaction, Light, XiScattering, Scene, Sampler, HandleMedia);
+	}
+
 	return Ld;
 }
 
-Spectrum Integrator::UniformSampleOneLight(
+Spectrum Integrator::SampleOneLight(
 	const Interaction& Interaction,
 	const Scene&	   Scene,
 	Sampler&		   Sampler,
@@ -323,17 +1187,96 @@ Spectrum Integrator::UniformSampleOneLight(
 		return Spectrum(0.0f);
 	}
 
-	int numLights = (int)Scene.Lights.size();
+	// Samples are drawn up front so later dimensions don't depend on whether a light was found
+	float	 uLight		  = Sampler.Get1D();
+	Vector2f XiLight	  = Sampler.Get2D();
+	Vector2f XiScattering = Sampler.Get2D();
+
+	float		 lightPdf;
+	const Light* pLight = Scene.LightSampler->Sample(Interaction, uLight, &lightPdf);
+	if (!pLight)
+	{
+		return Spectrum(0.0f);
+	}
+
+	return EstimateDirect(Interaction, *pLight, XiLight, XiScattering, Scene, Sampler, HandleMedia) / lightPdf;
+}
+
+void Integrator::SampleOneLight(
+	const Interaction& Interaction,
+	const Scene&	   Scene,
+	Sampler&		   Sampler,
+	const Spectrum&	   beta,
+	ShadowRayQueue&	   ShadowRays)
+{
+	if (Scene.Lights.empty())
+	{
+		return;
+	}
+
+	float	 uLight = Sampler.Get1D();
+	Vector2f Xi		= Sampler.Get2D();
+
+	float		 lightPdf;
+	const Light* pLight = Scene.LightSampler->Sample(Interaction, uLight, &lightPdf);
+	if (!pLight)
+	{
+		return;
+	}
 
-	int	  lightIndex;
-	float lightPdf;
+	VisibilityTester visibility;
+	Spectrum		 Ld = EstimateDirectUnoccluded(Interaction, *pLight, Xi, lightPdf, &visibility);
+	if (!Ld.IsBlack())
+	{
+		ShadowRays.Push(visibility.I0.SpawnRayTo(visibility.I1), beta * Ld / lightPdf);
+	}
+}
 
-	lightIndex = std::min((int)(Sampler.Get1D() * numLights), numLights - 1);
-	lightPdf   = 1.0f / float(numLights);
+// Weights the emission Le of pLight found along ray against the light sample taken at Prev
+static Spectrum WeightEmission(
+	const Spectrum&	   Le,
+	const Light*	   pLight,
+	const RayDesc&	   ray,
+	const Scene&	   Scene,
+	const Interaction& Prev,
+	float			   ScatteringPdf,
+	bool			   FullWeight)
+{
+	if (Le.IsBlack() || FullWeight)
+	{
+		return Le;
+	}
 
-	const auto pLight = Scene.Lights[lightIndex];
+	// The light sample competing with this ray picked the light with the scene's light sampler at Prev
+	float lightPdf = Scene.LightSampler->PMF(Prev, pLight) * pLight->PdfLi(Prev, ray.Direction);
+	return Le * PowerHeuristic(1, ScatteringPdf, 1, lightPdf);
+}
 
-	Vector2f Xi = Sampler.Get2D();
+Spectrum Integrator::EscapedRadiance(
+	const RayDesc&	   ray,
+	const Scene&	   Scene,
+	const Interaction& Prev,
+	float			   ScatteringPdf,
+	bool			   FullWeight)
+{
+	Spectrum L(0.0f);
+	for (const Light* pLight : Scene.Lights)
+	{
+		if (pLight->_Flags & Light::Infinite)
+		{
+			L += WeightEmission(pLight->Le(ray), pLight, ray, Scene, Prev, ScatteringPdf, FullWeight);
+		}
+	}
+	return L;
+}
 
-	return EstimateDirect(Interaction, *pLight, Xi, Scene, Sampler, HandleMedia) / lightPdf;
+Spectrum Integrator::EmittedRadiance(
+	const RayDesc&			  ray,
+	const SurfaceInteraction& si,
+	const Scene&			  Scene,
+	const Interaction&		  Prev,
+	float					  ScatteringPdf,
+	bool					  FullWeight)
+{
+	return WeightEmission(si.Le(-ray.Direction), si.AreaLight, ray, Scene, Prev, ScatteringPdf, FullWeight);
 }
@@ -1,41 +1,53 @@
 #pragma once
+#include <chrono>
+#include <filesystem>
 #include <memory>
+#include <string>
 #include <vector>
 #include "../Spectrum.h"
+#include "../Film.h"
+#include "../ImageIO.h"
+#include "../Denoiser.h"
+#include "../Light/LightSampler.h"
 
 struct RayDesc;
 struct Interaction;
+struct SurfaceInteraction;
 struct Scene;
 class Sampler;
+class ShadowRayQueue;
+class MemoryArena;
 
 struct FilmTile
 {
-	static const int TILE_SIZE = 32;
+	static constexpr int MinTileSize = 8;
+	static constexpr int MaxTileSize = 64;
 
 	RECT Rect;
 };
 
+enum class TileOrder
+{
+	Scanline,
+	Morton,
+	Hilbert,
+	Spiral // Outwards from the image center
+};
+
 class TileManager
 {
 public:
-	void Initialize(int Width, int Height)
-	{
-		for (int y = 0; y < Height; y += FilmTile::TILE_SIZE)
-		{
-			for (int x = 0; x < Width; x += FilmTile::TILE_SIZE)
-			{
-				int minX = x, minY = y;
-				int maxX = x + FilmTile::TILE_SIZE, maxY = y + FilmTile::TILE_SIZE;
-				maxX = maxX <= Width ? maxX : Width;
-				maxY = maxY <= Height ? maxY : Height;
-
-				FilmTile tile = {};
-				tile.Rect	  = { minX, minY, maxX, maxY };
-
-				FilmTiles.emplace_back(std::move(tile));
-			}
-		}
-	}
+	/*
+	 *	Splits Bounds into TileSize x TileSize tiles sorted by Order, the scheduler hands out contiguous
+	 *	ranges of this order so space filling curves keep the tiles of a worker close together
+	 */
+	void Initialize(const RECT& Bounds, int TileSize, TileOrder Order);
+
+	/*
+	 *	Picks the largest power of two tile size in [MinTileSize, MaxTileSize] that still gives every thread
+	 *	enough tiles to balance the tail of the render
+	 */
+	static int ComputeTileSize(int Width, int Height, unsigned int NumThreads);
 
 	auto& operator[](int i) { return FilmTiles[i]; }
 
@@ -47,30 +59,237 @@ private:
 	std::vector<FilmTile> FilmTiles;
 };
 
+enum class RenderMode
+{
+	Local,
+	Coordinator, // Hands tiles out to worker processes and merges their results
+	Worker		 // Renders tiles for a coordinator
+};
+
+struct RenderOptions
+{
+	// Output image resolution
+	int Width  = 1920;
+	int Height = 1080;
+
+	/*
+	 *	Only the pixels inside the crop window, given in normalized [0, 1] image coordinates as
+	 *	(left, top, right, bottom), are rendered and saved. A non empty PixelRegion (in pixels) takes
+	 *	precedence over the crop window. Camera rays are generated as for the full image either way
+	 */
+	float CropWindow[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+	RECT  PixelRegion	= {};
+
+	// Pixel reconstruction filter, the default box of radius 0.5 averages the samples inside each pixel
+	FilterDesc Filter;
+
+	/*
+	 *	The format of the output follows its extension, .png is tone mapped to 8 or 16-bit while .pfm and .exr
+	 *	keep linear radiance. An empty path writes Release.png (Debug.png in debug builds)
+	 */
+	std::filesystem::path OutputPath;
+	ImageWriteDesc		  Output;
+	// AOVs rendered along with the image, they are written as layers of .exr outputs
+	AOVDesc AOVs;
+
+	/*
+	 *	Denoises the image and writes it along with the raw one, as the Denoised layer of .exr outputs and as
+	 *	<name>_denoised next to other outputs. Turns on the albedo and normal AOVs that guide the denoiser
+	 */
+	bool		 Denoise = false;
+	DenoiserDesc DenoiserOptions;
+
+	/*
+	 *	Strategy for picking the light that is sampled at every shading point. The light BVH favors close and
+	 *	bright lights and suits scenes with many emissive triangles, the spatial sampler does the same with a
+	 *	lazily built grid of distributions for scenes with few lights (it falls back to the BVH above
+	 *	SpatialLightSampler::MaxLights) and the power sampler ignores where the shading point is
+	 */
+	LightSamplerType LightSampler = LightSamplerType::BVH;
+
+	// Number of render worker threads, 0 uses every hardware thread
+	unsigned int NumThreads = 0;
+	// Binds every worker thread to its own logical processor
+	bool PinThreads = false;
+	// Tile edge length in pixels, 0 selects it from the resolution and thread count
+	int		  TileSize	   = 0;
+	TileOrder TileOrdering = TileOrder::Hilbert;
+
+	/*
+	 *	Adaptive sampling stops sampling a pixel once the relative error of its estimate drops below
+	 *	AdaptiveThreshold (checked from MinSamplesPerPixel on), the samples saved on converged pixels go to
+	 *	noisy pixels which may take up to MaxSamplesPerPixel samples. Without adaptive sampling every pixel
+	 *	takes the sampler's sample count. Light tracing splats don't enter the error estimate, so adaptive
+	 *	sampling is turned off for integrators that trace light paths
+	 */
+	bool  AdaptiveSampling	 = false;
+	int	  MinSamplesPerPixel = 16;
+	int	  MaxSamplesPerPixel = 0; // 0 uses 4x the sampler's sample count
+	float AdaptiveThreshold	 = 0.01f;
+
+	/*
+	 *	Progressive rendering renders SamplesPerPass samples of every tile per pass and saves the image after
+	 *	every pass. A TimeBudget (seconds) other than 0 is a hard deadline with or without progressive rendering,
+	 *	once it passed tiles stop between sample indices, tiles that have not started are skipped and the samples
+	 *	accumulated so far are saved. Tiles already handed to a worker process are still rendered in full
+	 */
+	bool  Progressive	 = false;
+	int	  SamplesPerPass = 1;
+	float TimeBudget	 = 0.0f;
+
+	/*
+	 *	A non empty CheckpointPath saves the film there at most every CheckpointInterval seconds (checked
+	 *	between passes of SamplesPerPass samples) and when rendering ends. With Resume set, rendering continues
+	 *	from the samples already stored in the checkpoint
+	 */
+	std::filesystem::path CheckpointPath;
+	float				  CheckpointInterval = 600.0f;
+	bool				  Resume			 = false;
+
+	/*
+	 *	Distributed rendering, the coordinator listens on Port and workers connect to CoordinatorAddress:Port.
+	 *	Every worker thread opens its own connection. Coordinator and workers must load the same scene with
+	 *	the same options, progressive rendering and checkpointing happen on the coordinator. A worker that
+	 *	returns no tile for WorkerTimeout seconds is dropped by the coordinator and its tile handed out again
+	 */
+	RenderMode	   Mode				  = RenderMode::Local;
+	std::string	   CoordinatorAddress = "127.0.0.1";
+	unsigned short Port				  = 27015;
+	float		   WorkerTimeout	  = 600.0f;
+};
+
 class Integrator
 {
 public:
 	virtual ~Integrator() = default;
 
-	// Output image resolution
-	static constexpr int Width	= 1920;
-	static constexpr int Height = 1080;
-
-	void Initialize(Scene& Scene);
+	void Initialize(Scene& Scene, const RenderOptions& Options = {});
 	int	 Render(const Scene& Scene, const Sampler& Sampler);
 
+	/*
+	 *	Thread scaling benchmark, renders SamplesPerPass samples of every tile into a fresh film with 1, 2, 4, ...
+	 *	up to MaxThreads worker threads (every hardware thread if 0) and prints the time per pass along with the
+	 *	speedup over one thread. The tiles of Initialize are kept for every thread count and nothing is saved
+	 */
+	int Benchmark(const Scene& Scene, const Sampler& Sampler, unsigned int MaxThreads = 0, int NumPasses = 3);
+
 	// All integrator inherited needs to implement this method
 	/*
 	 *	Sample the incident radiance along the given ray
+	 *	Arena is reset after every call, allocations from it must not outlive the call
+	 *	Only the radiance whose visibility is already resolved is returned. Integrators may defer light samples
+	 *	to ShadowRays, those are accumulated into the pixel when the queue is flushed after the samples of the
+	 *	tile. PathIntegrator and AOIntegrator defer, the volumetric integrators trace their shadow rays through
+	 *	media right away and leave ShadowRays untouched so everything they find is in the returned radiance
+	 *	pAOV is null unless the film has sampled AOVs, otherwise the first hit of the path is recorded into it
+	 *	with RecordFirstHit along with the direct lighting that is part of the returned radiance
 	 */
-	virtual Spectrum Li(RayDesc ray, const Scene& scene, Sampler& sampler) = 0;
+	virtual Spectrum Li(
+		RayDesc			ray,
+		const Scene&	scene,
+		Sampler&		sampler,
+		MemoryArena&	Arena,
+		ShadowRayQueue& ShadowRays,
+		AOVSample*		pAOV) = 0;
 
-	static Spectrum UniformSampleOneLight(
+	/*
+	 *	Direct lighting from one light picked by the scene's light sampler, see RenderOptions::LightSampler
+	 */
+	static Spectrum SampleOneLight(
 		const Interaction& Interaction,
 		const Scene&	   Scene,
 		Sampler&		   Sampler,
 		bool			   HandleMedia);
 
+	/*
+	 *	Deferred variant of SampleOneLight that does not handle media, the light sample weighted
+	 *	by the path throughput beta is pushed to ShadowRays instead of being tested for visibility right away
+	 */
+	static void SampleOneLight(
+		const Interaction& Interaction,
+		const Scene&	   Scene,
+		Sampler&		   Sampler,
+		const Spectrum&	   beta,
+		ShadowRayQueue&	   ShadowRays);
+
+protected:
+	/*
+	 *	Renders the pixel samples [SampleBegin, SampleEnd) of a single tile, the default implementation
+	 *	calls Li for one sample of every unconverged pixel of the tile per sample index.
+	 *	Samples are recorded in the pixel statistics of Film and splatted into TileBuffer, which the caller
+	 *	merges into Film
+	 */
+	virtual void RenderTile(
+		const Scene&	Scene,
+		const Sampler&	Sampler,
+		const FilmTile& Tile,
+		int				SampleBegin,
+		int				SampleEnd,
+		Film&			Film,
+		FilmTileBuffer& TileBuffer);
+
+	/*
+	 *	Emission of the lights at infinity along a ray that left the scene. The emission is weighted with the
+	 *	power heuristic against the light sample taken at Prev, the vertex the ray was sampled from with
+	 *	density ScatteringPdf, unless FullWeight is set because the ray is a camera ray or left a specular lobe
+	 */
+	static Spectrum EscapedRadiance(
+		const RayDesc&	   ray,
+		const Scene&	   Scene,
+		const Interaction& Prev,
+		float			   ScatteringPdf,
+		bool			   FullWeight);
+
+	// Same as EscapedRadiance for the emission of the area light si is on, if any
+	static Spectrum EmittedRadiance(
+		const RayDesc&			  ray,
+		const SurfaceInteraction& si,
+		const Scene&			  Scene,
+		const Interaction&		  Prev,
+		float					  ScatteringPdf,
+		bool					  FullWeight);
+
+	// Fills the first hit quantities of pAOV from the surface camera ray hit, does nothing if pAOV is null
+	static void RecordFirstHit(const RayDesc& ray, const SurfaceInteraction& si, AOVSample* pAOV);
+
+	// Number of samples a pixel takes at most
+	int GetMaxSamplesPerPixel(const Sampler& Sampler) const;
+
+	// Sampler and adaptive sampling settings a checkpoint has to match to be resumed
+	FilmCheckpointSettings GetCheckpointSettings(const Sampler& Sampler) const;
+
+	// Camera ray through the image position (x, y) + Jitter
+	RayDesc GenerateCameraRay(const Scene& Scene, int x, int y, Vector2f Jitter) const;
+
+	// Whether RenderTile splats light paths into the film, which then holds splats. Valid from Initialize on
+	virtual bool TracesLightPaths() const { return false; }
+
+	/*
+	 *	Removes the pixels (indices local to Tile) whose estimate converged from ActivePixels,
+	 *	does nothing unless adaptive sampling is enabled and NumSamples reached the minimum sample count
+	 */
+	void RetireConvergedPixels(
+		const Film&		  Film,
+		const FilmTile&	  Tile,
+		int				  NumSamples,
+		std::vector<int>& ActivePixels) const;
+
+	// True once the time budget of the render is used up, RenderTile stops between sample indices from then on
+	bool DeadlinePassed() const { return std::chrono::steady_clock::now() >= Deadline; }
+
+	RenderOptions Options;
+
+	// Output image resolution and the pixels of it that are rendered, set from Options in Initialize
+	int	 Width	= 0;
+	int	 Height = 0;
+	RECT PixelBounds;
+
+	// End of the time budget, set by Render and never reached without one
+	std::chrono::steady_clock::time_point Deadline = std::chrono::steady_clock::time_point::max();
+
 private:
+	// Serves tiles for a coordinator until it shuts the connections down
+	int RenderWorker(const Scene& Scene, const Sampler& Sampler);
+
 	TileManager TileManager;
 };
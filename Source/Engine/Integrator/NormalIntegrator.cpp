@@ -2,7 +2,13 @@
 #include "../Scene.h"
 #include "../Sampler/Sampler.h"
 
-Spectrum NormalIntegrator::Li(RayDesc ray, const Scene& scene, Sampler& sampler)
+Spectrum NormalIntegrator::Li(
+	RayDesc			ray,
+	const Scene&	scene,
+	Sampler&		sampler,
+	MemoryArena&	Arena,
+	ShadowRayQueue& ShadowRays,
+	AOVSample*		pAOV)
 {
 	std::optional<SurfaceInteraction> si = scene.Intersect(ray);
 	if (!si)
@@ -10,6 +16,8 @@ Spectrum NormalIntegrator::Li(RayDesc ray, const Scene& scene, Sampler& sampler)
 		return Spectrum(0.0f);
 	}
 
+	RecordFirstHit(ray, *si, pAOV);
+
 	Vector3f n;
 	switch (ViewType)
 	{
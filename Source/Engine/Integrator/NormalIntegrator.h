@@ -16,7 +16,13 @@ public:
 
 	}
 
-	Spectrum Li(RayDesc ray, const Scene& scene, Sampler& sampler) override;
+	Spectrum Li(
+		RayDesc			ray,
+		const Scene&	scene,
+		Sampler&		sampler,
+		MemoryArena&	Arena,
+		ShadowRayQueue& ShadowRays,
+		AOVSample*		pAOV) override;
 private:
 	NormalView ViewType;
 };
@@ -1,40 +1,88 @@
 #include "PathIntegrator.h"
 #include "../Scene.h"
 #include "../Sampler/Sampler.h"
+#include "ShadowRayQueue.h"
 
-Spectrum PathIntegrator::Li(RayDesc ray, const Scene& scene, Sampler& sampler)
+Spectrum PathIntegrator::Li(
+	RayDesc			ray,
+	const Scene&	scene,
+	Sampler&		sampler,
+	MemoryArena&	Arena,
+	ShadowRayQueue& ShadowRays,
+	AOVSample*		pAOV)
 {
 	Spectrum L(0), beta(1);
 	bool specularBounce = false;
 
+	// Vertex the current ray was sampled from and the BSDF's density for it, emission the ray finds is
+	// weighted against the light sample taken at that vertex
+	Interaction prevInteraction;
+	float		scatteringPdf = 0.0f;
+
 	for (int bounces = 0; ; ++bounces)
 	{
-		std::optional<SurfaceInteraction> si = scene.Intersect(ray);
+		std::optional<RayHit> hit = scene.TraceRay(ray);
+
+		// Account for the lights at infinity along escaped rays, up to the second vertex they are direct lighting
+		if (!hit)
+		{
+			bool	 FullWeight = bounces == 0 || specularBounce;
+			Spectrum Le			= beta * EscapedRadiance(ray, scene, prevInteraction, scatteringPdf, FullWeight);
+			L += Le;
+			if (bounces <= 1 && pAOV)
+			{
+				pAOV->Direct += Le;
+			}
+			break;
+		}
+
+		SurfaceInteraction si = scene.GetSurfaceInteraction(ray, *hit);
+		if (bounces == 0)
+		{
+			RecordFirstHit(ray, si, pAOV);
+		}
+
+		// Add emission of an area light that was hit, weighted the same way
+		if (si.AreaLight)
+		{
+			bool	 FullWeight = bounces == 0 || specularBounce;
+			Spectrum Le			= beta * EmittedRadiance(ray, si, scene, prevInteraction, scatteringPdf, FullWeight);
+			L += Le;
+			if (bounces <= 1 && pAOV)
+			{
+				pAOV->Direct += Le;
+			}
+		}
 
-		if (!si || bounces >= MaxDepth)
+		// Shape lights have no material, nothing scatters off them
+		if (bounces >= MaxDepth || !si.BSDF)
 		{
 			break;
 		}
 
 		// Sample illumination from lights to find path contribution.
 		// (But skip this for perfectly specular BSDFs.)
-		if (si->BSDF.IsNonSpecular())
+		if (si.BSDF.IsNonSpecular())
 		{
-			L += beta * UniformSampleOneLight(*si, scene, sampler, false);
+			ShadowRays.SetFirstHit(bounces == 0);
+			SampleOneLight(si, scene, sampler, beta, ShadowRays);
 		}
 
 		// Sample BSDF to get new path direction
 		Vector3f wo = -ray.Direction;
-		std::optional<BSDFSample> bsdfSample = si->BSDF.Samplef(wo, sampler.Get2D());
+		std::optional<BSDFSample> bsdfSample = si.BSDF.Samplef(wo, sampler.Get2D());
 
 		if (!bsdfSample)
 		{
 			break;
 		}
 
-		beta *= bsdfSample->f * absdot(bsdfSample->wi, si->ShadingFrame.n) / bsdfSample->pdf;
+		beta *= bsdfSample->f * absdot(bsdfSample->wi, si.ShadingFrame.n) / bsdfSample->pdf;
+		specularBounce	= IsSpecular(bsdfSample->flags);
+		scatteringPdf	= bsdfSample->pdf;
+		prevInteraction = si;
 
-		ray = si->SpawnRay(bsdfSample->wi);
+		ray = si.SpawnRay(bsdfSample->wi);
 
 		// Possibly terminate the path with Russian roulette.
 		Spectrum rrBeta = beta;
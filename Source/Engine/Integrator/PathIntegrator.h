@@ -10,9 +10,15 @@ public:
 	{
 	}
 
-	Spectrum Li(RayDesc ray, const Scene& scene, Sampler& sampler) override;
+	Spectrum Li(
+		RayDesc			ray,
+		const Scene&	scene,
+		Sampler&		sampler,
+		MemoryArena&	Arena,
+		ShadowRayQueue& ShadowRays,
+		AOVSample*		pAOV) override;
 
-private:
+protected:
 	int	  MaxDepth;
 	float rrThreshold;
 };
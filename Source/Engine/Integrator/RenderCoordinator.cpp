@@ -0,0 +1,198 @@
+#include "RenderCoordinator.h"
+#include "RenderProtocol.h"
+#include "Integrator.h"
+#include "../Film.h"
+
+#include <algorithm>
+#include <cstdio>
+
+// A worker sends its Hello right after connecting, a connection that stays silent is not a worker
+static constexpr int HelloTimeoutMs = 10000;
+
+RenderCoordinator::RenderCoordinator(
+	unsigned short				 Port,
+	const RenderProtocol::Hello& ExpectedHello,
+	float						 WorkerTimeout)
+	: ExpectedHello(ExpectedHello)
+	, WorkerTimeoutMs(std::max(1, int(WorkerTimeout * 1000.0f)))
+	, Listener(Socket::Listen(Port))
+{
+	if (Listener)
+	{
+		AcceptThread = std::thread(
+			[this]()
+			{
+				AcceptConnections();
+			});
+	}
+}
+
+RenderCoordinator::~RenderCoordinator()
+{
+	{
+		std::scoped_lock _(Mutex);
+		Shutdown = true;
+	}
+	WorkAvailable.notify_all();
+
+	if (AcceptThread.joinable())
+	{
+		AcceptThread.join();
+	}
+	// The accept thread is gone, ConnectionThreads is no longer modified
+	for (auto& Thread : ConnectionThreads)
+	{
+		Thread.join();
+	}
+}
+
+void RenderCoordinator::RenderPass(
+	TileManager&						  TileManager,
+	int									  SampleBegin,
+	int									  SampleEnd,
+	Film&								  Film,
+	std::chrono::steady_clock::time_point Deadline,
+	const std::function<void()>&		  OnTileDone)
+{
+	std::unique_lock Lock(Mutex);
+	this->SampleBegin = SampleBegin;
+	this->SampleEnd	  = SampleEnd;
+	pFilm			  = &Film;
+	pOnTileDone		  = &OnTileDone;
+
+	for (const auto& Tile : TileManager)
+	{
+		PendingTiles.push_back(&Tile);
+	}
+	NumTilesRemaining = PendingTiles.size();
+	WorkAvailable.notify_all();
+
+	auto PassDone = [this]()
+	{
+		return NumTilesRemaining == 0;
+	};
+	// Some implementations overflow waiting until time_point::max(), without a deadline the wait is plain
+	if (Deadline == std::chrono::steady_clock::time_point::max())
+	{
+		PassCompleted.wait(Lock, PassDone);
+	}
+	else if (!PassCompleted.wait_until(Lock, Deadline, PassDone))
+	{
+		// Out of time, only the tiles in flight are waited for
+		NumTilesRemaining -= PendingTiles.size();
+		PendingTiles.clear();
+		PassCompleted.wait(Lock, PassDone);
+	}
+	pFilm		= nullptr;
+	pOnTileDone = nullptr;
+}
+
+void RenderCoordinator::AcceptConnections()
+{
+	while (!Shutdown)
+	{
+		// Poll so the thread notices Shutdown without closing the socket under a blocked accept
+		if (!Listener.WaitReadable(100))
+		{
+			continue;
+		}
+
+		Socket Connection = Listener.Accept();
+		if (Connection)
+		{
+			ConnectionThreads.emplace_back(
+				[this, Connection = std::move(Connection)]() mutable
+				{
+					ServeWorker(std::move(Connection));
+				});
+		}
+	}
+}
+
+void RenderCoordinator::ServeWorker(Socket Connection)
+{
+	using namespace RenderProtocol;
+
+	// Receives time out so neither a silent connection nor a stalled worker holds a tile or the shutdown forever
+	Hello Hello = {};
+	if (!Connection.SetTimeout(HelloTimeoutMs) || !Connection.Receive(Hello))
+	{
+		printf("Dropped a connection that sent no hello\n");
+		return;
+	}
+	if (Hello != ExpectedHello)
+	{
+		printf("Rejected worker with another protocol, resolution, crop window, filter, AOVs or sampler settings\n");
+		return;
+	}
+	Connection.SetTimeout(WorkerTimeoutMs);
+
+	std::vector<std::byte> Payload, Buffer;
+	while (true)
+	{
+		const FilmTile* pTile = nullptr;
+		TileMessage		Request = {};
+		{
+			std::unique_lock Lock(Mutex);
+			WorkAvailable.wait(
+				Lock,
+				[this]()
+				{
+					return Shutdown || !PendingTiles.empty();
+				});
+			if (Shutdown)
+			{
+				break;
+			}
+
+			pTile = PendingTiles.front();
+			PendingTiles.pop_front();
+
+			Request.Type		= MessageType::RenderTile;
+			Request.SampleBegin = SampleBegin;
+			Request.SampleEnd	= SampleEnd;
+		}
+
+		// Only this thread touches the tile's statistics until it is reported done
+		const RECT& Rect = pTile->Rect;
+		Request.Left	 = Rect.left;
+		Request.Top		 = Rect.top;
+		Request.Right	 = Rect.right;
+		Request.Bottom	 = Rect.bottom;
+
+		Payload				= pFilm->ReadTileStatistics(Rect);
+		Request.PayloadSize = uint32_t(Payload.size());
+
+		TileMessage Result	= {};
+		bool		Success = Connection.Send(Request) && Connection.Send(Payload.data(), Payload.size()) &&
+					   Connection.Receive(Result) && Result.Type == MessageType::TileResult &&
+					   Result.PayloadSize == Request.PayloadSize && Connection.Receive(Payload.data(), Payload.size());
+		if (Success)
+		{
+			Buffer.resize(Result.BufferSize);
+			Success = Connection.Receive(Buffer.data(), Buffer.size()) && pFilm->MergeTileBuffer(Rect, Buffer) &&
+					  pFilm->WriteTileStatistics(Rect, Payload);
+		}
+		if (!Success)
+		{
+			printf("Worker disconnected or timed out, its tile is handed out again\n");
+
+			std::scoped_lock _(Mutex);
+			PendingTiles.push_front(pTile);
+			WorkAvailable.notify_one();
+			return;
+		}
+
+		(*pOnTileDone)();
+
+		std::scoped_lock _(Mutex);
+		if (--NumTilesRemaining == 0)
+		{
+			PassCompleted.notify_all();
+		}
+	}
+
+	TileMessage Goodbye = {};
+	Goodbye.Type		= MessageType::Shutdown;
+	Connection.Send(Goodbye);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../Socket.h"
+#include "RenderProtocol.h"
+
+struct FilmTile;
+class TileManager;
+class Film;
+
+/*
+ *	Coordinator side of distributed rendering. Worker processes connect to the coordinator's port,
+ *	every connection gets a thread that hands out pending tiles of the current pass and merges the
+ *	tile buffers returned by the worker into the film. Workers may connect at any time, the tile of a worker
+ *	that disconnects or times out is handed out again.
+ */
+class RenderCoordinator
+{
+public:
+	/*
+	 *	Only workers whose Hello equals ExpectedHello are served. Workers that send no data for WorkerTimeout
+	 *	seconds while a tile is out are disconnected
+	 */
+	RenderCoordinator(unsigned short Port, const RenderProtocol::Hello& ExpectedHello, float WorkerTimeout);
+	~RenderCoordinator();
+
+	RenderCoordinator(const RenderCoordinator&) = delete;
+	RenderCoordinator& operator=(const RenderCoordinator&) = delete;
+
+	// False if the coordinator failed to listen on its port
+	explicit operator bool() const noexcept { return bool(Listener); }
+
+	/*
+	 *	Renders the samples [SampleBegin, SampleEnd) of every tile on the workers, OnTileDone is called
+	 *	from the connection threads. Blocks until all tiles have been merged into Film. Tiles that have not
+	 *	been handed out by Deadline are dropped, the ones on a worker are still waited for
+	 */
+	void RenderPass(
+		TileManager&						  TileManager,
+		int									  SampleBegin,
+		int									  SampleEnd,
+		Film&								  Film,
+		std::chrono::steady_clock::time_point Deadline,
+		const std::function<void()>&		  OnTileDone);
+
+private:
+	void AcceptConnections();
+	void ServeWorker(Socket Connection);
+
+	RenderProtocol::Hello ExpectedHello;
+	int					  WorkerTimeoutMs;
+	Socket				  Listener;
+
+	std::thread				 AcceptThread;
+	std::vector<std::thread> ConnectionThreads;
+
+	// State of the current pass, guarded by Mutex
+	std::mutex					 Mutex;
+	std::condition_variable		 WorkAvailable;
+	std::condition_variable		 PassCompleted;
+	std::deque<const FilmTile*>	 PendingTiles;
+	size_t						 NumTilesRemaining = 0;
+	int							 SampleBegin	   = 0;
+	int							 SampleEnd		   = 0;
+	Film*						 pFilm			   = nullptr;
+	const std::function<void()>* pOnTileDone	   = nullptr;
+
+	std::atomic<bool> Shutdown = false;
+};
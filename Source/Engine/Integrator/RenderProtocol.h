@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+
+/*
+ *	Messages exchanged between a render coordinator and its workers over TCP.
+ *	A worker connection starts with Hello, then the coordinator sends RenderTile messages and the
+ *	worker answers each of them with a TileResult. Both carry the film's pixel statistics of the tile
+ *	(PayloadSize bytes) right after the message, TileResult is followed by the tile's filtered samples
+ *	(BufferSize bytes, the pixels of the tile padded by the filter radius). Shutdown ends the connection.
+ *	Messages are sent as raw structs, coordinator and workers must run the same build of the renderer
+ *	on machines of the same endianness and load the same scene with the same render options.
+ */
+namespace RenderProtocol
+{
+	constexpr uint32_t Magic   = 0x4452484b; // "KHRD"
+	constexpr uint32_t Version = 2;
+
+	enum class MessageType : uint32_t
+	{
+		RenderTile,
+		TileResult,
+		Shutdown
+	};
+
+	/*
+	 *	Everything that has to match for the tiles of a worker to fit into the coordinator's film, the
+	 *	coordinator drops workers whose Hello differs from its own
+	 */
+	struct Hello
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		int32_t	 Width;
+		int32_t	 Height;
+		int32_t	 Left, Top, Right, Bottom; // Pixel bounds of the film
+
+		// Reconstruction filter, see FilterDesc
+		uint32_t FilterType;
+		float	 FilterRadius;
+		float	 FilterAlpha;
+		float	 FilterB, FilterC;
+
+		uint32_t AOVFlags; // Bit i is set if the i-th member of AOVDesc is
+
+		// Sampler and adaptive sampling, see FilmCheckpointSettings
+		uint32_t SamplerType;
+		int32_t	 NumSamplesPerPixel;
+		uint32_t Seed;
+		uint32_t AdaptiveSampling;
+		int32_t	 MinSamplesPerPixel, MaxSamplesPerPixel;
+		float	 AdaptiveThreshold;
+
+		bool operator==(const Hello&) const = default;
+	};
+
+	struct TileMessage
+	{
+		MessageType Type;
+		int32_t		Left, Top, Right, Bottom;
+		int32_t		SampleBegin, SampleEnd;
+		uint32_t	PayloadSize;
+		uint32_t	BufferSize;
+	};
+} // namespace RenderProtocol
@@ -0,0 +1,59 @@
+#include "ShadowRayQueue.h"
+#include "../Scene.h"
+
+ShadowRayQueue::ShadowRayQueue(const Scene& Scene, std::span<Spectrum> Radiance, size_t Capacity /*= DefaultCapacity*/)
+	: pScene(&Scene)
+	, Radiance(Radiance)
+	, Capacity(Capacity)
+{
+	Rays.reserve(Capacity);
+	Contributions.reserve(Capacity);
+	Pixels.reserve(Capacity);
+	FirstHits.reserve(Capacity);
+}
+
+void ShadowRayQueue::Push(const RayDesc& ShadowRay, const Spectrum& Ld)
+{
+	Push(ShadowRay, Ld, CurrentPixel);
+}
+
+void ShadowRayQueue::Push(const RayDesc& ShadowRay, const Spectrum& Ld, int Pixel)
+{
+	Rays.push_back(ShadowRay);
+	Contributions.push_back(Ld);
+	Pixels.push_back(Pixel);
+	FirstHits.push_back(CurrentFirstHit);
+
+	if (Rays.size() >= Capacity)
+	{
+		Flush();
+	}
+}
+
+void ShadowRayQueue::Flush()
+{
+	if (Rays.empty())
+	{
+		return;
+	}
+
+	// Occluded rays have their tfar set to -inf
+	pScene->Occluded(Rays);
+
+	for (size_t i = 0; i < Rays.size(); ++i)
+	{
+		if (Rays[i].tfar != -std::numeric_limits<float>::infinity())
+		{
+			Radiance[Pixels[i]] += Contributions[i];
+			if (FirstHits[i] && !DirectRadiance.empty())
+			{
+				DirectRadiance[Pixels[i]] += Contributions[i];
+			}
+		}
+	}
+
+	Rays.clear();
+	Contributions.clear();
+	Pixels.clear();
+	FirstHits.clear();
+}
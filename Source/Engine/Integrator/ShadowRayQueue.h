@@ -0,0 +1,55 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <embree/rtcore_ray.h>
+#include "../Spectrum.h"
+
+struct RayDesc;
+struct Scene;
+
+/*
+ *	Per-thread queue of deferred next event estimation samples. Instead of tracing a shadow ray
+ *	as soon as a light is sampled, the unoccluded contribution is stored alongside the ray and the
+ *	visibility of all queued samples is resolved in batches through Scene::Occluded (rtcOccluded1M).
+ *	Unoccluded contributions are accumulated into Radiance[Pixel] when the queue is flushed.
+ */
+class ShadowRayQueue
+{
+public:
+	static constexpr size_t DefaultCapacity = 4096;
+
+	ShadowRayQueue(const Scene& Scene, std::span<Spectrum> Radiance, size_t Capacity = DefaultCapacity);
+
+	[[nodiscard]] bool	 empty() const noexcept { return Rays.empty(); }
+	[[nodiscard]] size_t size() const noexcept { return Rays.size(); }
+
+	// Pixel that subsequent Push calls without an explicit pixel are accumulated into
+	void SetPixel(int Pixel) noexcept { CurrentPixel = Pixel; }
+
+	/*
+	 *	Unoccluded contributions pushed while FirstHit is set, i.e. light samples taken at the first hit of a
+	 *	camera path, are also accumulated into DirectRadiance[Pixel] if it is not empty
+	 */
+	void SetDirectRadiance(std::span<Spectrum> DirectRadiance) noexcept { this->DirectRadiance = DirectRadiance; }
+	void SetFirstHit(bool FirstHit) noexcept { CurrentFirstHit = FirstHit; }
+
+	// Defers a light sample, the queue is flushed automatically once it reaches its capacity
+	void Push(const RayDesc& ShadowRay, const Spectrum& Ld);
+	void Push(const RayDesc& ShadowRay, const Spectrum& Ld, int Pixel);
+
+	// Traces all queued shadow rays and accumulates the contribution of every unoccluded sample
+	void Flush();
+
+private:
+	const Scene*		pScene;
+	std::span<Spectrum> Radiance;
+	std::span<Spectrum> DirectRadiance;
+	size_t				Capacity;
+	int					CurrentPixel	= 0;
+	bool				CurrentFirstHit = false;
+
+	std::vector<RTCRay>	  Rays;
+	std::vector<Spectrum> Contributions;
+	std::vector<int>	  Pixels;
+	std::vector<bool>	  FirstHits;
+};
@@ -2,20 +2,27 @@
 #include "../Scene.h"
 #include "../Sampler/Sampler.h"
 
-Spectrum VolPathIntegrator::Li(RayDesc ray, const Scene& scene, Sampler& sampler)
+Spectrum VolPathIntegrator::Li(
+	RayDesc			ray,
+	const Scene&	scene,
+	Sampler&		sampler,
+	MemoryArena&	Arena,
+	ShadowRayQueue& ShadowRays,
+	AOVSample*		pAOV)
 {
 	Spectrum L(0), beta(1);
 	bool	 specularBounce = false;
 
 	for (int bounces = 0;; ++bounces)
 	{
-		std::optional<SurfaceInteraction> si = scene.Intersect(ray);
+		// Only the hit record is needed until we know the path scatters at the surface
+		std::optional<RayHit> hit = scene.TraceRay(ray);
 
 		// Sample the participating medium, if present
 		MediumInteraction mi;
 		if (ray.Medium)
 		{
-			beta *= ray.Medium->Sample(ray, sampler, &mi);
+			beta *= ray.Medium->Sample(ray, sampler, Arena, &mi);
 		}
 		if (beta.IsBlack())
 		{
@@ -30,35 +37,75 @@ Spectrum VolPathIntegrator::Li(RayDesc ray, const Scene& scene, Sampler& sampler
 				break;
 			}
 
-			L += beta * UniformSampleOneLight(mi, scene, sampler, true);
+			L += beta * SampleOneLight(mi, scene, sampler, true);
 
 			Vector3f wo = -ray.Direction, wi;
 			mi.phase->Sample_p(wo, &wi, sampler.Get2D());
-			ray = mi.SpawnRay(wi);
+			ray			   = mi.SpawnRay(wi);
+			specularBounce = false;
 		}
 		else
 		{
-			// Handle scattering at point on surface for volumetric path tracer
-			if (!si || bounces >= MaxDepth)
+			/*
+			 * Emission along rays that leave the scene was already accounted for by the multiple importance
+			 * sampled direct lighting at the previous vertex, unless it couldn't be sampled there
+			 */
+			if (!hit)
+			{
+				if (bounces == 0 || specularBounce)
+				{
+					Spectrum Le = beta * EscapedRadiance(ray, scene, Interaction(), 0.0f, true);
+					L += Le;
+					if (bounces <= 1 && pAOV)
+					{
+						pAOV->Direct += Le;
+					}
+				}
+				break;
+			}
+
+			SurfaceInteraction si = scene.GetSurfaceInteraction(ray, *hit);
+
+			// Same for the emission of area lights
+			if (si.AreaLight && (bounces == 0 || specularBounce))
+			{
+				Spectrum Le = beta * EmittedRadiance(ray, si, scene, Interaction(), 0.0f, true);
+				L += Le;
+				if (bounces <= 1 && pAOV)
+				{
+					pAOV->Direct += Le;
+				}
+			}
+
+			// Handle scattering at point on surface for volumetric path tracer, shape lights have no material
+			if (bounces >= MaxDepth || !si.BSDF)
 			{
 				break;
 			}
 
 			// Sample illumination from lights to find path contribution.
-			L += beta * UniformSampleOneLight(*si, scene, sampler, true);
+			Spectrum Ld = beta * SampleOneLight(si, scene, sampler, true);
+			L += Ld;
+
+			if (bounces == 0 && pAOV)
+			{
+				RecordFirstHit(ray, si, pAOV);
+				pAOV->Direct += Ld;
+			}
 
 			// Sample BSDF to get new path direction
 			Vector3f				  wo		 = -ray.Direction;
-			std::optional<BSDFSample> bsdfSample = si->BSDF.Samplef(wo, sampler.Get2D());
+			std::optional<BSDFSample> bsdfSample = si.BSDF.Samplef(wo, sampler.Get2D());
 
 			if (!bsdfSample)
 			{
 				break;
 			}
 
-			beta *= bsdfSample->f * absdot(bsdfSample->wi, si->ShadingFrame.n) / bsdfSample->pdf;
+			beta *= bsdfSample->f * absdot(bsdfSample->wi, si.ShadingFrame.n) / bsdfSample->pdf;
+			specularBounce = IsSpecular(bsdfSample->flags);
 
-			ray = si->SpawnRay(bsdfSample->wi);
+			ray = si.SpawnRay(bsdfSample->wi);
 		}
 
 		// Possibly terminate the path with Russian roulette.
@@ -10,7 +10,14 @@ public:
 	{
 	}
 
-	Spectrum Li(RayDesc ray, const Scene& scene, Sampler& sampler) override;
+	// Transmittance along shadow rays needs the medium, so nothing is deferred to ShadowRays
+	Spectrum Li(
+		RayDesc			ray,
+		const Scene&	scene,
+		Sampler&		sampler,
+		MemoryArena&	Arena,
+		ShadowRayQueue& ShadowRays,
+		AOVSample*		pAOV) override;
 
 private:
 	int	  MaxDepth;
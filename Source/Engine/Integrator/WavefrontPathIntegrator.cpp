@@ -0,0 +1,208 @@
+#include "WavefrontPathIntegrator.h"
+#include "../Film.h"
+#include "../Scene.h"
+#include "../Sampler/Sampler.h"
+#include "ShadowRayQueue.h"
+
+#include <numeric>
+
+// State of an in-flight path, the ray used to extend the path is stored at the same index in the ray arrays
+struct WavefrontPath
+{
+	Spectrum beta;
+	int		 Pixel;
+
+	// Vertex the ray was sampled from and the BSDF sample that generated it, for weighting the emission it finds
+	Interaction Prev;
+	float		ScatteringPdf  = 0.0f;
+	bool		SpecularBounce = false;
+};
+
+void WavefrontPathIntegrator::RenderTile(
+	const Scene&	Scene,
+	const Sampler&	Sampler,
+	const FilmTile& Tile,
+	int				SampleBegin,
+	int				SampleEnd,
+	Film&			Film,
+	FilmTileBuffer& TileBuffer)
+{
+	const RECT Rect		  = Tile.Rect;
+	const int  TileWidth  = Rect.right - Rect.left;
+	const int  TileHeight = Rect.bottom - Rect.top;
+	const int  NumPixels  = TileWidth * TileHeight;
+
+	// Every pixel gets its own sampler since paths of different pixels are advanced in lockstep
+	std::vector<decltype(Sampler.Clone())> Samplers(NumPixels);
+	std::vector<Spectrum>				   L(NumPixels, Spectrum(0.0f));
+	std::vector<Vector2f>				   FilmPositions(NumPixels);
+	for (int i = 0; i < NumPixels; ++i)
+	{
+		Samplers[i] = Sampler.Clone();
+	}
+
+	// Pixels (indices local to the tile) that still take samples
+	std::vector<int> ActivePixels(NumPixels);
+	std::iota(ActivePixels.begin(), ActivePixels.end(), 0);
+	RetireConvergedPixels(Film, Tile, SampleBegin, ActivePixels);
+
+	// Path pool, paths that survive a bounce are compacted into the Next* arrays
+	std::vector<WavefrontPath> Paths(NumPixels), NextPaths(NumPixels);
+	std::vector<RayDesc>	   Rays(NumPixels), NextRays(NumPixels);
+	std::vector<RTCRayHit>	   RayHits(NumPixels);
+
+	// Shadow rays generated while shading a bounce, every path emits at most one light sample per bounce
+	ShadowRayQueue ShadowRays(Scene, L, NumPixels);
+
+	// First hits and direct lighting of the current sample, only kept if the film has sampled AOVs
+	const bool			   RecordAOVs = Film.GetAOVs().NeedsSamples();
+	std::vector<AOVSample> AOVs(RecordAOVs ? NumPixels : 0);
+	std::vector<Spectrum>  DirectL(RecordAOVs ? NumPixels : 0, Spectrum(0.0f));
+	ShadowRays.SetDirectRadiance(DirectL);
+
+	for (int SampleIndex = SampleBegin; SampleIndex < SampleEnd && !ActivePixels.empty() && !DeadlinePassed();
+		 ++SampleIndex)
+	{
+		// Generate camera rays for every unconverged pixel of the tile
+		int NumActivePaths = 0;
+		for (int Pixel : ActivePixels)
+		{
+			int x = Rect.left + Pixel % TileWidth;
+			int y = Rect.top + Pixel / TileWidth;
+
+			L[Pixel] = Spectrum(0.0f);
+			if (RecordAOVs)
+			{
+				AOVs[Pixel]	   = {};
+				DirectL[Pixel] = Spectrum(0.0f);
+			}
+			Samplers[Pixel]->StartPixelSample(x, y, SampleIndex);
+
+			Vector2f sampleJitter = Samplers[Pixel]->Get2D();
+			FilmPositions[Pixel]  = Vector2f(float(x) + sampleJitter.x, float(y) + sampleJitter.y);
+
+			Rays[NumActivePaths]  = GenerateCameraRay(Scene, x, y, sampleJitter);
+			Paths[NumActivePaths] = { Spectrum(1.0f), Pixel, Interaction() };
+			NumActivePaths++;
+		}
+
+		for (int bounces = 0; NumActivePaths > 0; ++bounces)
+		{
+			// Extend: find the closest hit for every live path, camera rays are coherent
+			for (int i = 0; i < NumActivePaths; ++i)
+			{
+				RayHits[i] = Rays[i];
+			}
+			Scene.Intersect(std::span(RayHits.data(), NumActivePaths), bounces == 0);
+
+			// Shade: sample lights and BSDFs, surviving paths are compacted for the next bounce
+			int NumNextPaths = 0;
+			for (int i = 0; i < NumActivePaths; ++i)
+			{
+				WavefrontPath& Path			= Paths[i];
+				auto&		   PixelSampler = *Samplers[Path.Pixel];
+
+				// Account for the lights at infinity along escaped rays, same as PathIntegrator::Li
+				if (RayHits[i].hit.geomID == RTC_INVALID_GEOMETRY_ID)
+				{
+					bool	 FullWeight = bounces == 0 || Path.SpecularBounce;
+					Spectrum Le =
+						Path.beta * EscapedRadiance(Rays[i], Scene, Path.Prev, Path.ScatteringPdf, FullWeight);
+					L[Path.Pixel] += Le;
+					if (bounces <= 1 && RecordAOVs)
+					{
+						DirectL[Path.Pixel] += Le;
+					}
+					continue;
+				}
+
+				SurfaceInteraction si = Scene.GetSurfaceInteraction(Rays[i], RayHit(RayHits[i]));
+				if (bounces == 0 && RecordAOVs)
+				{
+					RecordFirstHit(Rays[i], si, &AOVs[Path.Pixel]);
+				}
+
+				// Add emission of an area light that was hit, weighted the same way
+				if (si.AreaLight)
+				{
+					bool	 FullWeight = bounces == 0 || Path.SpecularBounce;
+					Spectrum Le =
+						Path.beta * EmittedRadiance(Rays[i], si, Scene, Path.Prev, Path.ScatteringPdf, FullWeight);
+					L[Path.Pixel] += Le;
+					if (bounces <= 1 && RecordAOVs)
+					{
+						DirectL[Path.Pixel] += Le;
+					}
+				}
+
+				// Shape lights have no material, nothing scatters off them
+				if (bounces >= MaxDepth || !si.BSDF)
+				{
+					continue;
+				}
+
+				// Sample illumination from lights to find path contribution.
+				// (But skip this for perfectly specular BSDFs.)
+				if (si.BSDF.IsNonSpecular())
+				{
+					ShadowRays.SetPixel(Path.Pixel);
+					ShadowRays.SetFirstHit(bounces == 0);
+					SampleOneLight(si, Scene, PixelSampler, Path.beta, ShadowRays);
+				}
+
+				// Sample BSDF to get new path direction
+				Vector3f				  wo		 = -Rays[i].Direction;
+				std::optional<BSDFSample> bsdfSample = si.BSDF.Samplef(wo, PixelSampler.Get2D());
+				if (!bsdfSample)
+				{
+					continue;
+				}
+
+				Spectrum beta = Path.beta * bsdfSample->f * absdot(bsdfSample->wi, si.ShadingFrame.n) / bsdfSample->pdf;
+
+				// Possibly terminate the path with Russian roulette.
+				float rrMaxComponentValue = beta.MaxComponentValue();
+				if (rrMaxComponentValue < rrThreshold && bounces > 3)
+				{
+					float q = std::max(0.05f, 1.0f - rrMaxComponentValue);
+					if (PixelSampler.Get1D() < q)
+					{
+						continue;
+					}
+					beta /= 1.0f - q;
+				}
+
+				NextPaths[NumNextPaths] = { beta, Path.Pixel, si, bsdfSample->pdf, IsSpecular(bsdfSample->flags) };
+				NextRays[NumNextPaths]	= si.SpawnRay(bsdfSample->wi);
+				NumNextPaths++;
+			}
+
+			// Shadow: resolve the visibility of all light samples of this bounce in one stream
+			ShadowRays.Flush();
+
+			std::swap(Paths, NextPaths);
+			std::swap(Rays, NextRays);
+			NumActivePaths = NumNextPaths;
+		}
+
+		for (int Pixel : ActivePixels)
+		{
+			const int x = Rect.left + Pixel % TileWidth;
+			const int y = Rect.top + Pixel / TileWidth;
+			Film.AddSampleStatistics(x, y, L[Pixel]);
+			if (RecordAOVs)
+			{
+				AOVs[Pixel].Direct = DirectL[Pixel];
+				Film.AddAOVSample(x, y, AOVs[Pixel], L[Pixel]);
+			}
+			TileBuffer.AddSample(FilmPositions[Pixel], L[Pixel]);
+		}
+
+		RetireConvergedPixels(Film, Tile, SampleIndex + 1, ActivePixels);
+	}
+}
+
+std::unique_ptr<WavefrontPathIntegrator> CreateWavefrontPathIntegrator(int MaxDepth)
+{
+	return std::make_unique<WavefrontPathIntegrator>(MaxDepth);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "PathIntegrator.h"
+
+/*
+ *	Wavefront variant of the path integrator, instead of tracing one path at a time through Li
+ *	it keeps a pool of in-flight paths for the whole tile and advances all of them in stages
+ *	(extend, shade, shadow) so that every stage can hand a large batch of rays to embree's
+ *	stream kernels (rtcIntersect1M/rtcOccluded1M).
+ *	Participating media are not handled, same as PathIntegrator.
+ */
+class WavefrontPathIntegrator : public PathIntegrator
+{
+public:
+	WavefrontPathIntegrator(int MaxDepth, float rrThreshold = 1.0f)
+		: PathIntegrator(MaxDepth, rrThreshold)
+	{
+	}
+
+protected:
+	void RenderTile(
+		const Scene&	Scene,
+		const Sampler&	Sampler,
+		const FilmTile& Tile,
+		int				SampleBegin,
+		int				SampleEnd,
+		Film&			Film,
+		FilmTileBuffer& TileBuffer) override;
+};
+
+std::unique_ptr<WavefrontPathIntegrator> CreateWavefrontPathIntegrator(int MaxDepth);
@@ -1,4 +1,5 @@
 ﻿#include "Interaction.h"
+#include "Light/Light.h"
 
 constexpr float ShadowEpsilon = 0.0001f;
 
@@ -15,3 +16,8 @@ RayDesc Interaction::SpawnRayTo(const Interaction& Interaction) const
 
 	return RayDesc(p, 0.0001f, d, tmax - ShadowEpsilon, GetMedium(d));
 }
+
+Spectrum SurfaceInteraction::Le(const Vector3f& w) const
+{
+	return AreaLight ? AreaLight->L(*this, w) : Spectrum(0.0f);
+}
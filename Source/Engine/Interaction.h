@@ -1,6 +1,8 @@
 ﻿#pragma once
 #include "AccelerationStructure.h"
 
+struct Light;
+
 enum class InteractionType
 {
 	Surface,
@@ -40,28 +42,30 @@ struct SurfaceInteraction : Interaction
 {
 	using Interaction::Interaction;
 
-	RAYTRACING_INSTANCE_DESC Instance;
-	Vector2f				 uv; // Texture coord
-	Frame					 GeometryFrame;
-	Frame					 ShadingFrame;
-	BSDF					 BSDF;
+	unsigned int InstanceID	 = RTC_INVALID_GEOMETRY_ID;
+	unsigned int GeometryID	 = RTC_INVALID_GEOMETRY_ID;
+	unsigned int PrimitiveID = RTC_INVALID_GEOMETRY_ID;
+	Vector2f	 uv; // Texture coord
+	Frame		 GeometryFrame;
+	Frame		 ShadingFrame;
+	BSDF		 BSDF;
+	const Light* AreaLight = nullptr; // Set if the hit triangle is emissive
+
+	// Radiance emitted from the hit point in direction w
+	Spectrum Le(const Vector3f& w) const;
 };
 
 struct MediumInteraction : Interaction
 {
 	MediumInteraction() noexcept = default;
-	MediumInteraction(
-		const Vector3f&					  p,
-		const Vector3f&					  wo,
-		const IMedium*					  medium,
-		std::unique_ptr<IPhaseFunction>&& phase)
+	MediumInteraction(const Vector3f& p, const Vector3f& wo, const IMedium* medium, const IPhaseFunction* phase)
 		: Interaction(p, wo, Vector3f(0.0f), medium)
-		, phase(std::move(phase))
+		, phase(phase)
 	{
 		Type = InteractionType::Medium;
 	}
 
-	[[nodiscard]] bool IsValid() const noexcept { return static_cast<bool>(phase); }
+	[[nodiscard]] bool IsValid() const noexcept { return phase != nullptr; }
 
-	std::unique_ptr<IPhaseFunction> phase;
+	const IPhaseFunction* phase = nullptr; // Allocated from the render thread's MemoryArena
 };
@@ -1,11 +1,60 @@
 #include "Light.h"
 #include "../Scene.h"
+#include "../Sampling.h"
+#include "../ImageIO.h"
+#include "../Texture2D.h"
 
-Spectrum Light::Le(const RayDesc& Ray)
+Spectrum Light::Le(const RayDesc& Ray) const
 {
 	return Spectrum(0);
 }
 
+Spectrum Light::SampleLe(
+	const Vector2f& Xi0,
+	const Vector2f& Xi1,
+	RayDesc*		pRay,
+	Vector3f*		pNormal,
+	float*			pPdfPos,
+	float*			pPdfDir) const
+{
+	*pPdfPos = *pPdfDir = 0.0f;
+	return Spectrum(0.0f);
+}
+
+void Light::PdfLe(const RayDesc& Ray, const Vector3f& n, float* pPdfPos, float* pPdfDir) const
+{
+	*pPdfPos = *pPdfDir = 0.0f;
+}
+
+float Light::Phi() const
+{
+	std::optional<LightBounds> EmissionBounds = Bounds();
+	return EmissionBounds ? EmissionBounds->Phi : 0.0f;
+}
+
+// Diffuse area lights emit a cosine weighted distribution of directions around their normal n
+static Vector3f SampleCosineDirection(const Vector3f& n, const Vector2f& Xi, float* pPdf)
+{
+	Vector3f w = SampleCosineHemisphere(Xi);
+	*pPdf	   = CosineHemispherePdf(w.z);
+	return Frame(n).ToWorld(w);
+}
+
+static float CosineDirectionPdf(const Vector3f& n, const Vector3f& w)
+{
+	float CosTheta = dot(n, w);
+	return CosTheta > 0.0f ? CosineHemispherePdf(CosTheta) : 0.0f;
+}
+
+// Ray arriving from the direction wi at infinity, it starts on the disk of the scene's bounding sphere facing wi
+static RayDesc InfiniteLightRay(const Vector3f& wi, const Vector2f& Xi, const Vector3f& SceneCenter, float SceneRadius)
+{
+	Frame	 DiskFrame(wi);
+	Vector2f pd		= SampleConcentricDisk(Xi);
+	Vector3f Origin = SceneCenter + (wi + DiskFrame.s * pd.x + DiskFrame.t * pd.y) * SceneRadius;
+	return RayDesc(Origin, 0.0f, -wi, INFINITY);
+}
+
 Spectrum PointLight::SampleLi(
 	const Interaction& Interaction,
 	const Vector2f&	   Xi,
@@ -21,3 +70,852 @@ Spectrum PointLight::SampleLi(
 
 	return I / distancesquared(P, Interaction.p);
 }
+
+Spectrum PointLight::SampleLe(
+	const Vector2f& Xi0,
+	const Vector2f& Xi1,
+	RayDesc*		pRay,
+	Vector3f*		pNormal,
+	float*			pPdfPos,
+	float*			pPdfDir) const
+{
+	// A cone with 1 - cos theta max = 2 is the whole sphere
+	Vector3f P(Transform.Position.x, Transform.Position.y, Transform.Position.z);
+	Vector3f w = SampleUniformCone(Xi0, 2.0f);
+	*pRay	   = RayDesc(P, 0.0f, w, INFINITY);
+	*pNormal   = w;
+	*pPdfPos   = 1.0f;
+	*pPdfDir   = UniformConePdf(2.0f);
+	return I;
+}
+
+void PointLight::PdfLe(const RayDesc& Ray, const Vector3f& n, float* pPdfPos, float* pPdfDir) const
+{
+	*pPdfPos = 0.0f;
+	*pPdfDir = UniformConePdf(2.0f);
+}
+
+std::optional<LightBounds> PointLight::Bounds() const
+{
+	// Emits in all directions
+	LightBounds Bounds;
+	Bounds.Bounds	  = BoundingBox(Vector3f(Transform.Position.x, Transform.Position.y, Transform.Position.z));
+	Bounds.w		  = Vector3f(0.0f, 0.0f, 1.0f);
+	Bounds.Phi		  = 4.0f * g_PI * I.MaxComponentValue();
+	Bounds.CosTheta_o = -1.0f;
+	Bounds.CosTheta_e = 0.0f;
+	return Bounds;
+}
+
+SpotLight::SpotLight(const Spectrum& I, float TotalWidth, float FalloffStart)
+	: I(I)
+	, CosFalloffStart(std::cos(FalloffStart))
+	, CosTotalWidth(std::cos(TotalWidth))
+	, Direction(0.0f, 0.0f, 1.0f)
+{
+	_Flags = Light::DeltaPosition;
+}
+
+void SpotLight::Preprocess(const BoundingBox& SceneBounds)
+{
+	Direction = Transform.Forward();
+	Direction = normalize(Direction);
+}
+
+Spectrum SpotLight::SampleLi(
+	const Interaction& Interaction,
+	const Vector2f&	   Xi,
+	Vector3f*		   pWi,
+	float*			   pPdf,
+	VisibilityTester*  pVisibilityTester) const
+{
+	Vector3f P(Transform.Position.x, Transform.Position.y, Transform.Position.z);
+	*pWi				  = normalize(P - Interaction.p);
+	*pPdf				  = 1.0f;
+	pVisibilityTester->I0 = Interaction;
+	pVisibilityTester->I1 = { P, {}, {}, {} };
+
+	return I * Falloff(-*pWi) / distancesquared(P, Interaction.p);
+}
+
+Spectrum SpotLight::SampleLe(
+	const Vector2f& Xi0,
+	const Vector2f& Xi1,
+	RayDesc*		pRay,
+	Vector3f*		pNormal,
+	float*			pPdfPos,
+	float*			pPdfDir) const
+{
+	// Uniform over the cone of the total width, the falloff is left to the returned intensity
+	Vector3f P(Transform.Position.x, Transform.Position.y, Transform.Position.z);
+	Vector3f w = Frame(Direction).ToWorld(SampleUniformCone(Xi0, 1.0f - CosTotalWidth));
+	*pRay	   = RayDesc(P, 0.0f, w, INFINITY);
+	*pNormal   = w;
+	*pPdfPos   = 1.0f;
+	*pPdfDir   = UniformConePdf(1.0f - CosTotalWidth);
+	return I * Falloff(w);
+}
+
+void SpotLight::PdfLe(const RayDesc& Ray, const Vector3f& n, float* pPdfPos, float* pPdfDir) const
+{
+	*pPdfPos = 0.0f;
+	*pPdfDir = dot(Ray.Direction, Direction) >= CosTotalWidth ? UniformConePdf(1.0f - CosTotalWidth) : 0.0f;
+}
+
+std::optional<LightBounds> SpotLight::Bounds() const
+{
+	/*
+	 * Power of a point light with the same intensity like pbrt-v4, the importance of the bounds only falls off
+	 * outside the cones so they must not scale it down a second time
+	 */
+	LightBounds Bounds;
+	Bounds.Bounds	  = BoundingBox(Vector3f(Transform.Position.x, Transform.Position.y, Transform.Position.z));
+	Bounds.w		  = Direction;
+	Bounds.Phi		  = 4.0f * g_PI * I.MaxComponentValue();
+	Bounds.CosTheta_o = CosFalloffStart;
+	Bounds.CosTheta_e = std::cos(std::acos(CosTotalWidth) - std::acos(CosFalloffStart));
+	return Bounds;
+}
+
+float SpotLight::Phi() const
+{
+	// The full intensity cone plus the falloff band, the smoothstep averages 1/2 over it
+	return I.MaxComponentValue() * g_2PI * ((1.0f - CosFalloffStart) + (CosFalloffStart - CosTotalWidth) / 2.0f);
+}
+
+float SpotLight::Falloff(const Vector3f& w) const
+{
+	float CosTheta = dot(w, Direction);
+	if (CosTheta >= CosFalloffStart)
+	{
+		return 1.0f;
+	}
+	if (CosTheta <= CosTotalWidth)
+	{
+		return 0.0f;
+	}
+
+	// Smoothstep between the edges of the falloff band
+	float t = (CosTheta - CosTotalWidth) / (CosFalloffStart - CosTotalWidth);
+	return t * t * (3.0f - 2.0f * t);
+}
+
+DistantLight::DistantLight(const Spectrum& E, float AngularRadius /*= 0.0f*/)
+	: E(E)
+	, wLight(0.0f, 0.0f, -1.0f)
+{
+	// 1 - cos theta = 2 sin^2(theta / 2) doesn't lose the precision of small angles
+	float SinHalfRadius = std::sin(AngularRadius / 2.0f);
+	OneMinusCosRadius	= 2.0f * SinHalfRadius * SinHalfRadius;
+
+	// Radiance of the disk that gives the irradiance E, the cosine weighted solid angle of the cone is pi sin^2
+	if (OneMinusCosRadius > 0.0f)
+	{
+		_Flags = Light::Infinite;
+		Lemit  = E / (g_PI * OneMinusCosRadius * (2.0f - OneMinusCosRadius));
+	}
+	else
+	{
+		_Flags = Light::DeltaDirection;
+		Lemit  = Spectrum(0.0f);
+	}
+}
+
+void DistantLight::Preprocess(const BoundingBox& SceneBounds)
+{
+	wLight	  = Transform.Forward();
+	wLight	  = -normalize(wLight);
+	ConeFrame = Frame(wLight);
+	SceneBounds.BoundingSphere(&SceneCenter, &SceneRadius);
+}
+
+Spectrum DistantLight::Le(const RayDesc& Ray) const
+{
+	return IsDeltaLight() || !InCone(normalize(Ray.Direction)) ? Spectrum(0.0f) : Lemit;
+}
+
+Spectrum DistantLight::SampleLi(
+	const Interaction& Interaction,
+	const Vector2f&	   Xi,
+	Vector3f*		   pWi,
+	float*			   pPdf,
+	VisibilityTester*  pVisibilityTester) const
+{
+	Spectrum Li;
+	if (IsDeltaLight())
+	{
+		*pWi  = wLight;
+		*pPdf = 1.0f;
+		Li	  = E;
+	}
+	else
+	{
+		*pWi  = ConeFrame.ToWorld(SampleUniformCone(Xi, OneMinusCosRadius));
+		*pPdf = UniformConePdf(OneMinusCosRadius);
+		Li	  = Lemit;
+	}
+
+	// Any point outside the scene's bounding sphere is at infinity as far as occlusion is concerned
+	pVisibilityTester->I0 = Interaction;
+	pVisibilityTester->I1 = { Interaction.p + *pWi * (2.0f * SceneRadius), {}, {}, {} };
+	return Li;
+}
+
+float DistantLight::PdfLi(const Interaction& Interaction, const Vector3f& wi) const
+{
+	return IsDeltaLight() || !InCone(wi) ? 0.0f : UniformConePdf(OneMinusCosRadius);
+}
+
+Spectrum DistantLight::SampleLe(
+	const Vector2f& Xi0,
+	const Vector2f& Xi1,
+	RayDesc*		pRay,
+	Vector3f*		pNormal,
+	float*			pPdfPos,
+	float*			pPdfDir) const
+{
+	// The direction is sampled the same way as for a receiver, for the delta light its density is 1
+	Interaction		 Center(SceneCenter, {}, {}, {});
+	VisibilityTester VisibilityTester;
+	Vector3f		 wi;
+	Spectrum		 Le = SampleLi(Center, Xi0, &wi, pPdfDir, &VisibilityTester);
+
+	*pRay	 = InfiniteLightRay(wi, Xi1, SceneCenter, SceneRadius);
+	*pNormal = pRay->Direction;
+	*pPdfPos = 1.0f / (g_PI * SceneRadius * SceneRadius);
+	return Le;
+}
+
+void DistantLight::PdfLe(const RayDesc& Ray, const Vector3f& n, float* pPdfPos, float* pPdfDir) const
+{
+	*pPdfPos = 1.0f / (g_PI * SceneRadius * SceneRadius);
+	*pPdfDir = PdfLi(Interaction(), -Ray.Direction);
+}
+
+float DistantLight::Phi() const
+{
+	// The irradiance E crosses the scene's bounding disk facing the light (pbrt-v4)
+	return E.MaxComponentValue() * g_PI * SceneRadius * SceneRadius;
+}
+
+bool DistantLight::InCone(const Vector3f& w) const
+{
+	// |w - wLight|^2 = 2 (1 - cos theta), exact for the small angles cos theta can't resolve
+	return distancesquared(w, wLight) <= 2.0f * OneMinusCosRadius;
+}
+
+DiffuseAreaLight::DiffuseAreaLight(const Spectrum& Lemit, const Vector3f& p0, const Vector3f& p1, const Vector3f& p2)
+	: Lemit(Lemit)
+	, p0(p0)
+	, p1(p1)
+	, p2(p2)
+{
+	_Flags = Light::Area;
+
+	Vector3f N = cross(p1 - p0, p2 - p0);
+	Area	   = N.Length() / 2.0f;
+	n		   = Area > 0.0f ? normalize(N) : Vector3f(0.0f);
+}
+
+Spectrum DiffuseAreaLight::L(const Interaction& Interaction, const Vector3f& w) const
+{
+	return dot(Interaction.n, w) > 0.0f ? Lemit : Spectrum(0.0f);
+}
+
+Spectrum DiffuseAreaLight::SampleLi(
+	const Interaction& Interaction,
+	const Vector2f&	   Xi,
+	Vector3f*		   pWi,
+	float*			   pPdf,
+	VisibilityTester*  pVisibilityTester) const
+{
+	*pPdf = 0.0f;
+	if (Area == 0.0f)
+	{
+		return Spectrum(0.0f);
+	}
+
+	float	 pdf			  = 0.0f;
+	bool	 SampleSolidAngle = UseSolidAngleSampling(SolidAngle(Interaction.p));
+	Vector3f b				  = SampleSolidAngle ? SampleSphericalTriangle(p0, p1, p2, Interaction.p, Xi, &pdf)
+											   : SampleUniformTriangle(Xi);
+	Vector3f P				  = b.x * p0 + b.y * p1 + b.z * p2;
+
+	float distance2 = distancesquared(P, Interaction.p);
+	if (distance2 == 0.0f)
+	{
+		return Spectrum(0.0f);
+	}
+	Vector3f wi = normalize(P - Interaction.p);
+
+	// Convert the area density to solid angle
+	if (!SampleSolidAngle)
+	{
+		float cosTheta = absdot(n, wi);
+		pdf			   = cosTheta > 0.0f ? distance2 / (cosTheta * Area) : 0.0f;
+	}
+	if (pdf == 0.0f)
+	{
+		return Spectrum(0.0f);
+	}
+
+	*pWi				  = wi;
+	*pPdf				  = pdf;
+	pVisibilityTester->I0 = Interaction;
+	pVisibilityTester->I1 = { P, {}, n, {} };
+
+	return L(pVisibilityTester->I1, -wi);
+}
+
+float DiffuseAreaLight::PdfLi(const Interaction& Interaction, const Vector3f& wi) const
+{
+	float t = Intersect(Interaction.p, wi);
+	if (t == 0.0f)
+	{
+		return 0.0f;
+	}
+
+	float Omega = SolidAngle(Interaction.p);
+	if (UseSolidAngleSampling(Omega))
+	{
+		return 1.0f / Omega;
+	}
+
+	// wi is normalized so t is the distance to the light
+	float cosTheta = absdot(n, wi);
+	return cosTheta > 0.0f ? t * t / (cosTheta * Area) : 0.0f;
+}
+
+Spectrum DiffuseAreaLight::SampleLe(
+	const Vector2f& Xi0,
+	const Vector2f& Xi1,
+	RayDesc*		pRay,
+	Vector3f*		pNormal,
+	float*			pPdfPos,
+	float*			pPdfDir) const
+{
+	*pPdfPos = *pPdfDir = 0.0f;
+	if (Area == 0.0f)
+	{
+		return Spectrum(0.0f);
+	}
+
+	Vector3f b = SampleUniformTriangle(Xi0);
+	Vector3f P = b.x * p0 + b.y * p1 + b.z * p2;
+	Vector3f w = SampleCosineDirection(n, Xi1, pPdfDir);
+
+	*pRay	 = Interaction(P, {}, n, {}).SpawnRay(w);
+	*pNormal = n;
+	*pPdfPos = 1.0f / Area;
+	return Lemit;
+}
+
+void DiffuseAreaLight::PdfLe(const RayDesc& Ray, const Vector3f& n, float* pPdfPos, float* pPdfDir) const
+{
+	*pPdfPos = Area > 0.0f ? 1.0f / Area : 0.0f;
+	*pPdfDir = CosineDirectionPdf(this->n, Ray.Direction);
+}
+
+std::optional<LightBounds> DiffuseAreaLight::Bounds() const
+{
+	// Emits into the hemisphere around n
+	LightBounds Bounds;
+	Bounds.Bounds	  = Union(Union(BoundingBox(p0), p1), p2);
+	Bounds.w		  = n;
+	Bounds.Phi		  = g_PI * Area * Lemit.MaxComponentValue();
+	Bounds.CosTheta_o = 1.0f;
+	Bounds.CosTheta_e = 0.0f;
+	return Bounds;
+}
+
+float DiffuseAreaLight::SolidAngle(const Vector3f& p) const
+{
+	return SphericalTriangleArea(normalize(p0 - p), normalize(p1 - p), normalize(p2 - p));
+}
+
+bool DiffuseAreaLight::UseSolidAngleSampling(float SolidAngle)
+{
+	// Same bounds as pbrt-v4's triangle sampling
+	constexpr float MinSphericalSampleArea = 3e-4f;
+	constexpr float MaxSphericalSampleArea = 6.22f;
+	return SolidAngle >= MinSphericalSampleArea && SolidAngle <= MaxSphericalSampleArea;
+}
+
+float DiffuseAreaLight::Intersect(const Vector3f& o, const Vector3f& d) const
+{
+	// Moller-Trumbore
+	Vector3f e1 = p1 - p0, e2 = p2 - p0;
+	Vector3f s1		 = cross(d, e2);
+	float	 divisor = dot(s1, e1);
+	if (divisor == 0.0f)
+	{
+		return 0.0f;
+	}
+
+	float	 invDivisor = 1.0f / divisor;
+	Vector3f s			= o - p0;
+	float	 b1			= dot(s, s1) * invDivisor;
+	if (b1 < 0.0f || b1 > 1.0f)
+	{
+		return 0.0f;
+	}
+
+	Vector3f s2 = cross(s, e1);
+	float	 b2 = dot(d, s2) * invDivisor;
+	if (b2 < 0.0f || b1 + b2 > 1.0f)
+	{
+		return 0.0f;
+	}
+
+	float t = dot(e2, s2) * invDivisor;
+	return t > 0.0f ? t : 0.0f;
+}
+
+Spectrum ShapeLight::L(const Interaction& Interaction, const Vector3f& w) const
+{
+	return dot(Interaction.n, w) > 0.0f ? Lemit : Spectrum(0.0f);
+}
+
+SphereLight::SphereLight(const Spectrum& Lemit, float Radius)
+	: ShapeLight(Lemit)
+	, Radius(Radius)
+{
+}
+
+BoundingBox SphereLight::WorldBound() const
+{
+	const Vector3f pc = Center();
+	return Union(BoundingBox(pc - Vector3f(Radius)), pc + Vector3f(Radius));
+}
+
+float SphereLight::Intersect(const RayDesc& Ray, Vector3f* pNormal) const
+{
+	// Distance of the ray's line to the center instead of the usual discriminant, which cancels for far spheres
+	Vector3f oc = Ray.Origin - Center();
+	float	 a	= dot(Ray.Direction, Ray.Direction);
+	float	 b	= dot(oc, Ray.Direction);
+	Vector3f v	= oc - Ray.Direction * (b / a);
+	float	 l	= v.Length();
+	if (l > Radius)
+	{
+		return 0.0f;
+	}
+
+	// Rays starting inside the sphere hit it at the far root
+	float q = std::sqrt(a * (Radius - l) * (Radius + l));
+	float t = (-b - q) / a;
+	if (t <= Ray.TMin)
+	{
+		t = (-b + q) / a;
+	}
+	if (t <= Ray.TMin || t >= Ray.TMax)
+	{
+		return 0.0f;
+	}
+	*pNormal = normalize(oc + Ray.Direction * t);
+	return t;
+}
+
+Spectrum SphereLight::SampleLi(
+	const Interaction& Interaction,
+	const Vector2f&	   Xi,
+	Vector3f*		   pWi,
+	float*			   pPdf,
+	VisibilityTester*  pVisibilityTester) const
+{
+	*pPdf = 0.0f;
+
+	const Vector3f pc			= Center();
+	float		   Distance2	= distancesquared(Interaction.p, pc);
+	float		   Sin2ThetaMax = Radius * Radius / Distance2;
+	if (Sin2ThetaMax >= 1.0f)
+	{
+		return Spectrum(0.0f);
+	}
+
+	/*
+	 * Sample theta uniformly in cos theta within the cone the sphere subtends, for tiny cones sin^2 is
+	 * interpolated instead since cos theta max rounds to 1 (pbrt-v4)
+	 */
+	float SinThetaMax		  = std::sqrt(Sin2ThetaMax);
+	float CosThetaMax		  = std::sqrt(1.0f - Sin2ThetaMax);
+	float OneMinusCosThetaMax = 1.0f - CosThetaMax;
+	float CosTheta			  = (CosThetaMax - 1.0f) * Xi[0] + 1.0f;
+	float Sin2Theta			  = 1.0f - CosTheta * CosTheta;
+	if (Sin2ThetaMax < 0.00068523f)
+	{
+		Sin2Theta			= Sin2ThetaMax * Xi[0];
+		CosTheta			= std::sqrt(1.0f - Sin2Theta);
+		OneMinusCosThetaMax = Sin2ThetaMax / 2.0f;
+	}
+
+	// Angle at the center between the direction to the reference point and the point seen along the sample
+	float CosAlpha = Sin2Theta / SinThetaMax + CosTheta * std::sqrt(std::max(0.0f, 1.0f - Sin2Theta / Sin2ThetaMax));
+	float SinAlpha = std::sqrt(std::max(0.0f, 1.0f - CosAlpha * CosAlpha));
+	float Phi	   = Xi[1] * g_2PI;
+
+	Frame	 SamplingFrame(normalize(pc - Interaction.p));
+	Vector3f n = SamplingFrame.ToWorld(-Vector3f(SinAlpha * std::cos(Phi), SinAlpha * std::sin(Phi), CosAlpha));
+	Vector3f P = pc + n * Radius;
+
+	*pWi				  = normalize(P - Interaction.p);
+	*pPdf				  = UniformConePdf(OneMinusCosThetaMax);
+	pVisibilityTester->I0 = Interaction;
+	pVisibilityTester->I1 = { P, {}, n, {} };
+	return Lemit;
+}
+
+float SphereLight::PdfLi(const Interaction& Interaction, const Vector3f& wi) const
+{
+	// The cone of directions that hit the sphere, exact test through the distance of the line to the center
+	Vector3f ToCenter	  = Center() - Interaction.p;
+	float	 Distance2	  = ToCenter.LengthSquared();
+	float	 Sin2ThetaMax = Radius * Radius / Distance2;
+	if (Sin2ThetaMax >= 1.0f || dot(ToCenter, wi) <= 0.0f || cross(ToCenter, wi).LengthSquared() > Radius * Radius)
+	{
+		return 0.0f;
+	}
+
+	float OneMinusCosThetaMax =
+		Sin2ThetaMax < 0.00068523f ? Sin2ThetaMax / 2.0f : 1.0f - std::sqrt(1.0f - Sin2ThetaMax);
+	return UniformConePdf(OneMinusCosThetaMax);
+}
+
+Spectrum SphereLight::SampleLe(
+	const Vector2f& Xi0,
+	const Vector2f& Xi1,
+	RayDesc*		pRay,
+	Vector3f*		pNormal,
+	float*			pPdfPos,
+	float*			pPdfDir) const
+{
+	// Uniform over the surface, a cone with 1 - cos theta max = 2 is the whole sphere of normals
+	Vector3f n = SampleUniformCone(Xi0, 2.0f);
+	Vector3f P = Center() + n * Radius;
+	Vector3f w = SampleCosineDirection(n, Xi1, pPdfDir);
+
+	*pRay	 = Interaction(P, {}, n, {}).SpawnRay(w);
+	*pNormal = n;
+	*pPdfPos = 1.0f / (4.0f * g_PI * Radius * Radius);
+	return Lemit;
+}
+
+void SphereLight::PdfLe(const RayDesc& Ray, const Vector3f& n, float* pPdfPos, float* pPdfDir) const
+{
+	*pPdfPos = 1.0f / (4.0f * g_PI * Radius * Radius);
+	*pPdfDir = CosineDirectionPdf(n, Ray.Direction);
+}
+
+std::optional<LightBounds> SphereLight::Bounds() const
+{
+	// Emits in all directions from the whole surface
+	const Vector3f pc = Center();
+	LightBounds	   Bounds;
+	Bounds.Bounds	  = Union(BoundingBox(pc - Vector3f(Radius)), pc + Vector3f(Radius));
+	Bounds.w		  = Vector3f(0.0f, 0.0f, 1.0f);
+	Bounds.Phi		  = g_PI * 4.0f * g_PI * Radius * Radius * Lemit.MaxComponentValue();
+	Bounds.CosTheta_o = -1.0f;
+	Bounds.CosTheta_e = 0.0f;
+	return Bounds;
+}
+
+DiskLight::DiskLight(const Spectrum& Lemit, float Radius)
+	: ShapeLight(Lemit)
+	, Radius(Radius)
+	, Center(0.0f)
+	, DiskFrame(Vector3f(0.0f, 0.0f, 1.0f))
+{
+}
+
+void DiskLight::Preprocess(const BoundingBox& SceneBounds)
+{
+	Vector3f n;
+	n		  = Transform.Forward();
+	Center	  = Vector3f(Transform.Position.x, Transform.Position.y, Transform.Position.z);
+	DiskFrame = Frame(normalize(n));
+}
+
+BoundingBox DiskLight::WorldBound() const
+{
+	// The frame is only set in Preprocess, the cube around the disk holds it in any orientation
+	const Vector3f pc(Transform.Position.x, Transform.Position.y, Transform.Position.z);
+	return Union(BoundingBox(pc - Vector3f(Radius)), pc + Vector3f(Radius));
+}
+
+float DiskLight::Intersect(const RayDesc& Ray, Vector3f* pNormal) const
+{
+	float CosTheta = dot(Ray.Direction, DiskFrame.n);
+	if (CosTheta == 0.0f)
+	{
+		return 0.0f;
+	}
+
+	float t = dot(Center - Ray.Origin, DiskFrame.n) / CosTheta;
+	if (t <= Ray.TMin || t >= Ray.TMax || distancesquared(Ray.At(t), Center) > Radius * Radius)
+	{
+		return 0.0f;
+	}
+	*pNormal = DiskFrame.n;
+	return t;
+}
+
+Spectrum DiskLight::SampleLi(
+	const Interaction& Interaction,
+	const Vector2f&	   Xi,
+	Vector3f*		   pWi,
+	float*			   pPdf,
+	VisibilityTester*  pVisibilityTester) const
+{
+	*pPdf = 0.0f;
+
+	Vector2f pd = SampleConcentricDisk(Xi) * Radius;
+	Vector3f P	= Center + DiskFrame.s * pd.x + DiskFrame.t * pd.y;
+
+	float Distance2 = distancesquared(P, Interaction.p);
+	if (Distance2 == 0.0f)
+	{
+		return Spectrum(0.0f);
+	}
+	Vector3f wi = normalize(P - Interaction.p);
+
+	// Convert the area density to solid angle, points behind the disk see its back side
+	float CosLight = -dot(wi, DiskFrame.n);
+	if (CosLight <= 0.0f)
+	{
+		return Spectrum(0.0f);
+	}
+
+	*pWi				  = wi;
+	*pPdf				  = Distance2 / (CosLight * g_PI * Radius * Radius);
+	pVisibilityTester->I0 = Interaction;
+	pVisibilityTester->I1 = { P, {}, DiskFrame.n, {} };
+	return Lemit;
+}
+
+float DiskLight::PdfLi(const Interaction& Interaction, const Vector3f& wi) const
+{
+	float t = Intersect(Interaction.p, wi);
+	if (t == 0.0f)
+	{
+		return 0.0f;
+	}
+	return t * t / (-dot(wi, DiskFrame.n) * g_PI * Radius * Radius);
+}
+
+Spectrum DiskLight::SampleLe(
+	const Vector2f& Xi0,
+	const Vector2f& Xi1,
+	RayDesc*		pRay,
+	Vector3f*		pNormal,
+	float*			pPdfPos,
+	float*			pPdfDir) const
+{
+	Vector2f pd = SampleConcentricDisk(Xi0) * Radius;
+	Vector3f P	= Center + DiskFrame.s * pd.x + DiskFrame.t * pd.y;
+	Vector3f w	= SampleCosineDirection(DiskFrame.n, Xi1, pPdfDir);
+
+	*pRay	 = Interaction(P, {}, DiskFrame.n, {}).SpawnRay(w);
+	*pNormal = DiskFrame.n;
+	*pPdfPos = 1.0f / (g_PI * Radius * Radius);
+	return Lemit;
+}
+
+void DiskLight::PdfLe(const RayDesc& Ray, const Vector3f& n, float* pPdfPos, float* pPdfDir) const
+{
+	*pPdfPos = 1.0f / (g_PI * Radius * Radius);
+	*pPdfDir = CosineDirectionPdf(DiskFrame.n, Ray.Direction);
+}
+
+std::optional<LightBounds> DiskLight::Bounds() const
+{
+	// Emits into the hemisphere around n, the extent of the disk along an axis shrinks as n approaches it
+	const Vector3f& n = DiskFrame.n;
+	Vector3f		Extent(
+		   Radius * std::sqrt(std::max(0.0f, 1.0f - n.x * n.x)),
+		   Radius * std::sqrt(std::max(0.0f, 1.0f - n.y * n.y)),
+		   Radius * std::sqrt(std::max(0.0f, 1.0f - n.z * n.z)));
+
+	LightBounds Bounds;
+	Bounds.Bounds	  = Union(BoundingBox(Center - Extent), Center + Extent);
+	Bounds.w		  = n;
+	Bounds.Phi		  = g_PI * g_PI * Radius * Radius * Lemit.MaxComponentValue();
+	Bounds.CosTheta_o = 1.0f;
+	Bounds.CosTheta_e = 0.0f;
+	return Bounds;
+}
+
+float DiskLight::Intersect(const Vector3f& o, const Vector3f& d) const
+{
+	// Only the side n points to emits
+	float CosTheta = dot(d, DiskFrame.n);
+	if (CosTheta >= 0.0f)
+	{
+		return 0.0f;
+	}
+
+	float t = dot(Center - o, DiskFrame.n) / CosTheta;
+	if (t <= 0.0f || distancesquared(o + d * t, Center) > Radius * Radius)
+	{
+		return 0.0f;
+	}
+	return t;
+}
+
+ImageInfiniteLight::ImageInfiniteLight(const std::filesystem::path& Path, float Scale /*= 1.0f*/)
+	: Scale(Scale)
+	, Image(ReadImage(Path))
+{
+	_Flags = Light::Infinite;
+
+	if (!Image)
+	{
+		Image = std::make_unique<Texture2D<RGBSpectrum>>(1, 1);
+		Image->Clear(RGBSpectrum(0.0f));
+	}
+
+	// Texel rows are stored bottom first, the distribution's rows go from v = 0 at the top
+	const size_t	   Width  = Image->Width;
+	const size_t	   Height = Image->Height;
+	std::vector<float> Function(Width * Height);
+	for (size_t v = 0; v < Height; ++v)
+	{
+		const RGBSpectrum* pRow		= &Image->Pixels[(Height - 1 - v) * Width];
+		float			   SinTheta = std::sin(g_PI * (float(v) + 0.5f) / float(Height));
+		for (size_t u = 0; u < Width; ++u)
+		{
+			Function[v * Width + u] = pRow[u].y() * SinTheta;
+		}
+	}
+	Distribution = std::make_unique<Distribution2D>(Function, Width, Height);
+}
+
+ImageInfiniteLight::~ImageInfiniteLight() = default;
+
+void ImageInfiniteLight::Preprocess(const BoundingBox& SceneBounds)
+{
+	Vector3f Right, Up, Forward;
+	Right	   = Transform.Right();
+	Up		   = Transform.Up();
+	Forward	   = Transform.Forward();
+	LightFrame = Frame(Right, Up, Forward);
+	SceneBounds.BoundingSphere(&SceneCenter, &SceneRadius);
+}
+
+Spectrum ImageInfiniteLight::Le(const RayDesc& Ray) const
+{
+	Vector3f w	   = LightFrame.ToLocal(normalize(Ray.Direction));
+	float	 Theta = std::acos(std::clamp(w.y, -1.0f, 1.0f));
+	float	 Phi   = std::atan2(w.z, w.x);
+	return Lookup(Vector2f((Phi < 0.0f ? Phi + g_2PI : Phi) * g_1DIV2PI, Theta * g_1DIVPI));
+}
+
+Spectrum ImageInfiniteLight::SampleLi(
+	const Interaction& Interaction,
+	const Vector2f&	   Xi,
+	Vector3f*		   pWi,
+	float*			   pPdf,
+	VisibilityTester*  pVisibilityTester) const
+{
+	*pPdf = 0.0f;
+
+	float	 MapPdf;
+	Vector2f uv = Distribution->SampleContinuous(Xi, &MapPdf);
+	if (MapPdf == 0.0f)
+	{
+		return Spectrum(0.0f);
+	}
+
+	// Convert the density over the image to solid angle, the image spans 2 pi by pi radians
+	float Theta	   = uv.y * g_PI;
+	float Phi	   = uv.x * g_2PI;
+	float SinTheta = std::sin(Theta);
+	if (SinTheta == 0.0f)
+	{
+		return Spectrum(0.0f);
+	}
+	*pWi  = LightFrame.ToWorld(Vector3f(SinTheta * std::cos(Phi), std::cos(Theta), SinTheta * std::sin(Phi)));
+	*pPdf = MapPdf / (2.0f * g_PI * g_PI * SinTheta);
+
+	// Any point outside the scene's bounding sphere is at infinity as far as occlusion is concerned
+	pVisibilityTester->I0 = Interaction;
+	pVisibilityTester->I1 = { Interaction.p + *pWi * (2.0f * SceneRadius), {}, {}, {} };
+
+	return Lookup(uv);
+}
+
+float ImageInfiniteLight::PdfLi(const Interaction& Interaction, const Vector3f& wi) const
+{
+	Vector3f w		  = LightFrame.ToLocal(wi);
+	float	 Theta	  = std::acos(std::clamp(w.y, -1.0f, 1.0f));
+	float	 Phi	  = std::atan2(w.z, w.x);
+	float	 SinTheta = std::sin(Theta);
+	if (SinTheta == 0.0f)
+	{
+		return 0.0f;
+	}
+	Vector2f uv((Phi < 0.0f ? Phi + g_2PI : Phi) * g_1DIV2PI, Theta * g_1DIVPI);
+	return Distribution->Pdf(uv) / (2.0f * g_PI * g_PI * SinTheta);
+}
+
+Spectrum ImageInfiniteLight::SampleLe(
+	const Vector2f& Xi0,
+	const Vector2f& Xi1,
+	RayDesc*		pRay,
+	Vector3f*		pNormal,
+	float*			pPdfPos,
+	float*			pPdfDir) const
+{
+	// The direction is importance sampled the same way as for a receiver
+	Interaction		 Center(SceneCenter, {}, {}, {});
+	VisibilityTester VisibilityTester;
+	Vector3f		 wi;
+	Spectrum		 Le = SampleLi(Center, Xi0, &wi, pPdfDir, &VisibilityTester);
+	if (*pPdfDir == 0.0f)
+	{
+		*pPdfPos = 0.0f;
+		return Spectrum(0.0f);
+	}
+
+	*pRay	 = InfiniteLightRay(wi, Xi1, SceneCenter, SceneRadius);
+	*pNormal = pRay->Direction;
+	*pPdfPos = 1.0f / (g_PI * SceneRadius * SceneRadius);
+	return Le;
+}
+
+void ImageInfiniteLight::PdfLe(const RayDesc& Ray, const Vector3f& n, float* pPdfPos, float* pPdfDir) const
+{
+	*pPdfPos = 1.0f / (g_PI * SceneRadius * SceneRadius);
+	*pPdfDir = PdfLi(Interaction(), -Ray.Direction);
+}
+
+float ImageInfiniteLight::Phi() const
+{
+	// Radiance integrated over the sphere, the texels of a row span 2 pi^2 sin theta / (Width Height) steradians
+	const size_t Width	= Image->Width;
+	const size_t Height = Image->Height;
+	Spectrum	 Sum(0.0f);
+	for (size_t v = 0; v < Height; ++v)
+	{
+		float SinTheta = std::sin(g_PI * (float(v) + 0.5f) / float(Height));
+		for (size_t u = 0; u < Width; ++u)
+		{
+			Sum += Lookup(Vector2f((float(u) + 0.5f) / float(Width), (float(v) + 0.5f) / float(Height))) * SinTheta;
+		}
+	}
+	float Radiance = Sum.MaxComponentValue() * 2.0f * g_PI * g_PI / float(Width * Height);
+
+	// Crossing the scene's bounding disk from every direction (pbrt-v4)
+	return g_PI * SceneRadius * SceneRadius * Radiance;
+}
+
+Spectrum ImageInfiniteLight::Lookup(const Vector2f& uv) const
+{
+	const int Width	 = int(Image->Width);
+	const int Height = int(Image->Height);
+	int		  x		 = std::clamp(int(uv.x * float(Width)), 0, Width - 1);
+	int		  y		 = std::clamp(int(uv.y * float(Height)), 0, Height - 1);
+
+	float rgb[3];
+	Image->Pixels[size_t(Height - 1 - y) * Width + x].ToRGB(rgb);
+	return Spectrum::FromRGB(rgb, SpectrumType::Illuminant) * Scale;
+}
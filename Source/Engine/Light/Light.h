@@ -1,9 +1,18 @@
 #pragma once
 #include "Math/Math.h"
 #include "../Spectrum.h"
+#include "LightBounds.h"
+
+#include <filesystem>
+#include <memory>
+#include <optional>
 
 struct Interaction;
 struct VisibilityTester;
+class Distribution2D;
+
+template<typename T>
+struct Texture2D;
 
 struct Light
 {
@@ -17,7 +26,11 @@ struct Light
 
 	virtual ~Light() = default;
 
-	virtual Spectrum Le(const RayDesc& Ray);
+	// Called once the scene is built and before rendering, lights at infinity need the scene's extent
+	virtual void Preprocess(const BoundingBox& SceneBounds) {}
+
+	// Radiance arriving along a ray that left the scene, only lights at infinity emit any
+	virtual Spectrum Le(const RayDesc& Ray) const;
 
 	virtual Spectrum SampleLi(
 		const Interaction& Interaction,
@@ -26,6 +39,42 @@ struct Light
 		float*			   pPdf,
 		VisibilityTester*  pVisibilityTester) const = 0;
 
+	// Radiance an area light emits from the point Interaction on its surface in direction w
+	virtual Spectrum L(const Interaction& Interaction, const Vector3f& w) const { return Spectrum(0.0f); }
+
+	/*
+	 *	Solid angle density of SampleLi generating the direction wi from Interaction, used to weight
+	 *	directions found by other sampling strategies. Delta lights can't be found that way and return 0
+	 */
+	virtual float PdfLi(const Interaction& Interaction, const Vector3f& wi) const = 0;
+
+	/*
+	 *	Samples a ray leaving the light for paths that start at the light. pNormal is set to the surface normal at
+	 *	the origin for area lights and to the ray direction otherwise, pPdfPos to the area density of the origin
+	 *	and pPdfDir to the solid angle density of the direction. Lights at infinity start rays on the disk of the
+	 *	scene's bounding sphere that faces the direction, pPdfPos is the density over that disk.
+	 *	Lights that don't support it return 0 with zero densities
+	 */
+	virtual Spectrum SampleLe(
+		const Vector2f& Xi0,
+		const Vector2f& Xi1,
+		RayDesc*		pRay,
+		Vector3f*		pNormal,
+		float*			pPdfPos,
+		float*			pPdfDir) const;
+
+	// Densities of SampleLe generating Ray from the point with surface normal n on the light
+	virtual void PdfLe(const RayDesc& Ray, const Vector3f& n, float* pPdfPos, float* pPdfDir) const;
+
+	// Spatial and directional bounds of the emission for the light BVH, lights at infinity have none
+	virtual std::optional<LightBounds> Bounds() const { return std::nullopt; }
+
+	/*
+	 *	Total emitted power for picking lights by power, the Phi of Bounds unless that overestimates it. Lights at
+	 *	infinity deliver theirs through the scene's bounding disk, so Preprocess must have been called
+	 */
+	virtual float Phi() const;
+
 	bool IsDeltaLight() const { return _Flags & DeltaPosition || _Flags & DeltaDirection; }
 
 	Transform Transform;
@@ -47,5 +96,327 @@ struct PointLight : Light
 		float*			   pPdf,
 		VisibilityTester*  pVisibilityTester) const override;
 
+	float PdfLi(const Interaction& Interaction, const Vector3f& wi) const override { return 0.0f; }
+
+	Spectrum SampleLe(
+		const Vector2f& Xi0,
+		const Vector2f& Xi1,
+		RayDesc*		pRay,
+		Vector3f*		pNormal,
+		float*			pPdfPos,
+		float*			pPdfDir) const override;
+
+	void PdfLe(const RayDesc& Ray, const Vector3f& n, float* pPdfPos, float* pPdfDir) const override;
+
+	std::optional<LightBounds> Bounds() const override;
+
+	Spectrum I;
+};
+
+/*
+ *	Point light at Transform.Position shining along the forward axis of Transform. Intensity is I inside the
+ *	cone of half angle FalloffStart and falls off smoothly to 0 at TotalWidth, both in radians
+ */
+struct SpotLight : Light
+{
+	SpotLight(const Spectrum& I, float TotalWidth, float FalloffStart);
+
+	void Preprocess(const BoundingBox& SceneBounds) override;
+
+	Spectrum SampleLi(
+		const Interaction& Interaction,
+		const Vector2f&	   Xi,
+		Vector3f*		   pWi,
+		float*			   pPdf,
+		VisibilityTester*  pVisibilityTester) const override;
+
+	float PdfLi(const Interaction& Interaction, const Vector3f& wi) const override { return 0.0f; }
+
+	Spectrum SampleLe(
+		const Vector2f& Xi0,
+		const Vector2f& Xi1,
+		RayDesc*		pRay,
+		Vector3f*		pNormal,
+		float*			pPdfPos,
+		float*			pPdfDir) const override;
+
+	void PdfLe(const RayDesc& Ray, const Vector3f& n, float* pPdfPos, float* pPdfDir) const override;
+
+	// The bounds carry the power of a point light, the light BVH bounds the cone with their directions
+	std::optional<LightBounds> Bounds() const override;
+
+	float Phi() const override;
+
 	Spectrum I;
+	float	 CosFalloffStart;
+	float	 CosTotalWidth;
+
+private:
+	// Fraction of I emitted in the world space direction w
+	float Falloff(const Vector3f& w) const;
+
+	Vector3f Direction; // Forward axis of Transform, set in Preprocess
+};
+
+/*
+ *	Light at infinity arriving along the forward axis of Transform, like the sun. E is the irradiance on a
+ *	surface facing the light. With an AngularRadius (radians) above 0 the light is a disk of constant radiance
+ *	seen by rays that leave the scene, which is sampled uniformly over its cone of directions and casts soft
+ *	shadows. Otherwise it is a delta light from a single direction
+ */
+struct DistantLight : Light
+{
+	DistantLight(const Spectrum& E, float AngularRadius = 0.0f);
+
+	void Preprocess(const BoundingBox& SceneBounds) override;
+
+	Spectrum Le(const RayDesc& Ray) const override;
+
+	Spectrum SampleLi(
+		const Interaction& Interaction,
+		const Vector2f&	   Xi,
+		Vector3f*		   pWi,
+		float*			   pPdf,
+		VisibilityTester*  pVisibilityTester) const override;
+
+	float PdfLi(const Interaction& Interaction, const Vector3f& wi) const override;
+
+	Spectrum SampleLe(
+		const Vector2f& Xi0,
+		const Vector2f& Xi1,
+		RayDesc*		pRay,
+		Vector3f*		pNormal,
+		float*			pPdfPos,
+		float*			pPdfDir) const override;
+
+	void PdfLe(const RayDesc& Ray, const Vector3f& n, float* pPdfPos, float* pPdfDir) const override;
+
+	float Phi() const override;
+
+	Spectrum E;
+
+private:
+	// Whether the world space direction w points into the disk
+	bool InCone(const Vector3f& w) const;
+
+	float	 OneMinusCosRadius;
+	Spectrum Lemit;
+	// Direction towards the light and its frame, set in Preprocess
+	Vector3f wLight;
+	Frame	 ConeFrame;
+	Vector3f SceneCenter;
+	float	 SceneRadius = 0.0f;
+};
+
+/*
+ *	Area light of a single world space triangle of an emissive mesh, emits Lemit from the side its geometric
+ *	normal points to. Directions are sampled uniformly in the solid angle the triangle subtends, which keeps the
+ *	variance low for nearby emitters. Triangles that subtend a very small or very large solid angle, where the
+ *	spherical triangle math loses precision, are sampled uniformly by area instead
+ */
+struct DiffuseAreaLight : Light
+{
+	DiffuseAreaLight(const Spectrum& Lemit, const Vector3f& p0, const Vector3f& p1, const Vector3f& p2);
+
+	Spectrum L(const Interaction& Interaction, const Vector3f& w) const override;
+
+	Spectrum SampleLi(
+		const Interaction& Interaction,
+		const Vector2f&	   Xi,
+		Vector3f*		   pWi,
+		float*			   pPdf,
+		VisibilityTester*  pVisibilityTester) const override;
+
+	float PdfLi(const Interaction& Interaction, const Vector3f& wi) const override;
+
+	Spectrum SampleLe(
+		const Vector2f& Xi0,
+		const Vector2f& Xi1,
+		RayDesc*		pRay,
+		Vector3f*		pNormal,
+		float*			pPdfPos,
+		float*			pPdfDir) const override;
+
+	void PdfLe(const RayDesc& Ray, const Vector3f& n, float* pPdfPos, float* pPdfDir) const override;
+
+	std::optional<LightBounds> Bounds() const override;
+
+	Spectrum Lemit;
+	Vector3f p0, p1, p2;
+	Vector3f n; // Geometric normal, same orientation as the one computed for hits on the mesh
+	float	 Area;
+
+private:
+	// Solid angle the triangle subtends from p and whether it is sampled by solid angle rather than by area
+	float SolidAngle(const Vector3f& p) const;
+	static bool UseSolidAngleSampling(float SolidAngle);
+
+	// Distance along the ray (o, d) to the triangle, 0 if the ray misses it
+	float Intersect(const Vector3f& o, const Vector3f& d) const;
+};
+
+/*
+ *	Area light with an analytic surface centered at Transform.Position that emits Lemit from its outer side.
+ *	Scene::Generate adds the surface to the scene as a user geometry without a material, so it blocks rays
+ *	and hits on it end paths with the light as their area light
+ */
+struct ShapeLight : Light
+{
+	ShapeLight(const Spectrum& Lemit)
+		: Lemit(Lemit)
+	{
+		_Flags = Light::Area;
+	}
+
+	Spectrum L(const Interaction& Interaction, const Vector3f& w) const override;
+
+	// World space box around the surface, used to build the scene before Preprocess is called
+	virtual BoundingBox WorldBound() const = 0;
+
+	/*
+	 *	Distance along Ray to the closest point of the surface, from either side, between Ray.TMin and Ray.TMax,
+	 *	0 if there is none. pNormal is set to the normal of the emitting side at the hit
+	 */
+	virtual float Intersect(const RayDesc& Ray, Vector3f* pNormal) const = 0;
+
+	Spectrum Lemit;
+};
+
+/*
+ *	Sphere light sampled uniformly over the cone of directions it subtends, which is exact for any distance
+ *	and converges much faster than sampling its area. Points inside the sphere see its back side and receive
+ *	no light
+ */
+struct SphereLight : ShapeLight
+{
+	SphereLight(const Spectrum& Lemit, float Radius);
+
+	BoundingBox WorldBound() const override;
+
+	float Intersect(const RayDesc& Ray, Vector3f* pNormal) const override;
+
+	Spectrum SampleLi(
+		const Interaction& Interaction,
+		const Vector2f&	   Xi,
+		Vector3f*		   pWi,
+		float*			   pPdf,
+		VisibilityTester*  pVisibilityTester) const override;
+
+	float PdfLi(const Interaction& Interaction, const Vector3f& wi) const override;
+
+	Spectrum SampleLe(
+		const Vector2f& Xi0,
+		const Vector2f& Xi1,
+		RayDesc*		pRay,
+		Vector3f*		pNormal,
+		float*			pPdfPos,
+		float*			pPdfDir) const override;
+
+	void PdfLe(const RayDesc& Ray, const Vector3f& n, float* pPdfPos, float* pPdfDir) const override;
+
+	std::optional<LightBounds> Bounds() const override;
+
+	float Radius;
+
+private:
+	Vector3f Center() const { return Vector3f(Transform.Position.x, Transform.Position.y, Transform.Position.z); }
+};
+
+/*
+ *	Disk light facing the forward axis of Transform. A disk seen at an angle subtends an ellipse on the sphere of
+ *	directions, which has no closed form cone to sample, so points are sampled uniformly over the disk with the
+ *	concentric mapping and converted to solid angle
+ */
+struct DiskLight : ShapeLight
+{
+	DiskLight(const Spectrum& Lemit, float Radius);
+
+	void Preprocess(const BoundingBox& SceneBounds) override;
+
+	BoundingBox WorldBound() const override;
+
+	float Intersect(const RayDesc& Ray, Vector3f* pNormal) const override;
+
+	Spectrum SampleLi(
+		const Interaction& Interaction,
+		const Vector2f&	   Xi,
+		Vector3f*		   pWi,
+		float*			   pPdf,
+		VisibilityTester*  pVisibilityTester) const override;
+
+	float PdfLi(const Interaction& Interaction, const Vector3f& wi) const override;
+
+	Spectrum SampleLe(
+		const Vector2f& Xi0,
+		const Vector2f& Xi1,
+		RayDesc*		pRay,
+		Vector3f*		pNormal,
+		float*			pPdfPos,
+		float*			pPdfDir) const override;
+
+	void PdfLe(const RayDesc& Ray, const Vector3f& n, float* pPdfPos, float* pPdfDir) const override;
+
+	std::optional<LightBounds> Bounds() const override;
+
+	float Radius;
+
+private:
+	// Distance along the ray (o, d) to the emitting side of the disk, 0 if the ray misses it
+	float Intersect(const Vector3f& o, const Vector3f& d) const;
+
+	// Center and frame of the disk with n along the forward axis, set in Preprocess
+	Vector3f Center;
+	Frame	 DiskFrame;
+};
+
+/*
+ *	Light at infinity whose radiance comes from an equirectangular (latitude-longitude) image, the top row lies
+ *	along the up axis of Transform and the left edge along its right axis. Directions are importance sampled from
+ *	a piecewise-constant distribution over the texels proportional to their luminance times sin theta, which
+ *	accounts for the texels shrinking towards the poles. Texels are point sampled so the radiance is constant
+ *	where the density is, a zero density only ever hides black texels
+ */
+struct ImageInfiniteLight : Light
+{
+	// Images that fail to load leave the light black
+	ImageInfiniteLight(const std::filesystem::path& Path, float Scale = 1.0f);
+	~ImageInfiniteLight() override;
+
+	void Preprocess(const BoundingBox& SceneBounds) override;
+
+	Spectrum Le(const RayDesc& Ray) const override;
+
+	Spectrum SampleLi(
+		const Interaction& Interaction,
+		const Vector2f&	   Xi,
+		Vector3f*		   pWi,
+		float*			   pPdf,
+		VisibilityTester*  pVisibilityTester) const override;
+
+	float PdfLi(const Interaction& Interaction, const Vector3f& wi) const override;
+
+	Spectrum SampleLe(
+		const Vector2f& Xi0,
+		const Vector2f& Xi1,
+		RayDesc*		pRay,
+		Vector3f*		pNormal,
+		float*			pPdfPos,
+		float*			pPdfDir) const override;
+
+	void PdfLe(const RayDesc& Ray, const Vector3f& n, float* pPdfPos, float* pPdfDir) const override;
+
+	float Phi() const override;
+
+	float Scale;
+
+private:
+	// Radiance of the texel at the image coordinates uv, v = 0 is the top row
+	Spectrum Lookup(const Vector2f& uv) const;
+
+	std::unique_ptr<Texture2D<RGBSpectrum>> Image;
+	std::unique_ptr<Distribution2D>			Distribution;
+	// Right, up and forward axes of Transform, set in Preprocess
+	Frame	 LightFrame;
+	Vector3f SceneCenter;
+	float	 SceneRadius = 0.0f;
 };
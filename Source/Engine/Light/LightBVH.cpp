@@ -0,0 +1,242 @@
+#include "LightBVH.h"
+#include "../Interaction.h"
+#include "../Sampling.h"
+
+static constexpr unsigned int InvalidNode = ~0u;
+
+/*
+ *	Cost of a cluster of lights for the split heuristic, its power times the solid angle measure of its
+ *	emission cone times its surface area. Kr penalizes splitting thin bounds along their short axis
+ */
+static float EvaluateCost(const LightBounds& b, const BoundingBox& Bounds, int Dim)
+{
+	float theta_o	 = std::acos(std::clamp(b.CosTheta_o, -1.0f, 1.0f));
+	float theta_e	 = std::acos(std::clamp(b.CosTheta_e, -1.0f, 1.0f));
+	float theta_w	 = std::min(theta_o + theta_e, g_PI);
+	float sinTheta_o = std::sqrt(std::max(0.0f, 1.0f - b.CosTheta_o * b.CosTheta_o));
+	float M_omega	 = g_2PI * (1.0f - b.CosTheta_o) +
+					g_PIDIV2 * (2.0f * theta_w * sinTheta_o - std::cos(theta_o - 2.0f * theta_w) -
+								2.0f * theta_o * sinTheta_o + b.CosTheta_o);
+
+	Vector3f Diagonal = Bounds.Diagonal();
+	float	 Kr		  = std::max({ Diagonal.x, Diagonal.y, Diagonal.z }) / Diagonal[Dim];
+	return b.Phi * M_omega * Kr * b.Bounds.SurfaceArea();
+}
+
+LightBVH::LightBVH(std::span<Light* const> Lights)
+{
+	std::vector<std::pair<unsigned int, LightBounds>> BVHLights;
+	for (const Light* pLight : Lights)
+	{
+		std::optional<LightBounds> Bounds = pLight->Bounds();
+		if (!Bounds)
+		{
+			InfiniteLights.push_back(pLight);
+		}
+		else if (Bounds->Phi > 0.0f)
+		{
+			BVHLights.emplace_back(static_cast<unsigned int>(BoundedLights.size()), *Bounds);
+			BoundedLights.push_back(pLight);
+		}
+	}
+
+	if (!BVHLights.empty())
+	{
+		Nodes.reserve(2 * BVHLights.size() - 1);
+		Build(BVHLights, 0, BVHLights.size(), InvalidNode);
+	}
+}
+
+unsigned int LightBVH::Build(
+	std::vector<std::pair<unsigned int, LightBounds>>& Lights,
+	size_t											   Begin,
+	size_t											   End,
+	unsigned int									   Parent)
+{
+	const unsigned int NodeIndex = static_cast<unsigned int>(Nodes.size());
+	Nodes.push_back({});
+	Nodes[NodeIndex].Parent = Parent;
+
+	if (End - Begin == 1)
+	{
+		Nodes[NodeIndex].Bounds			   = Lights[Begin].second;
+		Nodes[NodeIndex].ChildOrLightIndex = Lights[Begin].first;
+		Nodes[NodeIndex].IsLeaf			   = true;
+		LightToLeaf[BoundedLights[Lights[Begin].first]] = NodeIndex;
+		return NodeIndex;
+	}
+
+	BoundingBox Bounds, CentroidBounds;
+	for (size_t i = Begin; i < End; ++i)
+	{
+		Bounds		   = Union(Bounds, Lights[i].second.Bounds);
+		CentroidBounds = Union(CentroidBounds, Lights[i].second.Bounds.Centroid());
+	}
+
+	// Split at the bucket boundary with the lowest cost along any axis
+	constexpr int NumBuckets		 = 12;
+	float		  MinCost			 = std::numeric_limits<float>::infinity();
+	int			  MinCostSplitBucket = -1;
+	int			  MinCostSplitDim	 = -1;
+
+	auto GetBucket = [&](const LightBounds& b, int Dim)
+	{
+		int Bucket = int(NumBuckets * CentroidBounds.Offset(b.Bounds.Centroid())[Dim]);
+		return std::min(Bucket, NumBuckets - 1);
+	};
+
+	for (int Dim = 0; Dim < 3; ++Dim)
+	{
+		if (CentroidBounds.Max[Dim] == CentroidBounds.Min[Dim])
+		{
+			continue;
+		}
+
+		LightBounds BucketBounds[NumBuckets];
+		for (size_t i = Begin; i < End; ++i)
+		{
+			int Bucket			 = GetBucket(Lights[i].second, Dim);
+			BucketBounds[Bucket] = Union(BucketBounds[Bucket], Lights[i].second);
+		}
+
+		for (int Split = 0; Split < NumBuckets - 1; ++Split)
+		{
+			LightBounds b0, b1;
+			for (int i = 0; i <= Split; ++i)
+			{
+				b0 = Union(b0, BucketBounds[i]);
+			}
+			for (int i = Split + 1; i < NumBuckets; ++i)
+			{
+				b1 = Union(b1, BucketBounds[i]);
+			}
+
+			float Cost = EvaluateCost(b0, Bounds, Dim) + EvaluateCost(b1, Bounds, Dim);
+			if (Cost > 0.0f && Cost < MinCost)
+			{
+				MinCost			   = Cost;
+				MinCostSplitBucket = Split;
+				MinCostSplitDim	   = Dim;
+			}
+		}
+	}
+
+	size_t Mid = (Begin + End) / 2;
+	if (MinCostSplitDim != -1)
+	{
+		auto pMid = std::partition(
+			Lights.begin() + Begin,
+			Lights.begin() + End,
+			[&](const auto& Light) { return GetBucket(Light.second, MinCostSplitDim) <= MinCostSplitBucket; });
+		Mid = size_t(pMid - Lights.begin());
+		if (Mid == Begin || Mid == End)
+		{
+			Mid = (Begin + End) / 2;
+		}
+	}
+
+	// The first child directly follows its parent
+	Build(Lights, Begin, Mid, NodeIndex);
+	unsigned int Child1 = Build(Lights, Mid, End, NodeIndex);
+
+	Node& Interior			   = Nodes[NodeIndex];
+	Interior.Bounds			   = Union(Nodes[NodeIndex + 1].Bounds, Nodes[Child1].Bounds);
+	Interior.ChildOrLightIndex = Child1;
+	Interior.IsLeaf			   = false;
+	return NodeIndex;
+}
+
+float LightBVH::InfiniteLightPdf() const
+{
+	size_t NumInfiniteLights = InfiniteLights.size();
+	return float(NumInfiniteLights) / float(NumInfiniteLights + (Nodes.empty() ? 0 : 1));
+}
+
+const Light* LightBVH::Sample(const Interaction& Interaction, float u, float* pPmf) const
+{
+	*pPmf = 0.0f;
+
+	// Pick a light at infinity or the tree
+	float pInfinite = InfiniteLightPdf();
+	if (u < pInfinite)
+	{
+		size_t Index = std::min(size_t(u / pInfinite * InfiniteLights.size()), InfiniteLights.size() - 1);
+		*pPmf		 = pInfinite / float(InfiniteLights.size());
+		return InfiniteLights[Index];
+	}
+	if (Nodes.empty())
+	{
+		return nullptr;
+	}
+
+	u				   = std::min((u - pInfinite) / (1.0f - pInfinite), OneMinusEpsilon);
+	float		 pmf   = 1.0f - pInfinite;
+	unsigned int Index = 0;
+	while (!Nodes[Index].IsLeaf)
+	{
+		// Choose a child proportional to its importance, the sample is remapped for the next level
+		const unsigned int Child1 = Nodes[Index].ChildOrLightIndex;
+		float			   c0	  = Nodes[Index + 1].Bounds.Importance(Interaction.p, Interaction.n);
+		float			   c1	  = Nodes[Child1].Bounds.Importance(Interaction.p, Interaction.n);
+		if (c0 == 0.0f && c1 == 0.0f)
+		{
+			return nullptr;
+		}
+
+		float p0 = c0 / (c0 + c1);
+		if (u < p0)
+		{
+			Index = Index + 1;
+			u	  = std::min(u / p0, OneMinusEpsilon);
+			pmf *= p0;
+		}
+		else
+		{
+			Index = Child1;
+			u	  = std::min((u - p0) / (1.0f - p0), OneMinusEpsilon);
+			pmf *= 1.0f - p0;
+		}
+	}
+
+	// A tree of a single light was never tested against the interaction
+	if (Index == 0 && Nodes[0].Bounds.Importance(Interaction.p, Interaction.n) == 0.0f)
+	{
+		return nullptr;
+	}
+
+	*pPmf = pmf;
+	return BoundedLights[Nodes[Index].ChildOrLightIndex];
+}
+
+float LightBVH::PMF(const Interaction& Interaction, const Light* pLight) const
+{
+	auto Leaf = LightToLeaf.find(pLight);
+	if (Leaf == LightToLeaf.end())
+	{
+		bool Infinite = std::find(InfiniteLights.begin(), InfiniteLights.end(), pLight) != InfiniteLights.end();
+		return Infinite ? InfiniteLightPdf() / float(InfiniteLights.size()) : 0.0f;
+	}
+
+	if (Leaf->second == 0)
+	{
+		return Nodes[0].Bounds.Importance(Interaction.p, Interaction.n) > 0.0f ? 1.0f - InfiniteLightPdf() : 0.0f;
+	}
+
+	// Walk up to the root multiplying the probabilities of the choices Sample made on the way down
+	float		 pmf   = 1.0f - InfiniteLightPdf();
+	unsigned int Index = Leaf->second;
+	while (Nodes[Index].Parent != InvalidNode)
+	{
+		unsigned int Parent = Nodes[Index].Parent;
+		float		 c0		= Nodes[Parent + 1].Bounds.Importance(Interaction.p, Interaction.n);
+		float		 c1		= Nodes[Nodes[Parent].ChildOrLightIndex].Bounds.Importance(Interaction.p, Interaction.n);
+		float		 c		= Index == Parent + 1 ? c0 : c1;
+		if (c == 0.0f)
+		{
+			return 0.0f;
+		}
+		pmf *= c / (c0 + c1);
+		Index = Parent;
+	}
+	return pmf;
+}
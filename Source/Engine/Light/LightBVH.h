@@ -0,0 +1,50 @@
+#pragma once
+#include "LightSampler.h"
+
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+struct Interaction;
+
+/*
+ *	Bounding volume hierarchy over the lights of a scene for importance sampling many lights (Conty Estevez
+ *	and Kulla's many-light sampling, as done in pbrt-v4). Every node stores the LightBounds of its subtree,
+ *	sampling descends from the root choosing a child with probability proportional to its importance at the
+ *	shading point, so lights that are bright, close and facing the point are picked more often.
+ *	Lights at infinity have no bounds, they are chosen uniformly with the same probability as the whole tree
+ */
+class LightBVH : public LightSampler
+{
+public:
+	LightBVH(std::span<Light* const> Lights);
+
+	const Light* Sample(const Interaction& Interaction, float u, float* pPmf) const override;
+	float		 PMF(const Interaction& Interaction, const Light* pLight) const override;
+
+private:
+	struct Node
+	{
+		LightBounds	 Bounds;
+		unsigned int Parent;
+		// Second child of interior nodes, the first one follows the node. Index into BoundedLights for leaves
+		unsigned int ChildOrLightIndex;
+		bool		 IsLeaf;
+	};
+
+	// Builds the subtree over Lights[Begin, End) and returns the index of its root node
+	unsigned int Build(
+		std::vector<std::pair<unsigned int, LightBounds>>& Lights,
+		size_t											   Begin,
+		size_t											   End,
+		unsigned int									   Parent);
+
+	// Probability of picking the infinite lights as a group
+	float InfiniteLightPdf() const;
+
+	std::vector<const Light*> InfiniteLights;
+	std::vector<const Light*> BoundedLights;
+	std::vector<Node>		  Nodes;
+	// Leaf node of every bounded light
+	std::unordered_map<const Light*, unsigned int> LightToLeaf;
+};
@@ -0,0 +1,127 @@
+#include "LightBounds.h"
+
+// cos(a - b) and sin(a - b) from the sines and cosines of the angles, clamped to 0 if a < b
+static float CosSubClamped(float sinTheta_a, float cosTheta_a, float sinTheta_b, float cosTheta_b)
+{
+	if (cosTheta_a > cosTheta_b)
+	{
+		return 1.0f;
+	}
+	return cosTheta_a * cosTheta_b + sinTheta_a * sinTheta_b;
+}
+
+static float SinSubClamped(float sinTheta_a, float cosTheta_a, float sinTheta_b, float cosTheta_b)
+{
+	if (cosTheta_a > cosTheta_b)
+	{
+		return 0.0f;
+	}
+	return sinTheta_a * cosTheta_b - cosTheta_a * sinTheta_b;
+}
+
+static float SinFromCos(float cosTheta)
+{
+	return std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+}
+
+float LightBounds::Importance(const Vector3f& p, const Vector3f& n) const
+{
+	// Squared distance to the center of the bounds, clamped so points inside them don't blow up
+	Vector3f pc = Bounds.Centroid();
+	float	 d2 = distancesquared(p, pc);
+	d2			= std::max(d2, Bounds.Diagonal().Length() / 2.0f);
+
+	// Angle between w and the direction from the bounds to p
+	Vector3f wi			= d2 > 0.0f ? normalize(p - pc) : Vector3f(0.0f, 0.0f, 1.0f);
+	float	 cosTheta_w = dot(w, wi);
+	if (TwoSided)
+	{
+		cosTheta_w = std::abs(cosTheta_w);
+	}
+	float sinTheta_w = SinFromCos(cosTheta_w);
+
+	// Half angle of the cone of directions from p that the bounds subtend
+	Vector3f Center;
+	float	 Radius;
+	Bounds.BoundingSphere(&Center, &Radius);
+	float cosTheta_b = -1.0f;
+	if (distancesquared(p, Center) >= Radius * Radius)
+	{
+		cosTheta_b = SinFromCos(Radius / distance(p, Center));
+	}
+	float sinTheta_b = SinFromCos(cosTheta_b);
+
+	// Smallest angle between an emitting normal and a direction towards p, no light reaches p beyond theta_e
+	float sinTheta_o = SinFromCos(CosTheta_o);
+	float cosTheta_x = CosSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, CosTheta_o);
+	float sinTheta_x = SinSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, CosTheta_o);
+	float cosThetap	 = CosSubClamped(sinTheta_x, cosTheta_x, sinTheta_b, cosTheta_b);
+	if (cosThetap <= CosTheta_e)
+	{
+		return 0.0f;
+	}
+
+	float importance = Phi * cosThetap / d2;
+
+	// Account for the cosine at the receiving surface
+	if (n.LengthSquared() > 0.0f)
+	{
+		float cosTheta_i  = absdot(wi, n);
+		float sinTheta_i  = SinFromCos(cosTheta_i);
+		float cosThetap_i = CosSubClamped(sinTheta_i, cosTheta_i, sinTheta_b, cosTheta_b);
+		importance *= cosThetap_i;
+	}
+
+	return std::max(importance, 0.0f);
+}
+
+LightBounds Union(const LightBounds& a, const LightBounds& b)
+{
+	if (a.Phi == 0.0f)
+	{
+		return b;
+	}
+	if (b.Phi == 0.0f)
+	{
+		return a;
+	}
+
+	LightBounds u;
+	u.Bounds	 = Union(a.Bounds, b.Bounds);
+	u.Phi		 = a.Phi + b.Phi;
+	u.CosTheta_e = std::min(a.CosTheta_e, b.CosTheta_e);
+	u.TwoSided	 = a.TwoSided || b.TwoSided;
+
+	// Smallest cone containing both normal cones
+	float theta_a = std::acos(std::clamp(a.CosTheta_o, -1.0f, 1.0f));
+	float theta_b = std::acos(std::clamp(b.CosTheta_o, -1.0f, 1.0f));
+	float theta_d = anglebetween(a.w, b.w);
+	if (std::min(theta_d + theta_b, g_PI) <= theta_a)
+	{
+		u.w			 = a.w;
+		u.CosTheta_o = a.CosTheta_o;
+		return u;
+	}
+	if (std::min(theta_d + theta_a, g_PI) <= theta_b)
+	{
+		u.w			 = b.w;
+		u.CosTheta_o = b.CosTheta_o;
+		return u;
+	}
+
+	float	 theta_o = (theta_a + theta_d + theta_b) / 2.0f;
+	Vector3f axis	 = cross(a.w, b.w);
+	if (theta_o >= g_PI || axis.LengthSquared() == 0.0f)
+	{
+		u.w			 = Vector3f(0.0f, 0.0f, 1.0f);
+		u.CosTheta_o = -1.0f;
+		return u;
+	}
+
+	// Rotate a.w towards b.w so the cone touches the far sides of both
+	float theta_r = theta_o - theta_a;
+	axis		  = normalize(axis);
+	u.w			  = normalize(a.w * std::cos(theta_r) + cross(axis, a.w) * std::sin(theta_r));
+	u.CosTheta_o  = std::cos(theta_o);
+	return u;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "Math/Math.h"
+
+/*
+ *	Conservative description of where a light, or a group of lights, emits from and in which directions.
+ *	Emission is bounded by a cone of normals around w with half angle theta_o, plus a falloff angle theta_e
+ *	beyond the normals past which no light leaves (pi/2 for diffuse emitters). Used by the light BVH to estimate
+ *	the contribution of a whole subtree at a shading point
+ */
+struct LightBounds
+{
+	BoundingBox Bounds;
+	Vector3f	w;				   // Principal emission direction
+	float		Phi		   = 0.0f; // Emitted power
+	float		CosTheta_o = 1.0f;
+	float		CosTheta_e = 1.0f;
+	bool		TwoSided   = false;
+
+	/*
+	 *	Upper bound of the contribution to the point p with surface normal n (zero for points in media),
+	 *	relative to other bounds evaluated at the same point
+	 */
+	float Importance(const Vector3f& p, const Vector3f& n) const;
+};
+
+LightBounds Union(const LightBounds& a, const LightBounds& b);
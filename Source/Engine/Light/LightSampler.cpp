@@ -0,0 +1,250 @@
+#include "LightSampler.h"
+#include "LightBVH.h"
+#include "../Scene.h"
+
+#include <numeric>
+
+UniformLightSampler::UniformLightSampler(std::span<Light* const> Lights)
+	: Lights(Lights.begin(), Lights.end())
+{
+}
+
+const Light* UniformLightSampler::Sample(const Interaction& Interaction, float u, float* pPmf) const
+{
+	*pPmf = 0.0f;
+	if (Lights.empty())
+	{
+		return nullptr;
+	}
+
+	size_t Index = std::min(size_t(u * float(Lights.size())), Lights.size() - 1);
+	*pPmf		 = 1.0f / float(Lights.size());
+	return Lights[Index];
+}
+
+float UniformLightSampler::PMF(const Interaction& Interaction, const Light* pLight) const
+{
+	return Lights.empty() ? 0.0f : 1.0f / float(Lights.size());
+}
+
+// Emitted power of every light, the lights must have been preprocessed
+static std::vector<float> GetLightPowers(std::span<Light* const> Lights)
+{
+	std::vector<float> Powers(Lights.size());
+	for (size_t i = 0; i < Lights.size(); ++i)
+	{
+		Powers[i] = Lights[i]->Phi();
+	}
+	return Powers;
+}
+
+PowerLightSampler::PowerLightSampler(std::span<Light* const> Lights)
+	: Lights(Lights.begin(), Lights.end())
+{
+	if (Lights.empty())
+	{
+		return;
+	}
+
+	for (size_t i = 0; i < Lights.size(); ++i)
+	{
+		LightToIndex[Lights[i]] = i;
+	}
+	Distribution = AliasTable(GetLightPowers(Lights));
+}
+
+const Light* PowerLightSampler::Sample(const Interaction& Interaction, float u, float* pPmf) const
+{
+	*pPmf = 0.0f;
+	if (Lights.empty())
+	{
+		return nullptr;
+	}
+	return Lights[Distribution.Sample(u, pPmf)];
+}
+
+float PowerLightSampler::PMF(const Interaction& Interaction, const Light* pLight) const
+{
+	auto Index = LightToIndex.find(pLight);
+	return Index != LightToIndex.end() ? Distribution.PMF(Index->second) : 0.0f;
+}
+
+// Van der Corput sequence in the given prime base, the coordinates of a Halton sequence
+static float RadicalInverse(unsigned int Base, unsigned int Index)
+{
+	const float InvBase = 1.0f / float(Base);
+	float		InvBaseN = 1.0f;
+	unsigned	Reversed = 0;
+	while (Index)
+	{
+		Reversed = Reversed * Base + Index % Base;
+		InvBaseN *= InvBase;
+		Index /= Base;
+	}
+	return std::min(float(Reversed) * InvBaseN, OneMinusEpsilon);
+}
+
+SpatialLightSampler::SpatialLightSampler(
+	std::span<Light* const> Lights,
+	const BoundingBox&		SceneBounds,
+	int						MaxVoxels /*= 64*/)
+	: Lights(Lights.begin(), Lights.end())
+	, Bounds(SceneBounds)
+{
+	for (size_t i = 0; i < Lights.size(); ++i)
+	{
+		LightToIndex[Lights[i]] = i;
+	}
+
+	// Voxels are roughly cubes, the longest axis of the scene gets MaxVoxels of them
+	Vector3f Diagonal = Bounds.IsEmpty() ? Vector3f(0.0f) : Bounds.Diagonal();
+	float	 MaxExtent = std::max({ Diagonal.x, Diagonal.y, Diagonal.z });
+	size_t	 NumVoxels = 1;
+	for (int i = 0; i < 3; ++i)
+	{
+		Resolution[i] = MaxExtent > 0.0f ? std::max(1, int(std::round(Diagonal[i] / MaxExtent * float(MaxVoxels)))) : 1;
+		NumVoxels *= size_t(Resolution[i]);
+	}
+
+	Voxels = std::make_unique<std::atomic<Distribution1D*>[]>(NumVoxels);
+	for (size_t i = 0; i < NumVoxels; ++i)
+	{
+		Voxels[i].store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+SpatialLightSampler::~SpatialLightSampler()
+{
+	const size_t NumVoxels = size_t(Resolution[0]) * Resolution[1] * Resolution[2];
+	for (size_t i = 0; i < NumVoxels; ++i)
+	{
+		delete Voxels[i].load(std::memory_order_relaxed);
+	}
+}
+
+const Light* SpatialLightSampler::Sample(const Interaction& Interaction, float u, float* pPmf) const
+{
+	*pPmf = 0.0f;
+	if (Lights.empty())
+	{
+		return nullptr;
+	}
+	return Lights[GetDistribution(Interaction.p).SampleDiscrete(u, pPmf)];
+}
+
+float SpatialLightSampler::PMF(const Interaction& Interaction, const Light* pLight) const
+{
+	auto Index = LightToIndex.find(pLight);
+	return Index != LightToIndex.end() ? GetDistribution(Interaction.p).DiscretePMF(Index->second) : 0.0f;
+}
+
+const Distribution1D& SpatialLightSampler::GetDistribution(const Vector3f& p) const
+{
+	Vector3f Offset = Bounds.IsEmpty() ? Vector3f(0.0f) : Bounds.Offset(p);
+	int		 Voxel[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		Voxel[i] = std::clamp(int(Offset[i] * float(Resolution[i])), 0, Resolution[i] - 1);
+	}
+
+	const size_t				  Index = (size_t(Voxel[2]) * Resolution[1] + Voxel[1]) * Resolution[0] + Voxel[0];
+	std::atomic<Distribution1D*>& Slot	= Voxels[Index];
+	if (Distribution1D* pDistribution = Slot.load(std::memory_order_acquire))
+	{
+		return *pDistribution;
+	}
+
+	BoundingBox VoxelBounds;
+	if (!Bounds.IsEmpty())
+	{
+		Vector3f Diagonal = Bounds.Diagonal();
+		for (int i = 0; i < 3; ++i)
+		{
+			VoxelBounds.Min[i] = Bounds.Min[i] + Diagonal[i] * float(Voxel[i]) / float(Resolution[i]);
+			VoxelBounds.Max[i] = Bounds.Min[i] + Diagonal[i] * float(Voxel[i] + 1) / float(Resolution[i]);
+		}
+	}
+	else
+	{
+		VoxelBounds = BoundingBox(p);
+	}
+
+	// Another thread may have finished the same voxel in the meantime, its distribution is kept
+	std::unique_ptr<Distribution1D> pDistribution = ComputeDistribution(VoxelBounds);
+	Distribution1D*					pExpected	  = nullptr;
+	if (Slot.compare_exchange_strong(pExpected, pDistribution.get(), std::memory_order_acq_rel))
+	{
+		return *pDistribution.release();
+	}
+	return *pExpected;
+}
+
+std::unique_ptr<Distribution1D> SpatialLightSampler::ComputeDistribution(const BoundingBox& VoxelBounds) const
+{
+	/*
+	 * Estimate how much every light contributes to the voxel from Li / pdf of light samples at points spread
+	 * over the voxel with a Halton sequence, ignoring visibility and the BSDF
+	 */
+	constexpr unsigned int NumSamples = 128;
+	std::vector<float>	   Contributions(Lights.size(), 0.0f);
+	for (unsigned int i = 0; i < NumSamples; ++i)
+	{
+		Interaction Point;
+		Vector3f	t(RadicalInverse(2, i), RadicalInverse(3, i), RadicalInverse(5, i));
+		for (int Axis = 0; Axis < 3; ++Axis)
+		{
+			Point.p[Axis] = VoxelBounds.Min[Axis] + t[Axis] * (VoxelBounds.Max[Axis] - VoxelBounds.Min[Axis]);
+		}
+
+		Vector2f Xi(RadicalInverse(7, i), RadicalInverse(11, i));
+		for (size_t LightIndex = 0; LightIndex < Lights.size(); ++LightIndex)
+		{
+			Vector3f		 wi;
+			float			 pdf = 0.0f;
+			VisibilityTester Visibility;
+			Spectrum		 Li = Lights[LightIndex]->SampleLi(Point, Xi, &wi, &pdf, &Visibility);
+			if (pdf > 0.0f)
+			{
+				Contributions[LightIndex] += Li.y() / pdf;
+			}
+		}
+	}
+
+	// Keep every light at a minimum of a thousandth of the average contribution
+	float Sum		  = std::accumulate(Contributions.begin(), Contributions.end(), 0.0f);
+	float Average	  = Sum / float(NumSamples * Contributions.size());
+	float MinContribution = Average > 0.0f ? 0.001f * Average : 1.0f;
+	for (float& Contribution : Contributions)
+	{
+		Contribution = std::max(Contribution, MinContribution);
+	}
+
+	return std::make_unique<Distribution1D>(Contributions);
+}
+
+std::unique_ptr<LightSampler> CreateLightSampler(
+	LightSamplerType		Type,
+	std::span<Light* const> Lights,
+	const BoundingBox&		SceneBounds)
+{
+	switch (Type)
+	{
+	case LightSamplerType::Uniform:
+		return std::make_unique<UniformLightSampler>(Lights);
+	case LightSamplerType::Power:
+		return std::make_unique<PowerLightSampler>(Lights);
+	case LightSamplerType::Spatial:
+		if (Lights.size() <= SpatialLightSampler::MaxLights)
+		{
+			return std::make_unique<SpatialLightSampler>(Lights, SceneBounds);
+		}
+		printf(
+			"%zu lights are too many for the spatial light sampler (at most %zu), using the light BVH\n",
+			Lights.size(),
+			SpatialLightSampler::MaxLights);
+		return std::make_unique<LightBVH>(Lights);
+	case LightSamplerType::BVH:
+	default:
+		return std::make_unique<LightBVH>(Lights);
+	}
+}
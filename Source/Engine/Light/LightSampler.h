@@ -0,0 +1,107 @@
+#pragma once
+#include "Light.h"
+#include "../Sampling.h"
+
+#include <atomic>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+struct Interaction;
+
+enum class LightSamplerType
+{
+	Uniform, // Every light is equally likely
+	Power,	 // Proportional to the emitted power
+	Spatial, // Proportional to the contribution estimated for the voxel of the shading point
+	BVH		 // Proportional to the importance of the light BVH nodes at the shading point
+};
+
+/*
+ *	Strategy for picking the light that direct lighting samples at a shading point. Implementations are
+ *	immutable once constructed (apart from caches) and are shared by all render threads
+ */
+class LightSampler
+{
+public:
+	virtual ~LightSampler() = default;
+
+	/*
+	 *	Picks a light for Interaction with the sample u, pPmf is set to the probability of picking it.
+	 *	Returns null if no light can contribute to the interaction
+	 */
+	virtual const Light* Sample(const Interaction& Interaction, float u, float* pPmf) const = 0;
+
+	// Probability of Sample picking pLight for Interaction
+	virtual float PMF(const Interaction& Interaction, const Light* pLight) const = 0;
+};
+
+class UniformLightSampler : public LightSampler
+{
+public:
+	UniformLightSampler(std::span<Light* const> Lights);
+
+	const Light* Sample(const Interaction& Interaction, float u, float* pPmf) const override;
+	float		 PMF(const Interaction& Interaction, const Light* pLight) const override;
+
+private:
+	std::vector<const Light*> Lights;
+};
+
+/*
+ *	Picks lights proportional to their power (Light::Phi) from an alias table. The power of lights at infinity
+ *	depends on the scene radius, so the lights must be preprocessed first
+ */
+class PowerLightSampler : public LightSampler
+{
+public:
+	PowerLightSampler(std::span<Light* const> Lights);
+
+	const Light* Sample(const Interaction& Interaction, float u, float* pPmf) const override;
+	float		 PMF(const Interaction& Interaction, const Light* pLight) const override;
+
+private:
+	std::vector<const Light*>				  Lights;
+	std::unordered_map<const Light*, size_t> LightToIndex;
+	AliasTable								  Distribution;
+};
+
+/*
+ *	Divides the scene bounds into a grid of up to MaxVoxels voxels along the longest axis, every voxel gets its own
+ *	distribution over the lights proportional to their unoccluded contribution averaged over points sampled in the
+ *	voxel (pbrt-v3's spatial light distribution). Distributions are only built once a shading point falls into the
+ *	voxel, threads racing to build the same voxel keep the first result. Every light keeps a small probability
+ *	since the sampled points may have missed where it contributes.
+ *	A voxel costs 128 light samples per light and a dense distribution over all lights, so the sampler is meant
+ *	for scenes with few lights. CreateLightSampler uses the light BVH instead above MaxLights lights
+ */
+class SpatialLightSampler : public LightSampler
+{
+public:
+	static constexpr size_t MaxLights = 64;
+
+	SpatialLightSampler(std::span<Light* const> Lights, const BoundingBox& SceneBounds, int MaxVoxels = 64);
+	~SpatialLightSampler() override;
+
+	const Light* Sample(const Interaction& Interaction, float u, float* pPmf) const override;
+	float		 PMF(const Interaction& Interaction, const Light* pLight) const override;
+
+private:
+	// Distribution of the voxel p falls into, clamped to the grid
+	const Distribution1D& GetDistribution(const Vector3f& p) const;
+
+	std::unique_ptr<Distribution1D> ComputeDistribution(const BoundingBox& VoxelBounds) const;
+
+	std::vector<const Light*>				  Lights;
+	std::unordered_map<const Light*, size_t> LightToIndex;
+	BoundingBox								  Bounds;
+	int										  Resolution[3];
+	// Built on demand, indexed by (z * Resolution[1] + y) * Resolution[0] + x
+	std::unique_ptr<std::atomic<Distribution1D*>[]> Voxels;
+};
+
+std::unique_ptr<LightSampler> CreateLightSampler(
+	LightSamplerType		Type,
+	std::span<Light* const> Lights,
+	const BoundingBox&		SceneBounds);
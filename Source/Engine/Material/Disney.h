@@ -16,6 +16,8 @@ struct Disney : public BxDF
 		return BxDFFlags::Reflection | BxDFFlags::Diffuse | BxDFFlags::Glossy;
 	}
 
+	Spectrum Albedo() const override { return baseColor; }
+
 	Spectrum baseColor = Spectrum(1.0f);
 	float metallic = 0.0f;
 	float subsurface = 0.0f;
@@ -0,0 +1,34 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "../BxDF.h"
+
+/*
+ * Scene-level owner of every BxDF. Materials are referenced by index, indices and the BxDF
+ * addresses stay stable for the lifetime of the table, so BSDFs built on the hit path only
+ * carry a non-owning pointer and shading does no reference counting.
+ */
+class MaterialTable
+{
+public:
+	static constexpr unsigned int InvalidID = ~0u;
+
+	template<typename T, typename... TArgs>
+	unsigned int Create(TArgs&&... Args)
+	{
+		return Add(std::make_unique<T>(std::forward<TArgs>(Args)...));
+	}
+
+	unsigned int Add(std::unique_ptr<BxDF> pBxDF)
+	{
+		Materials.push_back(std::move(pBxDF));
+		return static_cast<unsigned int>(Materials.size() - 1);
+	}
+
+	const BxDF* operator[](unsigned int MaterialID) const { return Materials[MaterialID].get(); }
+
+	auto size() const { return Materials.size(); }
+
+private:
+	std::vector<std::unique_ptr<BxDF>> Materials;
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include <algorithm>
+#include <limits>
+#include "TVector3.h"
+
+// Axis aligned bounding box, default constructed boxes are empty and absorb anything they are unioned with
+struct BoundingBox
+{
+	BoundingBox()
+		: Min(std::numeric_limits<float>::max())
+		, Max(std::numeric_limits<float>::lowest())
+	{
+	}
+
+	BoundingBox(const Vector3f& p)
+		: Min(p)
+		, Max(p)
+	{
+	}
+
+	bool IsEmpty() const { return Min.x > Max.x || Min.y > Max.y || Min.z > Max.z; }
+
+	Vector3f Centroid() const { return (Min + Max) * 0.5f; }
+
+	Vector3f Diagonal() const { return Max - Min; }
+
+	float SurfaceArea() const
+	{
+		Vector3f d = Diagonal();
+		return 2.0f * (d.x * d.y + d.x * d.z + d.y * d.z);
+	}
+
+	// Position of p relative to the corners, 0 at Min and 1 at Max
+	Vector3f Offset(const Vector3f& p) const
+	{
+		Vector3f o = p - Min;
+		for (int i = 0; i < 3; ++i)
+		{
+			if (Max[i] > Min[i])
+			{
+				o[i] /= Max[i] - Min[i];
+			}
+		}
+		return o;
+	}
+
+	void BoundingSphere(Vector3f* pCenter, float* pRadius) const
+	{
+		*pCenter = Centroid();
+		*pRadius = IsEmpty() ? 0.0f : distance(*pCenter, Max);
+	}
+
+	Vector3f Min;
+	Vector3f Max;
+};
+
+inline BoundingBox Union(const BoundingBox& a, const Vector3f& p)
+{
+	BoundingBox b;
+	b.Min = Vector3f(std::min(a.Min.x, p.x), std::min(a.Min.y, p.y), std::min(a.Min.z, p.z));
+	b.Max = Vector3f(std::max(a.Max.x, p.x), std::max(a.Max.y, p.y), std::max(a.Max.z, p.z));
+	return b;
+}
+
+inline BoundingBox Union(const BoundingBox& a, const BoundingBox& b)
+{
+	return Union(Union(a, b.Min), b.Max);
+}
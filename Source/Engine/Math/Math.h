@@ -4,6 +4,7 @@
 
 #include "TVector2.h"
 #include "TVector3.h"
+#include "BoundingBox.h"
 #include "Frame.h"
 #include "Ray.h"
 #include "Transform.h"
@@ -61,3 +62,13 @@ inline int Log2Int(int32_t v)
 {
 	return Log2Int((uint32_t)v);
 }
+
+// Angle between the unit vectors v1 and v2, accurate for nearly (anti)parallel vectors unlike acos of the dot
+inline float anglebetween(const Vector3f& v1, const Vector3f& v2)
+{
+	if (dot(v1, v2) < 0.0f)
+	{
+		return g_PI - 2.0f * std::asin(std::min(1.0f, (v1 + v2).Length() / 2.0f));
+	}
+	return 2.0f * std::asin(std::min(1.0f, (v2 - v1).Length() / 2.0f));
+}
@@ -37,7 +37,8 @@ Spectrum HomogeneousMedium::Tr(RayDesc ray, Sampler& sampler) const noexcept
 	return Exp(-sigma_t * std::min(ray.TMax * ray.Direction.Length(), std::numeric_limits<float>::max()));
 }
 
-Spectrum HomogeneousMedium::Sample(RayDesc ray, Sampler& sampler, MediumInteraction* mi) const noexcept
+Spectrum HomogeneousMedium::Sample(RayDesc ray, Sampler& sampler, MemoryArena& Arena, MediumInteraction* mi)
+	const noexcept
 {
 	//<<Sample a channel and distance along the ray>>=
 	int	  channel		= std::min((int)(sampler.Get1D() * Spectrum::NumCoefficients), Spectrum::NumCoefficients - 1);
@@ -46,7 +47,7 @@ Spectrum HomogeneousMedium::Sample(RayDesc ray, Sampler& sampler, MediumInteract
 	bool  sampledMedium = t < ray.TMax;
 	if (sampledMedium)
 	{
-		*mi = MediumInteraction(ray.At(t), -ray.Direction, this, std::make_unique<HenyeyGreenstein>(g));
+		*mi = MediumInteraction(ray.At(t), -ray.Direction, this, Arena.Allocate<HenyeyGreenstein>(g));
 	}
 
 	//<<Compute the transmittance and sampling density>>=
@@ -1,6 +1,7 @@
 ﻿#pragma once
 #include "Spectrum.h"
 #include "Sampler/Sampler.h"
+#include "MemoryArena.h"
 
 struct MediumInteraction;
 
@@ -44,7 +45,9 @@ public:
 
 	[[nodiscard]] virtual Spectrum Tr(RayDesc ray, Sampler& sampler) const noexcept = 0;
 
-	[[nodiscard]] virtual Spectrum Sample(RayDesc ray, Sampler& sampler, MediumInteraction* mi) const noexcept = 0;
+	// The phase function of a sampled medium interaction is allocated from Arena
+	[[nodiscard]] virtual Spectrum Sample(RayDesc ray, Sampler& sampler, MemoryArena& Arena, MediumInteraction* mi)
+		const noexcept = 0;
 };
 
 struct MediumInterface
@@ -80,7 +83,8 @@ public:
 
 	[[nodiscard]] Spectrum Tr(RayDesc ray, Sampler& sampler) const noexcept override;
 
-	[[nodiscard]] Spectrum Sample(RayDesc ray, Sampler& sampler, MediumInteraction* mi) const noexcept override;
+	[[nodiscard]] Spectrum Sample(RayDesc ray, Sampler& sampler, MemoryArena& Arena, MediumInteraction* mi)
+		const noexcept override;
 
 private:
 	Spectrum sigma_a, sigma_s, sigma_t;
@@ -0,0 +1,92 @@
+#include "MemoryArena.h"
+#include <algorithm>
+#include <cassert>
+
+MemoryArena::~MemoryArena()
+{
+	if (pCurrentBlock)
+	{
+		FreeBlock({ pCurrentBlock, CurrentBlockSize });
+	}
+	for (const auto& Block : UsedBlocks)
+	{
+		FreeBlock(Block);
+	}
+	for (const auto& Block : AvailableBlocks)
+	{
+		FreeBlock(Block);
+	}
+}
+
+void* MemoryArena::Alloc(size_t NumBytes, size_t Alignment /*= alignof(std::max_align_t)*/)
+{
+	assert(Alignment <= MaxAlignment && (Alignment & (Alignment - 1)) == 0);
+
+	CurrentBlockPos = (CurrentBlockPos + Alignment - 1) & ~(Alignment - 1);
+
+	if (CurrentBlockPos + NumBytes > CurrentBlockSize)
+	{
+		// Retire the current block and continue in a block that is large enough
+		if (pCurrentBlock)
+		{
+			UsedBlocks.push_back({ pCurrentBlock, CurrentBlockSize });
+			pCurrentBlock	 = nullptr;
+			CurrentBlockSize = 0;
+		}
+
+		auto Iter = std::find_if(
+			AvailableBlocks.begin(),
+			AvailableBlocks.end(),
+			[NumBytes](const Block& Block)
+			{
+				return Block.Size >= NumBytes;
+			});
+		if (Iter != AvailableBlocks.end())
+		{
+			pCurrentBlock	 = Iter->pMemory;
+			CurrentBlockSize = Iter->Size;
+			AvailableBlocks.erase(Iter);
+		}
+		else
+		{
+			CurrentBlockSize = std::max(NumBytes, BlockSize);
+			pCurrentBlock	 = AllocateBlock(CurrentBlockSize);
+		}
+		CurrentBlockPos = 0;
+	}
+
+	void* pMemory = pCurrentBlock + CurrentBlockPos;
+	CurrentBlockPos += NumBytes;
+	return pMemory;
+}
+
+void MemoryArena::Reset()
+{
+	CurrentBlockPos = 0;
+	AvailableBlocks.insert(AvailableBlocks.end(), UsedBlocks.begin(), UsedBlocks.end());
+	UsedBlocks.clear();
+}
+
+size_t MemoryArena::TotalAllocated() const
+{
+	size_t Total = CurrentBlockSize;
+	for (const auto& Block : UsedBlocks)
+	{
+		Total += Block.Size;
+	}
+	for (const auto& Block : AvailableBlocks)
+	{
+		Total += Block.Size;
+	}
+	return Total;
+}
+
+std::byte* MemoryArena::AllocateBlock(size_t Size)
+{
+	return static_cast<std::byte*>(::operator new(Size, std::align_val_t(MaxAlignment)));
+}
+
+void MemoryArena::FreeBlock(const Block& Block)
+{
+	::operator delete(Block.pMemory, std::align_val_t(MaxAlignment));
+}
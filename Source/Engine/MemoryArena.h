@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+/*
+ * Bump allocator for short lived allocations on the integrator hot loop (phase functions, BSDFs, ...).
+ * Every render thread owns one arena which is reset after each Li call, memory blocks are kept
+ * around between resets so once warmed up allocating from the arena never touches the heap.
+ * Destructors of objects allocated from the arena are never called, only allocate types
+ * that do not own resources.
+ */
+class MemoryArena
+{
+public:
+	static constexpr size_t DefaultBlockSize = 256 * 1024;
+	static constexpr size_t MaxAlignment	 = 64;
+
+	MemoryArena(size_t BlockSize = DefaultBlockSize)
+		: BlockSize(BlockSize)
+	{
+	}
+
+	~MemoryArena();
+
+	MemoryArena(const MemoryArena&) = delete;
+	MemoryArena& operator=(const MemoryArena&) = delete;
+
+	void* Alloc(size_t NumBytes, size_t Alignment = alignof(std::max_align_t));
+
+	template<typename T, typename... TArgs>
+	T* Allocate(TArgs&&... Args)
+	{
+		void* pMemory = Alloc(sizeof(T), alignof(T));
+		return new (pMemory) T(std::forward<TArgs>(Args)...);
+	}
+
+	// Makes all memory available for reuse, objects allocated from the arena must no longer be used
+	void Reset();
+
+	size_t TotalAllocated() const;
+
+private:
+	struct Block
+	{
+		std::byte* pMemory;
+		size_t	   Size;
+	};
+
+	static std::byte* AllocateBlock(size_t Size);
+	static void		  FreeBlock(const Block& Block);
+
+	size_t	   BlockSize;
+	std::byte* pCurrentBlock	= nullptr;
+	size_t	   CurrentBlockSize = 0;
+	size_t	   CurrentBlockPos	= 0;
+
+	std::vector<Block> UsedBlocks;
+	std::vector<Block> AvailableBlocks;
+};
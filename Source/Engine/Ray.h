@@ -67,3 +67,31 @@ struct RayDesc
 	mutable float  TMax	  = INFINITY;
 	const IMedium* Medium = nullptr;
 };
+
+/*
+ * Compact record of a ray hit as returned by traversal, only holds what embree reports.
+ * The differential geometry of the hit is evaluated on demand through Scene::GetSurfaceInteraction.
+ */
+struct RayHit
+{
+	RayHit() = default;
+	RayHit(const RTCRayHit& RTCRayHit)
+		: InstanceID(RTCRayHit.hit.instID[0])
+		, GeometryID(RTCRayHit.hit.geomID)
+		, PrimitiveID(RTCRayHit.hit.primID)
+		, u(RTCRayHit.hit.u)
+		, v(RTCRayHit.hit.v)
+		, t(RTCRayHit.ray.tfar)
+		, Ng(RTCRayHit.hit.Ng_x, RTCRayHit.hit.Ng_y, RTCRayHit.hit.Ng_z)
+	{
+	}
+
+	bool IsValid() const { return GeometryID != RTC_INVALID_GEOMETRY_ID; }
+
+	unsigned int InstanceID	 = RTC_INVALID_GEOMETRY_ID;
+	unsigned int GeometryID	 = RTC_INVALID_GEOMETRY_ID;
+	unsigned int PrimitiveID = RTC_INVALID_GEOMETRY_ID;
+	float		 u = 0.0f, v = 0.0f; // Barycentrics
+	float		 t = INFINITY;
+	Vector3f	 Ng; // Unnormalized geometric normal in object space
+};
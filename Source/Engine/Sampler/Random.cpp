@@ -1,5 +1,23 @@
 #include "Random.h"
 
+// Bijective 64-bit finalizer (MurmurHash3), distinct pixels keep distinct streams
+static uint64_t MixBits(uint64_t v)
+{
+	v ^= v >> 33;
+	v *= 0xff51afd7ed558ccdull;
+	v ^= v >> 33;
+	v *= 0xc4ceb9fe1a85ec53ull;
+	v ^= v >> 33;
+	return v;
+}
+
+// Every pixel draws from its own PCG stream, so the sequences of two pixels never overlap. The seed picks
+// the starting point within the streams
+static void SeedPixel(pcg32& RNG, uint32_t Seed, int x, int y)
+{
+	RNG.seed(MixBits(0x853c49e6748fea9bull + Seed), MixBits(uint64_t(uint32_t(x)) << 32 | uint32_t(y)));
+}
+
 std::unique_ptr<Sampler> Random::Clone() const
 {
 	return std::make_unique<Random>(*this);
@@ -7,7 +25,7 @@ std::unique_ptr<Sampler> Random::Clone() const
 
 void Random::StartPixel(int x, int y)
 {
-	RNG.seed(x, y);
+	SeedPixel(RNG, Seed, x, y);
 	return Sampler::StartPixel(x, y);
 }
 
@@ -16,6 +34,17 @@ bool Random::StartNextSample()
 	return Sampler::StartNextSample();
 }
 
+void Random::StartPixelSample(int x, int y, int SampleIndex)
+{
+	// Every sample gets its own stretch of 2^32 values of the pixel's stream, long volumetric paths cannot
+	// run into the next sample and 2^32 samples still fit into the 2^64 period
+	constexpr int DimensionsPerSampleLog2 = 32;
+
+	SeedPixel(RNG, Seed, x, y);
+	RNG.advance(int64_t(SampleIndex) << DimensionsPerSampleLog2);
+	return Sampler::StartPixelSample(x, y, SampleIndex);
+}
+
 float Random::Get1D()
 {
 	return RNG.nextFloat();
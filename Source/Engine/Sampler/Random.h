@@ -5,16 +5,19 @@
 class Random : public Sampler
 {
 public:
-	Random(int SamplesPerPixel)
-		: Sampler(SamplesPerPixel)
+	Random(int SamplesPerPixel, uint32_t Seed = 0)
+		: Sampler(SamplesPerPixel, Seed)
 	{
 
 	}
 
+	SamplerType GetType() const override { return SamplerType::Random; }
+
 	std::unique_ptr<Sampler> Clone() const override;
 
 	void StartPixel(int x, int y) override;
 	bool StartNextSample() override;
+	void StartPixelSample(int x, int y, int SampleIndex) override;
 
 	float Get1D() override;
 	Vector2f Get2D() override;
@@ -9,3 +9,8 @@ bool Sampler::StartNextSample()
 {
 	return ++CurrentPixelSample < NumSamplesPerPixel;
 }
+
+void Sampler::StartPixelSample(int x, int y, int SampleIndex)
+{
+	CurrentPixelSample = SampleIndex;
+}
@@ -3,18 +3,29 @@
 #include "Math/Math.h"
 #include "../Sampling.h"
 
+enum class SamplerType : uint32_t
+{
+	Random,
+	Sobol
+};
+
 class Sampler
 {
 public:
-	Sampler(int NumSamplesPerPixel)
+	// Samplers with different seeds generate decorrelated sequences for the same pixel samples
+	Sampler(int NumSamplesPerPixel, uint32_t Seed = 0)
 		: CurrentPixelSample(0)
 		, NumSamplesPerPixel(NumSamplesPerPixel)
+		, Seed(Seed)
 	{
 	}
 
 	virtual ~Sampler() = default;
 
-	int GetNumSamplesPerPixel() const { return NumSamplesPerPixel; }
+	virtual SamplerType GetType() const = 0;
+
+	int		 GetNumSamplesPerPixel() const { return NumSamplesPerPixel; }
+	uint32_t GetSeed() const { return Seed; }
 
 	// Create an exact clone of the current Sampler instance.
 	virtual std::unique_ptr<Sampler> Clone() const = 0;
@@ -28,10 +39,18 @@ public:
 	virtual void StartPixel(int x, int y);
 	virtual bool StartNextSample();
 
+	/*
+	 * Prepares the sampler to generate sample SampleIndex of pixel (x, y)
+	 * Unlike StartPixel/StartNextSample samples can be started in any order, which the adaptive sample
+	 * loop relies on as it revisits the unconverged pixels of a tile once per sample index
+	 */
+	virtual void StartPixelSample(int x, int y, int SampleIndex);
+
 	virtual float	 Get1D() = 0;
 	virtual Vector2f Get2D() = 0;
 
 protected:
-	int CurrentPixelSample;
-	int NumSamplesPerPixel;
+	int		 CurrentPixelSample;
+	int		 NumSamplesPerPixel;
+	uint32_t Seed;
 };
@@ -53676,6 +53676,16 @@ bool Sobol::StartNextSample()
 	return Sampler::StartNextSample();
 }
 
+void Sobol::StartPixelSample(int x, int y, int SampleIndex)
+{
+	this->x = x;
+	this->y = y;
+
+	dimension = 0;
+	sobolIndex = GetIndexForSample(SampleIndex, x, y);
+	return Sampler::StartPixelSample(x, y, SampleIndex);
+}
+
 float Sobol::Get1D()
 {
 	return sobol::sample(sobolIndex, dimension++, scramble);
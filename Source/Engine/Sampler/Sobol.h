@@ -4,8 +4,9 @@
 class Sobol : public Sampler
 {
 public:
-	Sobol(int SamplesPerPixel, int ResolutionX, int ResolutionY)
-		: Sampler(RoundUpPow2(SamplesPerPixel))
+	// The seed XOR scrambles every dimension of the sequence, 0 leaves it unscrambled
+	Sobol(int SamplesPerPixel, int ResolutionX, int ResolutionY, uint32_t Seed = 0)
+		: Sampler(RoundUpPow2(SamplesPerPixel), Seed)
 	{
 		resolution = RoundUpPow2(std::max(ResolutionX, ResolutionY));
 		log2Resolution = Log2Int(resolution);
@@ -14,13 +15,16 @@ public:
 
 		sobolIndex = 0;
 		dimension = 0;
-		scramble = 0;
+		scramble = Seed;
 	}
 
+	SamplerType GetType() const override { return SamplerType::Sobol; }
+
 	std::unique_ptr<Sampler> Clone() const override;
 
 	void StartPixel(int x, int y) override;
 	bool StartNextSample() override;
+	void StartPixelSample(int x, int y, int SampleIndex) override;
 
 	float Get1D() override;
 	Vector2f Get2D() override;
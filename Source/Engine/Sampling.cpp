@@ -1,5 +1,7 @@
 #include "Sampling.h"
 
+#include <numeric>
+
 Vector2f SampleUniformDisk(const Vector2f& Xi)
 {
 	float radius = std::sqrt(Xi.x);
@@ -61,3 +63,299 @@ float CosineHemispherePdf(float CosTheta)
 {
 	return CosTheta * g_1DIVPI;
 }
+
+Vector3f SampleUniformCone(const Vector2f& Xi, float OneMinusCosThetaMax)
+{
+	float OneMinusCosTheta = Xi[0] * OneMinusCosThetaMax;
+	float z				   = 1.0f - OneMinusCosTheta;
+	float r				   = std::sqrt(std::max(0.0f, OneMinusCosTheta * (2.0f - OneMinusCosTheta)));
+	float phi			   = 2.0f * g_PI * Xi[1];
+
+	return { r * std::cos(phi), r * std::sin(phi), z };
+}
+
+float UniformConePdf(float OneMinusCosThetaMax)
+{
+	return 1.0f / (2.0f * g_PI * OneMinusCosThetaMax);
+}
+
+Vector3f SampleUniformTriangle(const Vector2f& Xi)
+{
+	// Heitz's low distortion mapping of the unit square to the triangle
+	float b0, b1;
+	if (Xi.x < Xi.y)
+	{
+		b0 = Xi.x / 2.0f;
+		b1 = Xi.y - b0;
+	}
+	else
+	{
+		b1 = Xi.y / 2.0f;
+		b0 = Xi.x - b1;
+	}
+
+	return { b0, b1, 1.0f - b0 - b1 };
+}
+
+float SphericalTriangleArea(const Vector3f& a, const Vector3f& b, const Vector3f& c)
+{
+	// Van Oosterom and Strackee's formula
+	return std::abs(2.0f * std::atan2(dot(a, cross(b, c)), 1.0f + dot(a, b) + dot(a, c) + dot(b, c)));
+}
+
+// Unit vector along the part of v that is orthogonal to the unit vector w
+static Vector3f Orthonormalize(const Vector3f& v, const Vector3f& w)
+{
+	return normalize(v - dot(v, w) * w);
+}
+
+Vector3f SampleSphericalTriangle(
+	const Vector3f& p0,
+	const Vector3f& p1,
+	const Vector3f& p2,
+	const Vector3f& p,
+	const Vector2f& Xi,
+	float*			pPdf)
+{
+	*pPdf = 0.0f;
+
+	// Vertices of the spherical triangle and the normals of the planes through its edges
+	Vector3f a = normalize(p0 - p), b = normalize(p1 - p), c = normalize(p2 - p);
+	Vector3f nab = cross(a, b), nbc = cross(b, c), nca = cross(c, a);
+	if (nab.LengthSquared() == 0.0f || nbc.LengthSquared() == 0.0f || nca.LengthSquared() == 0.0f)
+	{
+		return { 1.0f, 0.0f, 0.0f };
+	}
+	nab = normalize(nab);
+	nbc = normalize(nbc);
+	nca = normalize(nca);
+
+	// Interior angles at the vertices, the area of the spherical triangle is their sum minus pi
+	float alpha = anglebetween(nab, -nca);
+	float beta	= anglebetween(nbc, -nab);
+	float gamma = anglebetween(nca, -nbc);
+	float Area	= alpha + beta + gamma - g_PI;
+	if (!(Area > 0.0f))
+	{
+		return { 1.0f, 0.0f, 0.0f };
+	}
+	*pPdf = 1.0f / Area;
+
+	// Pick the area of the sub-triangle (a, b, c') and find the vertex c' on the arc from a to c that cuts it off
+	float Ap	   = g_PI + Xi.x * Area;
+	float cosAlpha = std::cos(alpha), sinAlpha = std::sin(alpha);
+	float sinPhi   = std::sin(Ap) * cosAlpha - std::cos(Ap) * sinAlpha;
+	float cosPhi   = std::cos(Ap) * cosAlpha + std::sin(Ap) * sinAlpha;
+	float k1	   = cosPhi + cosAlpha;
+	float k2	   = sinPhi - sinAlpha * dot(a, b);
+	float cosBp	   = (k2 + (k2 * cosPhi - k1 * sinPhi) * cosAlpha) / ((k2 * sinPhi + k1 * cosPhi) * sinAlpha);
+	cosBp		   = std::clamp(cosBp, -1.0f, 1.0f);
+	float	 sinBp = std::sqrt(std::max(0.0f, 1.0f - cosBp * cosBp));
+	Vector3f cp	   = cosBp * a + sinBp * Orthonormalize(c, a);
+
+	// Pick the direction on the arc from b to c'
+	float	 cosTheta = 1.0f - Xi.y * (1.0f - dot(cp, b));
+	float	 sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+	Vector3f w		  = cosTheta * b + sinTheta * Orthonormalize(cp, b);
+
+	// Intersect the direction with the triangle for the barycentrics of the point it sees
+	Vector3f e1 = p1 - p0, e2 = p2 - p0;
+	Vector3f s1		 = cross(w, e2);
+	float	 divisor = dot(s1, e1);
+	if (divisor == 0.0f)
+	{
+		return { 1.0f, 0.0f, 0.0f };
+	}
+	Vector3f s	= p - p0;
+	float	 b1 = std::clamp(dot(s, s1) / divisor, 0.0f, 1.0f);
+	float	 b2 = std::clamp(dot(w, cross(s, e1)) / divisor, 0.0f, 1.0f);
+	if (b1 + b2 > 1.0f)
+	{
+		float sum = b1 + b2;
+		b1 /= sum;
+		b2 /= sum;
+	}
+
+	return { 1.0f - b1 - b2, b1, b2 };
+}
+
+Distribution1D::Distribution1D(std::span<const float> f)
+	: Function(f.begin(), f.end())
+	, CDF(f.size() + 1)
+{
+	// Integrate the step function
+	const size_t n = Function.size();
+	CDF[0]		   = 0.0f;
+	for (size_t i = 1; i < n + 1; ++i)
+	{
+		CDF[i] = CDF[i - 1] + std::abs(Function[i - 1]) / float(n);
+	}
+
+	// Normalize, or fall back to a linear CDF if the function is zero
+	FunctionIntegral = CDF[n];
+	for (size_t i = 1; i < n + 1; ++i)
+	{
+		CDF[i] = FunctionIntegral > 0.0f ? CDF[i] / FunctionIntegral : float(i) / float(n);
+	}
+}
+
+float Distribution1D::SampleContinuous(float u, float* pPdf, size_t* pOffset /*= nullptr*/) const
+{
+	// Last CDF entry that is <= u
+	size_t Offset = size_t(std::upper_bound(CDF.begin(), CDF.end(), u) - CDF.begin());
+	Offset		  = std::clamp(Offset, size_t(1), CDF.size() - 1) - 1;
+	if (pOffset)
+	{
+		*pOffset = Offset;
+	}
+
+	// Offset of u within its interval
+	float du = u - CDF[Offset];
+	if (CDF[Offset + 1] - CDF[Offset] > 0.0f)
+	{
+		du /= CDF[Offset + 1] - CDF[Offset];
+	}
+
+	if (pPdf)
+	{
+		*pPdf = FunctionIntegral > 0.0f ? std::abs(Function[Offset]) / FunctionIntegral : 1.0f;
+	}
+
+	return (float(Offset) + du) / float(size());
+}
+
+size_t Distribution1D::SampleDiscrete(float u, float* pPmf /*= nullptr*/, float* pURemapped /*= nullptr*/) const
+{
+	size_t Offset = size_t(std::upper_bound(CDF.begin(), CDF.end(), u) - CDF.begin());
+	Offset		  = std::clamp(Offset, size_t(1), CDF.size() - 1) - 1;
+
+	if (pPmf)
+	{
+		*pPmf = DiscretePMF(Offset);
+	}
+	if (pURemapped)
+	{
+		float Width = CDF[Offset + 1] - CDF[Offset];
+		*pURemapped = Width > 0.0f ? std::min((u - CDF[Offset]) / Width, OneMinusEpsilon) : 0.0f;
+	}
+	return Offset;
+}
+
+float Distribution1D::DiscretePMF(size_t Index) const
+{
+	return CDF[Index + 1] - CDF[Index];
+}
+
+Distribution2D::Distribution2D(std::span<const float> f, size_t nu, size_t nv)
+{
+	Conditionals.reserve(nv);
+	std::vector<float> MarginalFunction(nv);
+	for (size_t v = 0; v < nv; ++v)
+	{
+		Conditionals.emplace_back(f.subspan(v * nu, nu));
+		MarginalFunction[v] = Conditionals[v].Integral();
+	}
+	Marginal = std::make_unique<Distribution1D>(MarginalFunction);
+}
+
+Vector2f Distribution2D::SampleContinuous(const Vector2f& Xi, float* pPdf) const
+{
+	float  pdfs[2];
+	size_t v  = 0;
+	float  d1 = Marginal->SampleContinuous(Xi.y, &pdfs[1], &v);
+	float  d0 = Conditionals[v].SampleContinuous(Xi.x, &pdfs[0]);
+	*pPdf	  = pdfs[0] * pdfs[1];
+	return Vector2f(d0, d1);
+}
+
+float Distribution2D::Pdf(const Vector2f& p) const
+{
+	const size_t nu = Conditionals[0].size();
+	const size_t nv = Marginal->size();
+	size_t		 iu = std::min(size_t(std::max(p.x, 0.0f) * float(nu)), nu - 1);
+	size_t		 iv = std::min(size_t(std::max(p.y, 0.0f) * float(nv)), nv - 1);
+	if (Marginal->Integral() == 0.0f)
+	{
+		return 1.0f;
+	}
+	return Conditionals[iv].Value(iu) / Marginal->Integral();
+}
+
+AliasTable::AliasTable(std::span<const float> Weights)
+	: Bins(Weights.size())
+{
+	double Sum = std::accumulate(Weights.begin(), Weights.end(), 0.0);
+	for (size_t i = 0; i < Bins.size(); ++i)
+	{
+		Bins[i].p = Sum > 0.0 ? float(Weights[i] / Sum) : 1.0f / float(Bins.size());
+	}
+
+	// Split the bins into those with less and more than the average probability
+	struct Outcome
+	{
+		float  pHat; // Probability scaled by the number of bins
+		size_t Index;
+	};
+	std::vector<Outcome> Under, Over;
+	for (size_t i = 0; i < Bins.size(); ++i)
+	{
+		float pHat = Bins[i].p * float(Bins.size());
+		(pHat < 1.0f ? Under : Over).push_back({ pHat, i });
+	}
+
+	// Fill every underfull bin with the excess of an overfull one
+	while (!Under.empty() && !Over.empty())
+	{
+		Outcome Un = Under.back(), Ov = Over.back();
+		Under.pop_back();
+		Over.pop_back();
+
+		Bins[Un.Index].q	 = Un.pHat;
+		Bins[Un.Index].Alias = int(Ov.Index);
+
+		float pExcess = Un.pHat + Ov.pHat - 1.0f;
+		(pExcess < 1.0f ? Under : Over).push_back({ pExcess, Ov.Index });
+	}
+
+	// Whatever is left is full up to rounding
+	for (const Outcome& Remaining : Under)
+	{
+		Bins[Remaining.Index].q		= 1.0f;
+		Bins[Remaining.Index].Alias = -1;
+	}
+	for (const Outcome& Remaining : Over)
+	{
+		Bins[Remaining.Index].q		= 1.0f;
+		Bins[Remaining.Index].Alias = -1;
+	}
+}
+
+size_t AliasTable::Sample(float u, float* pPmf /*= nullptr*/, float* pURemapped /*= nullptr*/) const
+{
+	size_t Offset = std::min(size_t(u * float(Bins.size())), Bins.size() - 1);
+	float  up	  = std::min(u * float(Bins.size()) - float(Offset), OneMinusEpsilon);
+
+	const Bin& Sampled = Bins[Offset];
+	if (up < Sampled.q)
+	{
+		if (pPmf)
+		{
+			*pPmf = Sampled.p;
+		}
+		if (pURemapped)
+		{
+			*pURemapped = std::min(up / Sampled.q, OneMinusEpsilon);
+		}
+		return Offset;
+	}
+
+	if (pPmf)
+	{
+		*pPmf = Bins[Sampled.Alias].p;
+	}
+	if (pURemapped)
+	{
+		*pURemapped = std::min((up - Sampled.q) / (1.0f - Sampled.q), OneMinusEpsilon);
+	}
+	return size_t(Sampled.Alias);
+}
@@ -1,6 +1,13 @@
 #pragma once
 #include "Math/Math.h"
 
+#include <memory>
+#include <span>
+#include <vector>
+
+// Largest float below 1, samples that are remapped for reuse are clamped to it so they stay in [0, 1)
+static constexpr float OneMinusEpsilon = 0x1.fffffep-1f;
+
 Vector2f SampleUniformDisk(const Vector2f& Xi);
 
 Vector2f SampleConcentricDisk(const Vector2f& Xi);
@@ -11,6 +18,32 @@ float	 UniformHemispherePdf();
 Vector3f SampleCosineHemisphere(const Vector2f& Xi);
 float	 CosineHemispherePdf(float CosTheta);
 
+/*
+ * Uniform direction in the cone around +z with half angle theta max. The cone is given by 1 - cos theta max
+ * so narrow cones like the sun's keep their precision
+ */
+Vector3f SampleUniformCone(const Vector2f& Xi, float OneMinusCosThetaMax);
+float	 UniformConePdf(float OneMinusCosThetaMax);
+
+// Barycentric coordinates of a point distributed uniformly over a triangle's area
+Vector3f SampleUniformTriangle(const Vector2f& Xi);
+
+// Solid angle of the spherical triangle with the unit length vertex directions a, b and c
+float SphericalTriangleArea(const Vector3f& a, const Vector3f& b, const Vector3f& c);
+
+/*
+ * Arvo's method, samples a direction uniformly over the solid angle the triangle (p0, p1, p2) subtends from p.
+ * Returns the barycentric coordinates of the point on the triangle seen along the direction, pPdf is set to the
+ * solid angle density and is 0 if the triangle is degenerate as seen from p
+ */
+Vector3f SampleSphericalTriangle(
+	const Vector3f& p0,
+	const Vector3f& p1,
+	const Vector3f& p2,
+	const Vector3f& p,
+	const Vector2f& Xi,
+	float*			pPdf);
+
 inline float BalanceHeuristic(int nf, float fPdf, int ng, float gPdf)
 {
 	return (nf * fPdf) / (nf * fPdf + ng * gPdf);
@@ -21,3 +54,79 @@ inline float PowerHeuristic(int nf, float fPdf, int ng, float gPdf)
 	float f = nf * fPdf, g = ng * gPdf;
 	return (f * f) / (f * f + g * g);
 }
+
+/*
+ *	Piecewise constant 1D distribution over [0, 1) sampled by inverting its CDF, each value of the function
+ *	covers an interval of equal width. A function that is zero everywhere is sampled uniformly
+ */
+class Distribution1D
+{
+public:
+	Distribution1D(std::span<const float> f);
+
+	size_t size() const { return Function.size(); }
+
+	float Integral() const { return FunctionIntegral; }
+
+	// Continuous sample with density proportional to the function, pOffset is set to the interval it falls in
+	float SampleContinuous(float u, float* pPdf, size_t* pOffset = nullptr) const;
+
+	// Index sampled with probability proportional to its value, pURemapped receives u rescaled to [0, 1)
+	size_t SampleDiscrete(float u, float* pPmf = nullptr, float* pURemapped = nullptr) const;
+
+	float DiscretePMF(size_t Index) const;
+
+	float Value(size_t Index) const { return Function[Index]; }
+
+private:
+	std::vector<float> Function;
+	std::vector<float> CDF;
+	float			   FunctionIntegral;
+};
+
+/*
+ *	Piecewise-constant 2D distribution over [0, 1]^2 of the nu x nv values f[v * nu + u], sampled by picking
+ *	v from the marginal distribution of the rows and then u from the conditional distribution of that row
+ */
+class Distribution2D
+{
+public:
+	Distribution2D(std::span<const float> f, size_t nu, size_t nv);
+
+	// Point sampled with density proportional to the function, pPdf is set to the density in [0, 1]^2
+	Vector2f SampleContinuous(const Vector2f& Xi, float* pPdf) const;
+
+	float Pdf(const Vector2f& p) const;
+
+private:
+	std::vector<Distribution1D>		Conditionals;
+	std::unique_ptr<Distribution1D> Marginal;
+};
+
+/*
+ *	Walker's alias method as constructed by Vose, samples an index with probability proportional to its
+ *	weight in constant time. Weights that are all zero give a uniform table
+ */
+class AliasTable
+{
+public:
+	AliasTable() = default;
+	AliasTable(std::span<const float> Weights);
+
+	size_t size() const { return Bins.size(); }
+
+	// Index sampled with the sample u, pURemapped receives u rescaled to [0, 1)
+	size_t Sample(float u, float* pPmf = nullptr, float* pURemapped = nullptr) const;
+
+	float PMF(size_t Index) const { return Bins[Index].p; }
+
+private:
+	struct Bin
+	{
+		float q		= 0.0f; // Probability of keeping the bin's own index
+		float p		= 0.0f; // Probability of the index
+		int	  Alias = -1;
+	};
+
+	std::vector<Bin> Bins;
+};
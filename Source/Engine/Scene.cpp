@@ -13,9 +13,9 @@ Spectrum VisibilityTester::Tr(const Scene& Scene, Sampler& sampler) const
 	Spectrum Tr(1.f);
 	while (true)
 	{
-		std::optional<SurfaceInteraction> isect = Scene.Intersect(ray);
+		std::optional<RayHit> hit = Scene.TraceRay(ray);
 		// Handle opaque surface along ray's path
-		if (isect && isect->BSDF)
+		if (hit && Scene.IsOpaque(*hit))
 		{
 			return Spectrum(0.0f);
 		}
@@ -27,13 +27,76 @@ Spectrum VisibilityTester::Tr(const Scene& Scene, Sampler& sampler) const
 		}
 
 		// Generate next ray segment or return final transmittance
-		if (!isect)
+		if (!hit)
 			break;
-		ray = isect->SpawnRayTo(I1);
+		ray = Scene.GetInteraction(ray, *hit).SpawnRayTo(I1);
 	}
 	return Tr;
 }
 
+// Ray i of a packet of N rays passed to a user geometry callback
+static RayDesc GetRay(RTCRayN* pRays, unsigned int N, unsigned int i)
+{
+	return RayDesc(
+		Vector3f(RTCRayN_org_x(pRays, N, i), RTCRayN_org_y(pRays, N, i), RTCRayN_org_z(pRays, N, i)),
+		RTCRayN_tnear(pRays, N, i),
+		Vector3f(RTCRayN_dir_x(pRays, N, i), RTCRayN_dir_y(pRays, N, i), RTCRayN_dir_z(pRays, N, i)),
+		RTCRayN_tfar(pRays, N, i));
+}
+
+// User geometry callbacks of the shape lights, the user data of the geometry is the light
+static void ShapeLightBounds(const RTCBoundsFunctionArguments* pArgs)
+{
+	BoundingBox Bounds = static_cast<const ShapeLight*>(pArgs->geometryUserPtr)->WorldBound();
+
+	pArgs->bounds_o->lower_x = Bounds.Min.x;
+	pArgs->bounds_o->lower_y = Bounds.Min.y;
+	pArgs->bounds_o->lower_z = Bounds.Min.z;
+	pArgs->bounds_o->upper_x = Bounds.Max.x;
+	pArgs->bounds_o->upper_y = Bounds.Max.y;
+	pArgs->bounds_o->upper_z = Bounds.Max.z;
+}
+
+static void ShapeLightIntersect(const RTCIntersectFunctionNArguments* pArgs)
+{
+	const ShapeLight* pLight = static_cast<const ShapeLight*>(pArgs->geometryUserPtr);
+	RTCRayN*		  pRays	 = RTCRayHitN_RayN(pArgs->rayhit, pArgs->N);
+	RTCHitN*		  pHits	 = RTCRayHitN_HitN(pArgs->rayhit, pArgs->N);
+	for (unsigned int i = 0; i < pArgs->N; ++i)
+	{
+		Vector3f n;
+		float	 t = pArgs->valid[i] ? pLight->Intersect(GetRay(pRays, pArgs->N, i), &n) : 0.0f;
+		if (t == 0.0f)
+		{
+			continue;
+		}
+
+		// The normal is reported in world space, the lights are not instanced
+		RTCRayN_tfar(pRays, pArgs->N, i)	  = t;
+		RTCHitN_Ng_x(pHits, pArgs->N, i)	  = n.x;
+		RTCHitN_Ng_y(pHits, pArgs->N, i)	  = n.y;
+		RTCHitN_Ng_z(pHits, pArgs->N, i)	  = n.z;
+		RTCHitN_u(pHits, pArgs->N, i)		  = 0.0f;
+		RTCHitN_v(pHits, pArgs->N, i)		  = 0.0f;
+		RTCHitN_primID(pHits, pArgs->N, i)	  = pArgs->primID;
+		RTCHitN_geomID(pHits, pArgs->N, i)	  = pArgs->geomID;
+		RTCHitN_instID(pHits, pArgs->N, i, 0) = pArgs->context->instID[0];
+	}
+}
+
+static void ShapeLightOccluded(const RTCOccludedFunctionNArguments* pArgs)
+{
+	const ShapeLight* pLight = static_cast<const ShapeLight*>(pArgs->geometryUserPtr);
+	for (unsigned int i = 0; i < pArgs->N; ++i)
+	{
+		Vector3f n;
+		if (pArgs->valid[i] && pLight->Intersect(GetRay(pArgs->ray, pArgs->N, i), &n) > 0.0f)
+		{
+			RTCRayN_tfar(pArgs->ray, pArgs->N, i) = -std::numeric_limits<float>::infinity();
+		}
+	}
+}
+
 Scene::Scene(const RTXDevice& Device)
 	: TopLevelAccelerationStructure(Device)
 {
@@ -41,7 +104,7 @@ Scene::Scene(const RTXDevice& Device)
 	rtcSetSceneFlags(TopLevelAccelerationStructure, RTC_SCENE_FLAG_ROBUST);
 }
 
-std::optional<SurfaceInteraction> Scene::Intersect(const RayDesc& Ray) const
+std::optional<RayHit> Scene::TraceRay(const RayDesc& Ray) const
 {
 	/*
 	 * The intersect context can be used to set intersection
@@ -71,24 +134,99 @@ std::optional<SurfaceInteraction> Scene::Intersect(const RayDesc& Ray) const
 
 	Ray.TMax = RTCRayHit.ray.tfar;
 
-	const auto& hit			 = RTCRayHit.hit;
-	auto		Instance	 = TopLevelAccelerationStructure[hit.instID[0]];
-	const auto& GeometryDesc = (*Instance.BLAS)[hit.geomID];
+	return RayHit(RTCRayHit);
+}
+
+std::optional<SurfaceInteraction> Scene::Intersect(const RayDesc& Ray) const
+{
+	std::optional<RayHit> hit = TraceRay(Ray);
+	if (!hit)
+	{
+		return {};
+	}
+
+	return GetSurfaceInteraction(Ray, *hit);
+}
+
+bool Scene::Occluded(const RayDesc& Ray) const
+{
+	RTCIntersectContext RTCIntersectContext;
+	rtcInitIntersectContext(&RTCIntersectContext);
+
+	RTCRay RTCRay = Ray;
+
+	// This function sets RTCRay::tfar to -inf if intersection was found
+	rtcOccluded1(TopLevelAccelerationStructure, &RTCIntersectContext, &RTCRay);
+
+	return RTCRay.tfar == -std::numeric_limits<float>::infinity();
+}
+
+void Scene::Intersect(std::span<RTCRayHit> RayHits, bool Coherent /*= false*/) const
+{
+	RTCIntersectContext RTCIntersectContext;
+	rtcInitIntersectContext(&RTCIntersectContext);
+	RTCIntersectContext.flags = Coherent ? RTC_INTERSECT_CONTEXT_FLAG_COHERENT : RTC_INTERSECT_CONTEXT_FLAG_INCOHERENT;
+
+	rtcIntersect1M(
+		TopLevelAccelerationStructure,
+		&RTCIntersectContext,
+		RayHits.data(),
+		static_cast<unsigned int>(RayHits.size()),
+		sizeof(RTCRayHit));
+}
+
+void Scene::Occluded(std::span<RTCRay> Rays, bool Coherent /*= false*/) const
+{
+	RTCIntersectContext RTCIntersectContext;
+	rtcInitIntersectContext(&RTCIntersectContext);
+	RTCIntersectContext.flags = Coherent ? RTC_INTERSECT_CONTEXT_FLAG_COHERENT : RTC_INTERSECT_CONTEXT_FLAG_INCOHERENT;
+
+	// Same as rtcOccluded1, tfar is set to -inf for every ray that was occluded
+	rtcOccluded1M(
+		TopLevelAccelerationStructure,
+		&RTCIntersectContext,
+		Rays.data(),
+		static_cast<unsigned int>(Rays.size()),
+		sizeof(RTCRay));
+}
+
+SurfaceInteraction Scene::GetSurfaceInteraction(const RayDesc& Ray, const RayHit& Hit) const
+{
+	// Shape lights have no material, the BSDF is left empty
+	if (const ShapeLight* pLight = GetShapeLight(Hit))
+	{
+		SurfaceInteraction si = {};
+		si.p				  = Ray.At(Hit.t);
+		si.wo				  = -Ray.Direction;
+		si.n				  = Hit.Ng;
+		si.mediumInterface	  = Ray.Medium;
+		si.InstanceID		  = Hit.InstanceID;
+		si.GeometryID		  = Hit.GeometryID;
+		si.PrimitiveID		  = Hit.PrimitiveID;
+		si.GeometryFrame = si.ShadingFrame = Frame(si.n);
+		si.BSDF.SetInteraction(si);
+		si.AreaLight = pLight;
+		return si;
+	}
+
+	const auto& Instance	 = TopLevelAccelerationStructure[Hit.InstanceID];
+	const auto& GeometryDesc = (*Instance.BLAS)[Hit.GeometryID];
 
-	DirectX::XMMATRIX mMatrix = Instance.Transform.Matrix();
+	DirectX::XMMATRIX mMatrix		= Instance.ObjectToWorldMatrix();
+	DirectX::XMMATRIX mNormalMatrix = Instance.NormalToWorldMatrix();
 
 	// Fetch indices
-	unsigned int idx0 = GeometryDesc.pIndices[hit.primID * 3 + 0];
-	unsigned int idx1 = GeometryDesc.pIndices[hit.primID * 3 + 1];
-	unsigned int idx2 = GeometryDesc.pIndices[hit.primID * 3 + 2];
+	unsigned int idx0 = GeometryDesc.pIndices[Hit.PrimitiveID * 3 + 0];
+	unsigned int idx1 = GeometryDesc.pIndices[Hit.PrimitiveID * 3 + 1];
+	unsigned int idx2 = GeometryDesc.pIndices[Hit.PrimitiveID * 3 + 2];
 
 	// Fetch vertices
 	Vertex vtx0 = GeometryDesc.pVertices[idx0];
-	vtx0.TransformToWorld(mMatrix);
+	vtx0.TransformToWorld(mMatrix, mNormalMatrix);
 	Vertex vtx1 = GeometryDesc.pVertices[idx1];
-	vtx1.TransformToWorld(mMatrix);
+	vtx1.TransformToWorld(mMatrix, mNormalMatrix);
 	Vertex vtx2 = GeometryDesc.pVertices[idx2];
-	vtx2.TransformToWorld(mMatrix);
+	vtx2.TransformToWorld(mMatrix, mNormalMatrix);
 
 	Vector3f p0 = vtx0.Position, p1 = vtx1.Position, p2 = vtx2.Position;
 	// Compute 2 edges of the triangle
@@ -96,11 +234,11 @@ std::optional<SurfaceInteraction> Scene::Intersect(const RayDesc& Ray) const
 	Vector3f e1 = p2 - p0;
 	Vector3f n	= normalize(cross(e0, e1));
 
-	Vector3f barycentrics = { 1.f - hit.u - hit.v, hit.u, hit.v };
+	Vector3f barycentrics = { 1.f - Hit.u - Hit.v, Hit.u, Hit.v };
 	Vertex	 vertex		  = BarycentricInterpolation(vtx0, vtx1, vtx2, barycentrics);
 
 	SurfaceInteraction si = {};
-	si.p				  = Ray.At(RTCRayHit.ray.tfar);
+	si.p				  = Ray.At(Hit.t);
 	si.wo				  = -Ray.Direction;
 	si.n				  = n;
 	if (GeometryDesc.MediumInterface.IsMediumTransition())
@@ -113,7 +251,9 @@ std::optional<SurfaceInteraction> Scene::Intersect(const RayDesc& Ray) const
 	}
 	si.uv = vertex.TextureCoordinate;
 
-	si.Instance = Instance;
+	si.InstanceID  = Hit.InstanceID;
+	si.GeometryID  = Hit.GeometryID;
+	si.PrimitiveID = Hit.PrimitiveID;
 
 	// Compute geometry basis and shading basis
 	si.GeometryFrame = si.ShadingFrame = Frame(n);
@@ -124,47 +264,69 @@ std::optional<SurfaceInteraction> Scene::Intersect(const RayDesc& Ray) const
 		si.ShadingFrame = Frame(Ns);
 	}
 
-	// Update BSDF's internal data
-	si.BSDF = GeometryDesc.BSDF.Clone();
+	// Update BSDF's internal data, the BxDF stays owned by the material table
+	if (GeometryDesc.HasMaterial())
+	{
+		si.BSDF.SetBxDF(Materials[GeometryDesc.MaterialID]);
+	}
 	si.BSDF.SetInteraction(si);
+	si.AreaLight = GetAreaLight(Hit);
 
 	return si;
 }
 
-bool Scene::Occluded(const RayDesc& Ray) const
+Interaction Scene::GetInteraction(const RayDesc& Ray, const RayHit& Hit) const
 {
-	RTCIntersectContext RTCIntersectContext;
-	rtcInitIntersectContext(&RTCIntersectContext);
+	if (GetShapeLight(Hit))
+	{
+		return Interaction(Ray.At(Hit.t), -Ray.Direction, Hit.Ng, MediumInterface(Ray.Medium));
+	}
 
-	RTCRay RTCRay = Ray;
+	const auto& Instance	 = TopLevelAccelerationStructure[Hit.InstanceID];
+	const auto& GeometryDesc = (*Instance.BLAS)[Hit.GeometryID];
 
-	// This function sets RTCRay::tfar to -inf if intersection was found
-	rtcOccluded1(TopLevelAccelerationStructure, &RTCIntersectContext, &RTCRay);
+	// Embree reports the geometric normal in object space for instanced geometry
+	Vector3f n;
+	n = DirectX::XMVector3TransformNormal(Hit.Ng.ToXMVECTOR(), Instance.NormalToWorldMatrix());
+	n = normalize(n);
 
-	return RTCRay.tfar == -std::numeric_limits<float>::infinity();
+	MediumInterface mediumInterface =
+		GeometryDesc.MediumInterface.IsMediumTransition() ? GeometryDesc.MediumInterface : MediumInterface(Ray.Medium);
+
+	return Interaction(Ray.At(Hit.t), -Ray.Direction, n, mediumInterface);
 }
 
-bool Scene::IntersectTr(RayDesc ray, Sampler& sampler, Spectrum* OutTr)
+const RAYTRACING_GEOMETRY_DESC& Scene::GetGeometryDesc(const RayHit& Hit) const
 {
-	Spectrum Tr;
+	return (*TopLevelAccelerationStructure[Hit.InstanceID].BLAS)[Hit.GeometryID];
+}
+
+bool Scene::IsOpaque(const RayHit& Hit) const
+{
+	return GetShapeLight(Hit) || GetGeometryDesc(Hit).HasMaterial();
+}
+
+std::optional<SurfaceInteraction> Scene::IntersectTr(RayDesc ray, Sampler& sampler, Spectrum* pTr) const
+{
+	*pTr = Spectrum(1.0f);
 	while (true)
 	{
-		auto isect = Intersect(ray);
+		auto hit = TraceRay(ray);
 		if (ray.Medium)
 		{
-			Tr *= ray.Medium->Tr(ray, sampler);
+			*pTr *= ray.Medium->Tr(ray, sampler);
 		}
 
-		if (!isect)
+		if (!hit)
 		{
-			return false;
+			return std::nullopt;
 		}
-		if (isect->BSDF)
+		if (IsOpaque(*hit))
 		{
-			return true;
+			return GetSurfaceInteraction(ray, *hit);
 		}
 
-		ray = isect->SpawnRay(ray.Direction);
+		ray = GetInteraction(ray, *hit).SpawnRay(ray.Direction);
 	}
 }
 
@@ -178,7 +340,108 @@ void Scene::AddLight(Light* pLight)
 	Lights.push_back(pLight);
 }
 
-void Scene::Generate()
+void Scene::AddLight(ShapeLight* pLight)
+{
+	Lights.push_back(pLight);
+	ShapeLights.push_back(pLight);
+}
+
+void Scene::Generate(LightSamplerType LightSampling /*= LightSamplerType::BVH*/)
 {
+	// The shape lights follow the instances, attaching them in order gives them consecutive geometry IDs
+	for (const ShapeLight* pLight : ShapeLights)
+	{
+		unsigned int GeometryID = TopLevelAccelerationStructure.AddUserGeometry(
+			const_cast<ShapeLight*>(pLight),
+			ShapeLightBounds,
+			ShapeLightIntersect,
+			ShapeLightOccluded);
+		if (pLight == ShapeLights.front())
+		{
+			FirstShapeLightGeometryID = GeometryID;
+		}
+	}
 	TopLevelAccelerationStructure.Generate();
+
+	// Count the emissive triangles first, Lights points into AreaLights so it must not reallocate
+	size_t NumAreaLights = 0;
+	for (size_t i = 0; i < TopLevelAccelerationStructure.GetNumInstances(); ++i)
+	{
+		const auto& BLAS = *TopLevelAccelerationStructure[i].BLAS;
+		for (size_t g = 0; g < BLAS.GetNumGeometries(); ++g)
+		{
+			NumAreaLights += BLAS[g].IsEmissive() ? BLAS[g].NumTriangles : 0;
+		}
+	}
+	AreaLights.reserve(NumAreaLights);
+
+	AreaLightOffsets.resize(TopLevelAccelerationStructure.GetNumInstances());
+	for (size_t i = 0; i < TopLevelAccelerationStructure.GetNumInstances(); ++i)
+	{
+		const auto&		  Instance = TopLevelAccelerationStructure[i];
+		const auto&		  BLAS	   = *Instance.BLAS;
+		DirectX::XMMATRIX mMatrix  = Instance.ObjectToWorldMatrix();
+
+		AreaLightOffsets[i].resize(BLAS.GetNumGeometries());
+		for (size_t g = 0; g < BLAS.GetNumGeometries(); ++g)
+		{
+			const RAYTRACING_GEOMETRY_DESC& GeometryDesc = BLAS[g];
+			AreaLightOffsets[i][g]						 = AreaLights.size();
+			if (!GeometryDesc.IsEmissive())
+			{
+				continue;
+			}
+
+			for (unsigned int t = 0; t < GeometryDesc.NumTriangles; ++t)
+			{
+				Vector3f p[3];
+				for (int v = 0; v < 3; ++v)
+				{
+					const Vertex& vertex = GeometryDesc.pVertices[GeometryDesc.pIndices[t * 3 + v]];
+					p[v]				 = DirectX::XMVector3TransformCoord(vertex.Position.ToXMVECTOR(true), mMatrix);
+				}
+				AreaLights.emplace_back(GeometryDesc.Emission, p[0], p[1], p[2]);
+			}
+		}
+	}
+
+	for (DiffuseAreaLight& AreaLight : AreaLights)
+	{
+		Lights.push_back(&AreaLight);
+	}
+
+	RTCBounds SceneBounds;
+	rtcGetSceneBounds(TopLevelAccelerationStructure, &SceneBounds);
+	Bounds.Min = Vector3f(SceneBounds.lower_x, SceneBounds.lower_y, SceneBounds.lower_z);
+	Bounds.Max = Vector3f(SceneBounds.upper_x, SceneBounds.upper_y, SceneBounds.upper_z);
+	for (Light* pLight : Lights)
+	{
+		pLight->Preprocess(Bounds);
+	}
+	LightSampler		 = CreateLightSampler(LightSampling, Lights, Bounds);
+	EmissionLightSampler = CreateLightSampler(LightSamplerType::Power, Lights, Bounds);
+}
+
+const Light* Scene::GetAreaLight(const RayHit& Hit) const
+{
+	if (const ShapeLight* pLight = GetShapeLight(Hit))
+	{
+		return pLight;
+	}
+
+	const auto& GeometryDesc = (*TopLevelAccelerationStructure[Hit.InstanceID].BLAS)[Hit.GeometryID];
+	if (!GeometryDesc.IsEmissive())
+	{
+		return nullptr;
+	}
+	return &AreaLights[AreaLightOffsets[Hit.InstanceID][Hit.GeometryID] + Hit.PrimitiveID];
+}
+
+const ShapeLight* Scene::GetShapeLight(const RayHit& Hit) const
+{
+	if (Hit.InstanceID != RTC_INVALID_GEOMETRY_ID)
+	{
+		return nullptr;
+	}
+	return ShapeLights[Hit.GeometryID - FirstShapeLightGeometryID];
 }
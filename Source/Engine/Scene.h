@@ -7,6 +7,7 @@
 #include "Interaction.h"
 
 #include "Light/Light.h"
+#include "Light/LightSampler.h"
 
 struct Scene;
 
@@ -23,17 +24,73 @@ struct Scene
 {
 	Scene(const RTXDevice& Device);
 
+	/*
+	 * Two-phase hit API, TraceRay only returns the compact hit record reported by embree,
+	 * the differential geometry is computed on demand for hits that are actually shaded.
+	 * Users that only need the hit point and geometric normal should use GetInteraction which
+	 * skips the vertex fetch and BSDF setup.
+	 */
+	[[nodiscard]] std::optional<RayHit>				TraceRay(const RayDesc& Ray) const;
+	[[nodiscard]] SurfaceInteraction				GetSurfaceInteraction(const RayDesc& Ray, const RayHit& Hit) const;
+	[[nodiscard]] Interaction						GetInteraction(const RayDesc& Ray, const RayHit& Hit) const;
+	// Only valid for hits on instanced geometry, see ShapeLights
+	[[nodiscard]] const RAYTRACING_GEOMETRY_DESC&	GetGeometryDesc(const RayHit& Hit) const;
+	// Surfaces with a material and shape lights block rays, surfaces without a material only delimit media
+	[[nodiscard]] bool								IsOpaque(const RayHit& Hit) const;
+
+	// TraceRay followed by GetSurfaceInteraction
 	[[nodiscard]] std::optional<SurfaceInteraction> Intersect(const RayDesc& Ray) const;
 	[[nodiscard]] bool								Occluded(const RayDesc& Ray) const;
-	[[nodiscard]] bool								IntersectTr(RayDesc ray, Sampler& sampler, Spectrum* OutTr);
+	/*
+	 * Intersect that passes through surfaces without a material (medium boundaries), the transmittance
+	 * of the media the ray travels through up to the hit or out of the scene is written to pTr
+	 */
+	[[nodiscard]] std::optional<SurfaceInteraction> IntersectTr(RayDesc ray, Sampler& sampler, Spectrum* pTr) const;
+
+	/*
+	 * Stream variants of Intersect/Occluded, these trace a whole batch of rays through rtcIntersect1M/rtcOccluded1M
+	 * so embree can use its packet kernels. Results are written back into the RTCRayHit/RTCRay structures.
+	 */
+	void Intersect(std::span<RTCRayHit> RayHits, bool Coherent = false) const;
+	void Occluded(std::span<RTCRay> Rays, bool Coherent = false) const;
 
 	void AddBottomLevelAccelerationStructure(const RAYTRACING_INSTANCE_DESC& Desc);
 
 	void AddLight(Light* pLight);
+	// Shape lights are also added to the scene's geometry, see ShapeLights
+	void AddLight(ShapeLight* pLight);
+
+	/*
+	 * Builds the top level acceleration structure over the instances and the shape lights and creates an area
+	 * light for every triangle of the emissive geometries of every instance, these are appended to Lights. Every
+	 * light is then preprocessed with the scene bounds and the light sampler of the given type is built over all
+	 * of Lights, along with the power based EmissionLightSampler
+	 */
+	void Generate(LightSamplerType LightSampling = LightSamplerType::BVH);
+
+	Camera							Camera;
+	MaterialTable					Materials;
+	TopLevelAccelerationStructure	TopLevelAccelerationStructure;
+	std::vector<Light*>				Lights;
+	/*
+	 * Lights with an analytic surface, also part of Lights. Each is a user geometry of the top level next to the
+	 * instances, hits on it have no instance ID and no material and their area light is the shape light
+	 */
+	std::vector<const ShapeLight*>	ShapeLights;
+	std::unique_ptr<LightSampler>	LightSampler;
+	// Picks the light a path starts from independently of any shading point, for bidirectional methods
+	std::unique_ptr<::LightSampler>	EmissionLightSampler;
+	BoundingBox						Bounds; // World space bounds of the geometry, set in Generate
 
-	void Generate();
+private:
+	// Area light of the triangle or shape light that was hit, null unless its geometry is emissive
+	const Light* GetAreaLight(const RayHit& Hit) const;
+	// Shape light that was hit, null for hits on instanced geometry
+	const ShapeLight* GetShapeLight(const RayHit& Hit) const;
 
-	Camera						  Camera;
-	TopLevelAccelerationStructure TopLevelAccelerationStructure;
-	std::vector<Light*>			  Lights;
+	std::vector<DiffuseAreaLight> AreaLights;
+	// Index of the first area light of every geometry of every instance, indexed by instance then geometry ID
+	std::vector<std::vector<size_t>> AreaLightOffsets;
+	// Geometry ID of the first shape light, the others follow in the order of ShapeLights
+	unsigned int FirstShapeLightGeometryID = RTC_INVALID_GEOMETRY_ID;
 };
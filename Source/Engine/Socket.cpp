@@ -0,0 +1,229 @@
+#include "Socket.h"
+
+#include <algorithm>
+#include <utility>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using socklen_t = int;
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+// Winsock has to be initialized once per process before any other call
+static bool InitializeSockets()
+{
+	struct WinsockInstance
+	{
+		WinsockInstance()
+		{
+			WSADATA Data = {};
+			Initialized	 = WSAStartup(MAKEWORD(2, 2), &Data) == 0;
+		}
+		~WinsockInstance()
+		{
+			if (Initialized)
+			{
+				WSACleanup();
+			}
+		}
+
+		bool Initialized = false;
+	};
+	static WinsockInstance Instance;
+	return Instance.Initialized;
+}
+
+static void CloseNativeHandle(Socket::NativeHandle Handle)
+{
+	closesocket(Handle);
+}
+#else
+static bool InitializeSockets()
+{
+	return true;
+}
+
+static void CloseNativeHandle(Socket::NativeHandle Handle)
+{
+	close(Handle);
+}
+#endif
+
+// Tiles are small request/response messages, Nagle's algorithm would only add latency
+static void DisableNagle(Socket::NativeHandle Handle)
+{
+	int Enable = 1;
+	setsockopt(Handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&Enable), sizeof(Enable));
+}
+
+Socket::Socket(Socket&& rhs) noexcept
+	: Handle(std::exchange(rhs.Handle, InvalidHandle))
+{
+}
+
+Socket& Socket::operator=(Socket&& rhs) noexcept
+{
+	if (this != &rhs)
+	{
+		Close();
+		Handle = std::exchange(rhs.Handle, InvalidHandle);
+	}
+	return *this;
+}
+
+Socket::~Socket()
+{
+	Close();
+}
+
+Socket Socket::Listen(unsigned short Port)
+{
+	if (!InitializeSockets())
+	{
+		return Socket();
+	}
+
+	Socket Listener(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+	if (!Listener)
+	{
+		return Socket();
+	}
+
+	int Reuse = 1;
+	setsockopt(Listener.Handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&Reuse), sizeof(Reuse));
+
+	sockaddr_in Address		= {};
+	Address.sin_family		= AF_INET;
+	Address.sin_addr.s_addr = htonl(INADDR_ANY);
+	Address.sin_port		= htons(Port);
+	if (bind(Listener.Handle, reinterpret_cast<const sockaddr*>(&Address), sizeof(Address)) != 0 ||
+		listen(Listener.Handle, SOMAXCONN) != 0)
+	{
+		return Socket();
+	}
+	return Listener;
+}
+
+Socket Socket::Connect(const std::string& Address, unsigned short Port)
+{
+	if (!InitializeSockets())
+	{
+		return Socket();
+	}
+
+	addrinfo Hints	  = {};
+	Hints.ai_family	  = AF_UNSPEC;
+	Hints.ai_socktype = SOCK_STREAM;
+	Hints.ai_protocol = IPPROTO_TCP;
+
+	addrinfo* pAddresses = nullptr;
+	if (getaddrinfo(Address.c_str(), std::to_string(Port).c_str(), &Hints, &pAddresses) != 0)
+	{
+		return Socket();
+	}
+
+	Socket Connection;
+	for (addrinfo* pAddress = pAddresses; pAddress; pAddress = pAddress->ai_next)
+	{
+		Socket Candidate(socket(pAddress->ai_family, pAddress->ai_socktype, pAddress->ai_protocol));
+		if (Candidate && connect(Candidate.Handle, pAddress->ai_addr, socklen_t(pAddress->ai_addrlen)) == 0)
+		{
+			DisableNagle(Candidate.Handle);
+			Connection = std::move(Candidate);
+			break;
+		}
+	}
+	freeaddrinfo(pAddresses);
+	return Connection;
+}
+
+Socket Socket::Accept() const
+{
+	Socket Connection(accept(Handle, nullptr, nullptr));
+	if (Connection)
+	{
+		DisableNagle(Connection.Handle);
+	}
+	return Connection;
+}
+
+bool Socket::WaitReadable(int TimeoutMs) const
+{
+	fd_set ReadSet;
+	FD_ZERO(&ReadSet);
+	FD_SET(Handle, &ReadSet);
+
+	timeval Timeout = {};
+	Timeout.tv_sec	= TimeoutMs / 1000;
+	Timeout.tv_usec = (TimeoutMs % 1000) * 1000;
+	return select(int(Handle + 1), &ReadSet, nullptr, nullptr, &Timeout) > 0;
+}
+
+bool Socket::SetTimeout(int TimeoutMs) const
+{
+#ifdef _WIN32
+	DWORD Timeout = DWORD(TimeoutMs);
+#else
+	timeval Timeout = {};
+	Timeout.tv_sec	= TimeoutMs / 1000;
+	Timeout.tv_usec = (TimeoutMs % 1000) * 1000;
+#endif
+	const char* pTimeout = reinterpret_cast<const char*>(&Timeout);
+	return setsockopt(Handle, SOL_SOCKET, SO_RCVTIMEO, pTimeout, sizeof(Timeout)) == 0 &&
+		   setsockopt(Handle, SOL_SOCKET, SO_SNDTIMEO, pTimeout, sizeof(Timeout)) == 0;
+}
+
+bool Socket::Send(const void* pData, size_t Size) const
+{
+	const char* pBytes = static_cast<const char*>(pData);
+	while (Size > 0)
+	{
+		int Chunk = int(std::min<size_t>(Size, 1 << 20));
+#ifdef _WIN32
+		int Sent = send(Handle, pBytes, Chunk, 0);
+#else
+		int Sent = int(send(Handle, pBytes, size_t(Chunk), MSG_NOSIGNAL));
+#endif
+		if (Sent <= 0)
+		{
+			return false;
+		}
+		pBytes += Sent;
+		Size -= size_t(Sent);
+	}
+	return true;
+}
+
+bool Socket::Receive(void* pData, size_t Size) const
+{
+	char* pBytes = static_cast<char*>(pData);
+	while (Size > 0)
+	{
+		int Chunk = int(std::min<size_t>(Size, 1 << 20));
+		int Received = int(recv(Handle, pBytes, Chunk, 0));
+		if (Received <= 0)
+		{
+			return false;
+		}
+		pBytes += Received;
+		Size -= size_t(Received);
+	}
+	return true;
+}
+
+void Socket::Close()
+{
+	if (Handle != InvalidHandle)
+	{
+		CloseNativeHandle(Handle);
+		Handle = InvalidHandle;
+	}
+}
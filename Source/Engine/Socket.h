@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+/*
+ *	Minimal blocking TCP socket on top of Winsock or BSD sockets, just enough for the distributed
+ *	render protocol. Send and Receive transfer the whole buffer or fail.
+ */
+class Socket
+{
+public:
+#ifdef _WIN32
+	using NativeHandle = unsigned long long; // SOCKET
+	static constexpr NativeHandle InvalidHandle = ~0ull;
+#else
+	using NativeHandle = int;
+	static constexpr NativeHandle InvalidHandle = -1;
+#endif
+
+	Socket() noexcept = default;
+	explicit Socket(NativeHandle Handle) noexcept
+		: Handle(Handle)
+	{
+	}
+	Socket(Socket&& rhs) noexcept;
+	Socket& operator=(Socket&& rhs) noexcept;
+	~Socket();
+
+	Socket(const Socket&) = delete;
+	Socket& operator=(const Socket&) = delete;
+
+	explicit operator bool() const noexcept { return Handle != InvalidHandle; }
+
+	// Listens on all interfaces, returns an invalid socket on failure
+	static Socket Listen(unsigned short Port);
+	// Address is a host name or numeric address, returns an invalid socket on failure
+	static Socket Connect(const std::string& Address, unsigned short Port);
+
+	Socket Accept() const;
+	// Waits at most TimeoutMs milliseconds for the socket to become readable (or a connection to arrive)
+	bool WaitReadable(int TimeoutMs) const;
+	// Send and Receive fail once they made no progress for TimeoutMs milliseconds, 0 waits forever
+	bool SetTimeout(int TimeoutMs) const;
+
+	bool Send(const void* pData, size_t Size) const;
+	bool Receive(void* pData, size_t Size) const;
+
+	template<typename T>
+	bool Send(const T& Value) const
+	{
+		return Send(&Value, sizeof(T));
+	}
+
+	template<typename T>
+	bool Receive(T& Value) const
+	{
+		return Receive(&Value, sizeof(T));
+	}
+
+	void Close();
+
+private:
+	NativeHandle Handle = InvalidHandle;
+};
@@ -0,0 +1,193 @@
+#include "TaskScheduler.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+TaskScheduler::TaskScheduler(unsigned int NumWorkers /*= 0*/, bool PinThreads /*= false*/)
+	: NumWorkers(NumWorkers != 0 ? NumWorkers : std::max(1u, std::thread::hardware_concurrency()))
+	, Queues(std::make_unique<WorkQueue[]>(this->NumWorkers))
+{
+	Threads.reserve(this->NumWorkers);
+	for (unsigned int i = 0; i < this->NumWorkers; ++i)
+	{
+		Threads.emplace_back(
+			[this, i, PinThreads]()
+			{
+				// Pinned before the first task so no task runs, and allocates its memory, on the wrong processor
+				if (PinThreads)
+				{
+					PinCurrentThread(i);
+				}
+				WorkerThread(i);
+			});
+	}
+}
+
+TaskScheduler::~TaskScheduler()
+{
+	{
+		std::scoped_lock _(Mutex);
+		Shutdown = true;
+	}
+	WakeCondition.notify_all();
+
+	for (auto& Thread : Threads)
+	{
+		Thread.join();
+	}
+}
+
+void TaskScheduler::ParallelFor(size_t Count, const TaskFunction& Task)
+{
+	if (Count == 0)
+	{
+		return;
+	}
+
+	{
+		std::scoped_lock _(Mutex);
+		pTask		 = &Task;
+		NumRemaining = Count;
+
+		// Give each worker a contiguous range of indices so spatially close tasks stay on one worker
+		for (unsigned int i = 0; i < NumWorkers; ++i)
+		{
+			size_t Begin = Count * i / NumWorkers;
+			size_t End	 = Count * (i + 1) / NumWorkers;
+
+			std::scoped_lock QueueLock(Queues[i].Mutex);
+			for (size_t Index = Begin; Index < End; ++Index)
+			{
+				Queues[i].Tasks.push_back(Index);
+			}
+		}
+
+		Generation++;
+	}
+	WakeCondition.notify_all();
+
+	std::unique_lock Lock(Mutex);
+	DoneCondition.wait(
+		Lock,
+		[this]()
+		{
+			return NumRemaining == 0;
+		});
+	pTask = nullptr;
+}
+
+void TaskScheduler::WorkerThread(unsigned int WorkerIndex)
+{
+	unsigned long long SeenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock Lock(Mutex);
+			WakeCondition.wait(
+				Lock,
+				[&]()
+				{
+					return Shutdown || Generation != SeenGeneration;
+				});
+			if (Shutdown)
+			{
+				return;
+			}
+			SeenGeneration = Generation;
+		}
+
+		// A worker can still be draining when the next ParallelFor is issued, so the task is looked up after
+		// every successful pop. The queue mutex orders it after the store in ParallelFor
+		size_t Index;
+		while (Pop(WorkerIndex, &Index) || Steal(WorkerIndex, &Index))
+		{
+			(*pTask.load(std::memory_order_relaxed))(Index, WorkerIndex);
+
+			if (NumRemaining.fetch_sub(1) == 1)
+			{
+				std::scoped_lock _(Mutex);
+				DoneCondition.notify_all();
+			}
+		}
+	}
+}
+
+bool TaskScheduler::Pop(unsigned int WorkerIndex, size_t* pIndex)
+{
+	WorkQueue&		 Queue = Queues[WorkerIndex];
+	std::scoped_lock _(Queue.Mutex);
+	if (Queue.Tasks.empty())
+	{
+		return false;
+	}
+
+	*pIndex = Queue.Tasks.front();
+	Queue.Tasks.pop_front();
+	return true;
+}
+
+bool TaskScheduler::Steal(unsigned int WorkerIndex, size_t* pIndex)
+{
+	// Visit neighbouring workers first, their ranges are the closest to ours
+	for (unsigned int i = 1; i < NumWorkers; ++i)
+	{
+		WorkQueue&		 Victim = Queues[(WorkerIndex + i) % NumWorkers];
+		std::scoped_lock _(Victim.Mutex);
+		if (!Victim.Tasks.empty())
+		{
+			*pIndex = Victim.Tasks.back();
+			Victim.Tasks.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
+
+void TaskScheduler::PinCurrentThread(unsigned int Processor)
+{
+#ifdef _WIN32
+	// Logical processors are numbered across processor groups, each group holds at most 64 of them
+	WORD  NumGroups		= GetActiveProcessorGroupCount();
+	DWORD NumProcessors = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+	Processor %= std::max(DWORD(1), NumProcessors);
+
+	GROUP_AFFINITY Affinity = {};
+	for (WORD Group = 0; Group < NumGroups; ++Group)
+	{
+		DWORD GroupSize = GetActiveProcessorCount(Group);
+		if (Processor < GroupSize)
+		{
+			Affinity.Group = Group;
+			Affinity.Mask  = KAFFINITY(1) << Processor;
+			SetThreadGroupAffinity(GetCurrentThread(), &Affinity, nullptr);
+			return;
+		}
+		Processor -= GroupSize;
+	}
+#else
+	// Worker i goes to the i-th processor the process may run on
+	cpu_set_t Allowed;
+	CPU_ZERO(&Allowed);
+	if (sched_getaffinity(0, sizeof(cpu_set_t), &Allowed) != 0 || CPU_COUNT(&Allowed) == 0)
+	{
+		return;
+	}
+	Processor %= unsigned(CPU_COUNT(&Allowed));
+
+	for (int Cpu = 0; Cpu < CPU_SETSIZE; ++Cpu)
+	{
+		if (CPU_ISSET(Cpu, &Allowed) && Processor-- == 0)
+		{
+			cpu_set_t CpuSet;
+			CPU_ZERO(&CpuSet);
+			CPU_SET(Cpu, &CpuSet);
+			pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &CpuSet);
+			return;
+		}
+	}
+#endif
+}
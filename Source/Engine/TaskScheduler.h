@@ -0,0 +1,63 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Work-stealing task scheduler built on std::thread.
+ * Every worker owns a deque of task indices, a ParallelFor hands each worker a contiguous range of
+ * indices so neighbouring tasks (e.g. neighbouring tiles) run on the same worker. Workers pop from the
+ * front of their own deque and, once it is empty, steal from the back of other workers' deques.
+ */
+class TaskScheduler
+{
+public:
+	using TaskFunction = std::function<void(size_t Index, unsigned int WorkerIndex)>;
+
+	/*
+	 *	NumWorkers of 0 uses every hardware thread, PinThreads binds worker i to logical processor i (modulo the
+	 *	processor count, on Windows counted across processor groups)
+	 */
+	TaskScheduler(unsigned int NumWorkers = 0, bool PinThreads = false);
+	~TaskScheduler();
+
+	TaskScheduler(const TaskScheduler&) = delete;
+	TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+	unsigned int GetNumWorkers() const noexcept { return NumWorkers; }
+
+	// Runs Task for every index in [0, Count) on the workers and blocks until all tasks finished
+	void ParallelFor(size_t Count, const TaskFunction& Task);
+
+private:
+	struct alignas(64) WorkQueue
+	{
+		std::mutex		   Mutex;
+		std::deque<size_t> Tasks;
+	};
+
+	void WorkerThread(unsigned int WorkerIndex);
+
+	bool Pop(unsigned int WorkerIndex, size_t* pIndex);
+	bool Steal(unsigned int WorkerIndex, size_t* pIndex);
+
+	static void PinCurrentThread(unsigned int Processor);
+
+	unsigned int				 NumWorkers;
+	std::vector<std::thread>	 Threads;
+	std::unique_ptr<WorkQueue[]> Queues;
+
+	std::mutex				Mutex;
+	std::condition_variable WakeCondition;
+	std::condition_variable DoneCondition;
+	unsigned long long		Generation = 0;
+	bool					Shutdown   = false;
+
+	std::atomic<const TaskFunction*> pTask		  = nullptr;
+	std::atomic<size_t>				 NumRemaining = 0;
+};
@@ -1,6 +1,8 @@
 #pragma once
 #include <memory>
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <DirectXMath.h>
 
 template<typename T>
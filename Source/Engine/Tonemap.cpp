@@ -0,0 +1,255 @@
+#include "Tonemap.h"
+#include "Texture2D.h"
+#include "TaskScheduler.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace DirectX;
+
+/*
+ *	sRGB transfer function sampled at 64 points per octave over [2^-13, 1], a value is looked up by the
+ *	exponent and top mantissa bits of its float and interpolated with the remaining mantissa bits. Below
+ *	2^-13 the function is linear anyway
+ */
+class SRGBTable
+{
+public:
+	static constexpr int	  MantissaBits = 6;
+	static constexpr int	  MinExponent  = -13;
+	static constexpr int	  NumEntries   = -MinExponent << MantissaBits;
+	static constexpr uint32_t MinBits	   = uint32_t(127 + MinExponent) << 23;
+	static constexpr float	  MinValue	   = 1.0f / 8192.0f;
+	// Mantissa bits below the ones of the index, they interpolate between two entries
+	static constexpr int	  FractionBits = 23 - MantissaBits;
+	static constexpr uint32_t FractionMask = (1u << FractionBits) - 1;
+
+	SRGBTable()
+	{
+		for (int i = 0; i < NumEntries; ++i)
+		{
+			float Linear = std::ldexp(
+				1.0f + float(i & ((1 << MantissaBits) - 1)) / float(1 << MantissaBits),
+				MinExponent + (i >> MantissaBits));
+			Values[i] = Evaluate(Linear);
+		}
+		Values[NumEntries] = 1.0f;
+	}
+
+	float operator()(float Linear) const
+	{
+		if (!(Linear > MinValue))
+		{
+			return Linear > 0.0f ? 12.92f * Linear : 0.0f;
+		}
+		if (Linear >= 1.0f)
+		{
+			return 1.0f;
+		}
+
+		uint32_t Bits;
+		memcpy(&Bits, &Linear, sizeof(Bits));
+		const uint32_t Offset	= Bits - MinBits;
+		const uint32_t Index	= Offset >> FractionBits;
+		const float	   Fraction = float(Offset & FractionMask) * (1.0f / float(1u << FractionBits));
+		return Values[Index] + (Values[Index + 1] - Values[Index]) * Fraction;
+	}
+
+	/*
+	 *	Same lookup for four values, the index and fraction are taken from the bits on the vector and only
+	 *	the table entries are gathered one by one
+	 */
+	XMVECTOR operator()(FXMVECTOR Linear) const
+	{
+		// Clamped to [MinValue, largest float below 1] so every lane has a valid index
+		const XMVECTOR x = XMVectorClamp(Linear, XMVectorReplicate(MinValue), XMVectorReplicateInt(0x3f7fffff));
+
+		// The high bits are a multiple of 2^FractionBits below 2^30, they convert to float exactly
+		const XMVECTOR HighBits = XMVectorAndInt(x, XMVectorReplicateInt(~FractionMask));
+		const XMVECTOR Index	= XMVectorSubtract(
+			   XMConvertVectorUIntToFloat(HighBits, FractionBits), XMVectorReplicate(float(MinBits >> FractionBits)));
+		const XMVECTOR Fraction =
+			XMConvertVectorUIntToFloat(XMVectorAndInt(x, XMVectorReplicateInt(FractionMask)), FractionBits);
+
+		XMUINT4 i;
+		XMStoreUInt4(&i, XMConvertVectorFloatToUInt(Index, 0));
+		const XMVECTOR Lower = XMVectorSet(Values[i.x], Values[i.y], Values[i.z], Values[i.w]);
+		const XMVECTOR Upper = XMVectorSet(Values[i.x + 1], Values[i.y + 1], Values[i.z + 1], Values[i.w + 1]);
+		XMVECTOR	   Result = XMVectorMultiplyAdd(XMVectorSubtract(Upper, Lower), Fraction, Lower);
+
+		const XMVECTOR Linear12 = XMVectorScale(XMVectorMax(Linear, XMVectorZero()), 12.92f);
+		Result = XMVectorSelect(Result, Linear12, XMVectorLessOrEqual(Linear, XMVectorReplicate(MinValue)));
+		return XMVectorSelect(Result, XMVectorSplatOne(), XMVectorGreaterOrEqual(Linear, XMVectorSplatOne()));
+	}
+
+private:
+	static float Evaluate(float Linear)
+	{
+		if (Linear <= 0.0031308f)
+		{
+			return 12.92f * Linear;
+		}
+		return 1.055f * std::pow(Linear, 1.0f / 2.4f) - 0.055f;
+	}
+
+	float Values[NumEntries + 1];
+};
+
+static const SRGBTable& GetSRGBTable()
+{
+	static const SRGBTable Table;
+	return Table;
+}
+
+float LinearToSRGB(float Linear)
+{
+	return GetSRGBTable()(Linear);
+}
+
+static XMVECTOR ApplyACES(FXMVECTOR Linear)
+{
+	const XMVECTOR x = XMVectorScale(Linear, 0.6f);
+	const XMVECTOR Numerator =
+		XMVectorMultiply(x, XMVectorMultiplyAdd(x, XMVectorReplicate(2.51f), XMVectorReplicate(0.03f)));
+	const XMVECTOR Denominator = XMVectorMultiplyAdd(
+		x, XMVectorMultiplyAdd(x, XMVectorReplicate(2.43f), XMVectorReplicate(0.59f)), XMVectorReplicate(0.14f));
+	return XMVectorDivide(Numerator, Denominator);
+}
+
+static XMVECTOR HableCurve(FXMVECTOR x)
+{
+	constexpr float A = 0.15f, B = 0.50f, C = 0.10f, D = 0.20f, E = 0.02f, F = 0.30f;
+
+	const XMVECTOR Numerator = XMVectorMultiplyAdd(
+		x, XMVectorMultiplyAdd(x, XMVectorReplicate(A), XMVectorReplicate(C * B)), XMVectorReplicate(D * E));
+	const XMVECTOR Denominator = XMVectorMultiplyAdd(
+		x, XMVectorMultiplyAdd(x, XMVectorReplicate(A), XMVectorReplicate(B)), XMVectorReplicate(D * F));
+	return XMVectorSubtract(XMVectorDivide(Numerator, Denominator), XMVectorReplicate(E / F));
+}
+
+static XMVECTOR ApplyFilmic(FXMVECTOR Linear)
+{
+	// Exposure bias of 2 and white point of 11.2 from Hable's presentation
+	static const float InvWhiteScale = 1.0f / XMVectorGetX(HableCurve(XMVectorReplicate(11.2f)));
+	return XMVectorScale(HableCurve(XMVectorScale(Linear, 2.0f)), InvWhiteScale);
+}
+
+// The curves work on every lane on its own, so Color may hold one RGB value or one channel of four pixels
+static XMVECTOR ApplyCurve(ToneCurve Curve, FXMVECTOR Color)
+{
+	switch (Curve)
+	{
+	case ToneCurve::ACES:
+		return ApplyACES(Color);
+	case ToneCurve::Filmic:
+		return ApplyFilmic(Color);
+	default:
+		return Color;
+	}
+}
+
+template<typename T>
+static void TonemapImage(
+	const Texture2D<RGBSpectrum>& Image,
+	const TonemapDesc&			  Desc,
+	std::span<T>				  Output,
+	TaskScheduler*				  pScheduler)
+{
+	constexpr float MaxValue = float(std::numeric_limits<T>::max());
+
+	const int	   Width	= int(Image.Width);
+	const int	   Height	= int(Image.Height);
+	const XMVECTOR Exposure = XMVectorReplicate(std::exp2(Desc.Exposure));
+
+	const SRGBTable& SRGB	  = GetSRGBTable();
+	const XMVECTOR	 Scale	  = XMVectorReplicate(MaxValue);
+	const XMVECTOR	 Rounding = XMVectorReplicate(0.5f);
+
+	auto TonemapRow = [&](int Row)
+	{
+		// Textures store the bottom row first
+		const RGBSpectrum* pSrc = &Image.Pixels[size_t(Height - 1 - Row) * Width];
+		T*				   pDst = &Output[size_t(Row) * Width * 3];
+
+		// Four pixels at a time, transposed from RGB triplets (AoS) to one vector per channel (SoA)
+		int x = 0;
+		for (; x + 4 <= Width; x += 4)
+		{
+			const XMFLOAT4* pFloats = reinterpret_cast<const XMFLOAT4*>(&pSrc[x]);
+			const XMVECTOR	v0		= XMLoadFloat4(pFloats);	 // r0 g0 b0 r1
+			const XMVECTOR	v1		= XMLoadFloat4(pFloats + 1); // g1 b1 r2 g2
+			const XMVECTOR	v2		= XMLoadFloat4(pFloats + 2); // b2 r3 g3 b3
+
+			// A channel of the first three pixels (or two for B) comes from v0 and v1, the rest from v2
+			const XMVECTOR Channels[3] = {
+				XMVectorPermute<XM_PERMUTE_0X, XM_PERMUTE_0Y, XM_PERMUTE_0Z, XM_PERMUTE_1Y>(
+					XMVectorPermute<XM_PERMUTE_0X, XM_PERMUTE_0W, XM_PERMUTE_1Z, XM_PERMUTE_1Z>(v0, v1), v2),
+				XMVectorPermute<XM_PERMUTE_0X, XM_PERMUTE_0Y, XM_PERMUTE_0Z, XM_PERMUTE_1Z>(
+					XMVectorPermute<XM_PERMUTE_0Y, XM_PERMUTE_1X, XM_PERMUTE_1W, XM_PERMUTE_1W>(v0, v1), v2),
+				XMVectorPermute<XM_PERMUTE_0X, XM_PERMUTE_0Y, XM_PERMUTE_1X, XM_PERMUTE_1W>(
+					XMVectorPermute<XM_PERMUTE_0Z, XM_PERMUTE_1Y, XM_PERMUTE_1Y, XM_PERMUTE_1Y>(v0, v1), v2)
+			};
+
+			XMUINT4 Quantized[3];
+			for (int c = 0; c < 3; ++c)
+			{
+				XMVECTOR Color = XMVectorMax(XMVectorMultiply(Channels[c], Exposure), XMVectorZero());
+				Color		   = SRGB(XMVectorSaturate(ApplyCurve(Desc.Curve, Color)));
+				XMStoreUInt4(&Quantized[c], XMConvertVectorFloatToUInt(XMVectorMultiplyAdd(Color, Scale, Rounding), 0));
+			}
+
+			for (int i = 0; i < 4; ++i)
+			{
+				pDst[0] = T((&Quantized[0].x)[i]);
+				pDst[1] = T((&Quantized[1].x)[i]);
+				pDst[2] = T((&Quantized[2].x)[i]);
+				pDst += 3;
+			}
+		}
+
+		// Pixels left over at the end of the row
+		for (; x < Width; ++x)
+		{
+			XMVECTOR Color = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&pSrc[x]));
+			Color		   = XMVectorMax(XMVectorMultiply(Color, Exposure), XMVectorZero());
+
+			XMFLOAT3 Display;
+			XMStoreFloat3(&Display, XMVectorSaturate(ApplyCurve(Desc.Curve, Color)));
+			pDst[0] = T(LinearToSRGB(Display.x) * MaxValue + 0.5f);
+			pDst[1] = T(LinearToSRGB(Display.y) * MaxValue + 0.5f);
+			pDst[2] = T(LinearToSRGB(Display.z) * MaxValue + 0.5f);
+			pDst += 3;
+		}
+	};
+
+	if (pScheduler)
+	{
+		pScheduler->ParallelFor(Height, [&](size_t Row, unsigned int) { TonemapRow(int(Row)); });
+	}
+	else
+	{
+		for (int Row = 0; Row < Height; ++Row)
+		{
+			TonemapRow(Row);
+		}
+	}
+}
+
+void Tonemap(
+	const Texture2D<RGBSpectrum>& Image,
+	const TonemapDesc&			  Desc,
+	std::span<uint8_t>			  Output,
+	TaskScheduler*				  pScheduler /*= nullptr*/)
+{
+	TonemapImage(Image, Desc, Output, pScheduler);
+}
+
+void Tonemap(
+	const Texture2D<RGBSpectrum>& Image,
+	const TonemapDesc&			  Desc,
+	std::span<uint16_t>			  Output,
+	TaskScheduler*				  pScheduler /*= nullptr*/)
+{
+	TonemapImage(Image, Desc, Output, pScheduler);
+}
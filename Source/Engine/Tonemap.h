@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include "Spectrum.h"
+
+template<typename T>
+struct Texture2D;
+
+class TaskScheduler;
+
+enum class ToneCurve
+{
+	Clamp,	// Values above 1 are clipped
+	ACES,	// Narkowicz's fit of the ACES reference rendering transform
+	Filmic	// Hable's filmic curve, as used in Uncharted 2
+};
+
+struct TonemapDesc
+{
+	ToneCurve Curve = ToneCurve::Clamp;
+	// Exposure adjustment in stops applied before the curve
+	float Exposure = 0.0f;
+};
+
+/*
+ *	Maps linear radiance to sRGB encoded display values quantized to 8 or 16 bits per channel. Output holds
+ *	the RGB values of the rows top to bottom, the order image files store them in. Rows are transposed to one
+ *	DirectXMath vector per channel of four pixels, only the pixels at the end of a row that don't fill a vector
+ *	go one at a time. The sRGB transfer function is a table interpolated on the bits of the float, which is
+ *	exact to well below 16-bit precision. Rows are distributed over the scheduler if there is one
+ */
+void Tonemap(
+	const Texture2D<RGBSpectrum>& Image,
+	const TonemapDesc&			  Desc,
+	std::span<uint8_t>			  Output,
+	TaskScheduler*				  pScheduler = nullptr);
+void Tonemap(
+	const Texture2D<RGBSpectrum>& Image,
+	const TonemapDesc&			  Desc,
+	std::span<uint16_t>			  Output,
+	TaskScheduler*				  pScheduler = nullptr);
+
+// sRGB transfer function of a linear value in [0, 1]
+float LinearToSRGB(float Linear);
@@ -9,6 +9,13 @@ struct Vertex
 		Normal = XMVector3TransformNormal(Normal.ToXMVECTOR(), M);
 	}
 
+	// Normals are transformed by the inverse transpose of M
+	void TransformToWorld(DirectX::XMMATRIX M, DirectX::XMMATRIX NormalMatrix)
+	{
+		Position = XMVector3TransformCoord(Position.ToXMVECTOR(true), M);
+		Normal = XMVector3TransformNormal(Normal.ToXMVECTOR(), NormalMatrix);
+	}
+
 	Vector3f Position;
 	Vector2f TextureCoordinate;
 	Vector3f Normal;
@@ -25,6 +25,11 @@
 #include "Integrator/AOIntegrator.h"
 #include "Integrator/PathIntegrator.h"
 #include "Integrator/VolPathIntegrator.h"
+#include "Integrator/WavefrontPathIntegrator.h"
+#include "Integrator/BDPTIntegrator.h"
+
+#include <cctype>
+#include <string_view>
 
 int main(int argc, char** argv)
 {
@@ -42,22 +47,22 @@ int main(int argc, char** argv)
 	Scene.Camera.Transform.Rotate(DirectX::XMConvertToRadians(30.0f), 0, 0);
 
 	BottomLevelAccelerationStructure BreakfastRoom(Device);
-	BreakfastRoom.AddGeometry(ModelFolderPath / "breakfast_room" / "breakfast_room.obj");
+	BreakfastRoom.AddGeometry(ModelFolderPath / "breakfast_room" / "breakfast_room.obj", Scene.Materials);
 	BreakfastRoom.Generate();
 
 	auto& leftLamp	= BreakfastRoom[2];
 	auto& rightLamp = BreakfastRoom[0];
 	auto& teapot	= BreakfastRoom[16];
 
-	std::shared_ptr<LambertianReflection> diffuse = std::make_shared<LambertianReflection>(Spectrum(1.0f));
-	std::shared_ptr<Disney> disney = std::make_shared<Disney>();
-	std::shared_ptr<Mirror> mirror = std::make_shared<Mirror>(Spectrum(0.9f));
+	unsigned int diffuse = Scene.Materials.Create<LambertianReflection>(Spectrum(1.0f));
+	unsigned int disney	 = Scene.Materials.Create<Disney>();
+	unsigned int mirror	 = Scene.Materials.Create<Mirror>(Spectrum(0.9f));
 
 	HomogeneousMedium hm0(Spectrum(0.02f), Spectrum(0.1f), 1.0f);
 
-	leftLamp.BSDF.SetBxDF(disney);
-	rightLamp.BSDF.SetBxDF(disney);
-	teapot.BSDF.SetBxDF(diffuse);
+	leftLamp.MaterialID	 = disney;
+	rightLamp.MaterialID = disney;
+	teapot.MaterialID	 = diffuse;
 	teapot.MediumInterface = MediumInterface(&hm0, nullptr);
 
 	RAYTRACING_INSTANCE_DESC BreakfastRoomInstance = {};
@@ -70,11 +75,28 @@ int main(int argc, char** argv)
 	PL0.Transform.Translate(3, 15, 20);
 	Scene.AddLight(&PL0);
 
+	// ImageInfiniteLight Sky(ExecutableFolderPath / "Assets/Environment/sky.hdr");
+	// Scene.AddLight(&Sky);
+
+	// The sun subtends about half a degree, its disk gives soft shadows
+	// DistantLight Sun(Spectrum(3.0f), DirectX::XMConvertToRadians(0.27f));
+	// Sun.Transform.Rotate(DirectX::XMConvertToRadians(60.0f), 0, 0);
+	// Scene.AddLight(&Sun);
+
+	RenderOptions Options = {};
+	Options.Width		  = 1920;
+	Options.Height		  = 1080;
+	// Options.CropWindow[0] = 0.25f; Options.CropWindow[2] = 0.75f;
+	// Options.PixelRegion	  = { 600, 100, 900, 400 };
+	// Options.Filter = { FilterType::Gaussian, 1.5f };
+	// Options.OutputPath = "Render.exr";
+	// Options.AOVs.Albedo = Options.AOVs.Normal = Options.AOVs.Depth = true;
+
 	//int NumSamplesPerPixel = 32;
 	int NumSamplesPerPixel = 32;
 
 	Random Sampler(NumSamplesPerPixel);
-	//Sobol Sampler(NumSamplesPerPixel, Integrator::Width, Integrator::Height);
+	//Sobol Sampler(NumSamplesPerPixel, Options.Width, Options.Height);
 
 	// auto Integrator = CreateNormalIntegrator(Shading);
 
@@ -85,7 +107,54 @@ int main(int argc, char** argv)
 	int	 MaxDepth	= 10000;
 	auto Integrator = CreateVolPathIntegrator(MaxDepth);
 	// auto Integrator = CreatePathIntegrator(MaxDepth);
-
-	Integrator->Initialize(Scene);
+	// auto Integrator = CreateWavefrontPathIntegrator(MaxDepth);
+	// auto Integrator = CreateBDPTIntegrator(MaxDepth);
+
+	Options.SamplesPerPass = 4;
+
+	// Options.CheckpointPath = "Render.checkpoint";
+	Options.Resume = true;
+
+	// Distributed rendering: KHRay --coordinator [port] or KHRay --worker <address> [port]
+	// --benchmark [max threads] times a few passes at increasing thread counts instead of rendering the image
+	bool		 RunBenchmark		= false;
+	unsigned int BenchmarkMaxThreads = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		auto ParsePort = [&]()
+		{
+			if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+			{
+				Options.Port = static_cast<unsigned short>(std::stoi(argv[++i]));
+			}
+		};
+
+		std::string_view Argument = argv[i];
+		if (Argument == "--coordinator")
+		{
+			Options.Mode = RenderMode::Coordinator;
+			ParsePort();
+		}
+		else if (Argument == "--worker" && i + 1 < argc)
+		{
+			Options.Mode			   = RenderMode::Worker;
+			Options.CoordinatorAddress = argv[++i];
+			ParsePort();
+		}
+		else if (Argument == "--benchmark")
+		{
+			RunBenchmark = true;
+			if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+			{
+				BenchmarkMaxThreads = static_cast<unsigned int>(std::stoi(argv[++i]));
+			}
+		}
+	}
+
+	Integrator->Initialize(Scene, Options);
+	if (RunBenchmark)
+	{
+		return Integrator->Benchmark(Scene, Sampler, BenchmarkMaxThreads);
+	}
 	return Integrator->Render(Scene, Sampler);
 }
@@ -30,6 +30,7 @@
 #include <queue>
 
 // win32
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 
 #define NOGDICAPMASKS	 // CC_*, LC_*, PC_*, CP_*, TC_*, RC_
@@ -49,6 +50,22 @@
 #include <synchapi.h>
 #include <shobjidl.h>
 #include <strsafe.h>
+#else
+#include <cstdint>
+
+// Outside of the platform specific code the engine only uses these Win32 types
+using LONG	 = int32_t;
+using UINT	 = unsigned int;
+using UINT64 = uint64_t;
+
+struct RECT
+{
+	LONG left;
+	LONG top;
+	LONG right;
+	LONG bottom;
+};
+#endif
 
 #include "Math/Math.h"
 #include "Medium.h"